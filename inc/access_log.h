@@ -0,0 +1,90 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+/*
+ * L1D access-stream capture and cache-only replay.
+ *
+ * -capture_l1d <file> records every l1d_prefetcher_operate call and every
+ * l1d_prefetcher_cache_fill of a full simulation, one log per core (<file>, or
+ * <file>.<cpu> with more than one core). -replay_l1d <file> feeds the LOAD
+ * accesses of such a log straight into L1D without the O3 core, so prefetcher,
+ * replacement and DRAM experiments rerun the same access stream through
+ * CACHE + MEMORY_CONTROLLER only.
+ *
+ * Fidelity: the replay is open loop. Each access is injected at its recorded
+ * cycle, delayed only while the L1D RQ is full, so memory latency does not
+ * throttle the stream the way the ROB would and the replayed "IPC" only
+ * tracks the captured one. Stores, instruction fetches and wrong-path effects
+ * are not in the log, and the recorded physical addresses bypass the TLBs
+ * (prefetchers using SUPPORT_VA see the physical address as the virtual one).
+ */
+
+#include "cache.h"
+
+#define L1D_LOG_MAGIC "L1DLOG1"
+
+class L1DAccessRecord
+{
+  public:
+    enum { ACCESS, FILL };
+
+    uint8_t kind = ACCESS, hit = 0, type = 0, prefetch = 0;
+    uint64_t cycle = 0, instr = 0, addr = 0, ip = 0, evicted_addr = 0;
+};
+
+/**
+ * Delta-encoded record file. Each record is a flags byte (kind, hit, prefetch,
+ * type) followed by LEB128 varints: cycle and retired-instruction deltas, the
+ * zigzag address delta, then the zigzag IP delta (ACCESS) or the zigzag
+ * distance from the address to the evicted one (FILL). Physical pages are
+ * scattered, so a record still takes about 10 bytes instead of 40.
+ */
+class L1DAccessLog
+{
+  public:
+    L1DAccessLog(const string &path, bool write);
+    ~L1DAccessLog();
+
+    void write(const L1DAccessRecord &record);
+    bool read(L1DAccessRecord &record);
+
+    uint64_t records = 0;
+
+  private:
+    void put_varint(uint64_t value);
+    bool get_varint(uint64_t &value);
+
+    FILE *file;
+    bool writing;
+    L1DAccessRecord last;
+};
+
+/* replays one core's log into its L1D */
+class L1DReplay
+{
+  public:
+    L1DReplay(const string &path);
+
+    // inject the records that are due this cycle
+    void operate(CACHE *l1d);
+    bool done() const { return !has_next; }
+
+    uint64_t instructions = 0, injected = 0, stall_cycles = 0;
+
+  private:
+    L1DAccessLog log;
+    L1DAccessRecord next;
+    bool has_next;
+    uint64_t skew = 0, instr_id = 0;
+};
+
+// per-core capture/replay; null when the mode is off
+extern L1DAccessLog *l1d_capture[NUM_CPUS];
+extern L1DReplay *l1d_replay[NUM_CPUS];
+
+string l1d_log_path(const string &path, uint32_t cpu);
+
+void capture_l1d_access(uint32_t cpu, uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type);
+void capture_l1d_fill(uint32_t cpu, uint64_t addr, uint8_t prefetch, uint64_t evicted_addr);
+
+#endif
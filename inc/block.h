@@ -5,6 +5,8 @@
 #include "instruction.h"
 #include "set.h"
 
+#include <vector>
+
 // CACHE BLOCK
 class BLOCK
 {
@@ -67,6 +69,107 @@ public:
   };
 };
 
+// core-side bookkeeping of the requests merged into a packet
+// only the L1/TLB levels that hand packets back to the core read these,
+// so they live in a side table instead of being copied with every PACKET
+// the queues and MSHRs still hold the slimmed PACKET by value, not pool indices:
+// every level updates its entries in place and hands PACKET * to the prefetchers
+// and replacement policies, and the lq/sq/rob indices are scalars read on every hop
+class PACKET_DEPS
+{
+public:
+  fastset
+      rob_index_depend_on_me,
+      lq_index_depend_on_me,
+      sq_index_depend_on_me;
+};
+
+#define NO_PACKET_DEPS UINT32_MAX
+#define PACKET_DEPS_CHUNK 256
+
+// pool of PACKET_DEPS addressed by stable handles
+// entries are carved from fixed-size chunks, so a reference stays valid when the pool grows
+class PACKET_DEPS_POOL
+{
+  vector<PACKET_DEPS *> chunk;
+  vector<uint32_t> free_list;
+
+public:
+  uint32_t allocate();
+  void release(uint32_t handle);
+
+  PACKET_DEPS &operator[](uint32_t handle)
+  {
+    return chunk[handle / PACKET_DEPS_CHUNK][handle % PACKET_DEPS_CHUNK];
+  };
+
+  uint32_t capacity() { return chunk.size() * PACKET_DEPS_CHUNK; };
+  uint32_t in_use() { return capacity() - free_list.size(); };
+};
+
+PACKET_DEPS_POOL &packet_deps_pool();
+
+// owning handle into the pool, allocated on the first merge
+// copying a packet copies its dependencies, so every copy keeps its own set as before
+class PACKET_DEPS_HANDLE
+{
+  uint32_t handle;
+
+public:
+  PACKET_DEPS_HANDLE() : handle(NO_PACKET_DEPS){};
+
+  PACKET_DEPS_HANDLE(const PACKET_DEPS_HANDLE &other) : handle(NO_PACKET_DEPS)
+  {
+    if (other.handle != NO_PACKET_DEPS)
+    {
+      handle = packet_deps_pool().allocate();
+      packet_deps_pool()[handle] = packet_deps_pool()[other.handle];
+    }
+  };
+
+  PACKET_DEPS_HANDLE &operator=(const PACKET_DEPS_HANDLE &other)
+  {
+    if (this == &other)
+      return *this;
+
+    if (other.handle == NO_PACKET_DEPS)
+    {
+      clear();
+    }
+    else
+    {
+      if (handle == NO_PACKET_DEPS)
+        handle = packet_deps_pool().allocate();
+      packet_deps_pool()[handle] = packet_deps_pool()[other.handle];
+    }
+
+    return *this;
+  };
+
+  ~PACKET_DEPS_HANDLE() { clear(); };
+
+  void clear()
+  {
+    if (handle != NO_PACKET_DEPS)
+      packet_deps_pool().release(handle);
+    handle = NO_PACKET_DEPS;
+  };
+
+  PACKET_DEPS &get()
+  {
+    if (handle == NO_PACKET_DEPS)
+      handle = packet_deps_pool().allocate();
+    return packet_deps_pool()[handle];
+  };
+
+  // reads do not allocate, a packet nothing merged into depends on nothing
+  const PACKET_DEPS &view() const
+  {
+    static const PACKET_DEPS none;
+    return handle == NO_PACKET_DEPS ? none : packet_deps_pool()[handle];
+  };
+};
+
 // message packet
 class PACKET
 {
@@ -103,13 +206,11 @@ public:
       asid[2],
       type;
 
-  fastset
-      rob_index_depend_on_me,
-      lq_index_depend_on_me,
-      sq_index_depend_on_me;
+  PACKET_DEPS_HANDLE deps;
 
   uint32_t cpu, data_index, lq_index, sq_index;
   uint32_t pf_metadata;
+  uint32_t trace_id; // -latency_trace record, 0 if the request is not sampled
 
   uint64_t address,
       v_full_addr,
@@ -141,6 +242,7 @@ public:
     type = 0;
 
     fill_level = -1;
+    pf_origin_level = 0;
     rob_signal = -1;
     rob_index = -1;
     producer = -1;
@@ -149,13 +251,6 @@ public:
     signature = 0;
     confidence = 0;
 
-#if 0
-        for (uint32_t i=0; i<ROB_SIZE; i++) {
-            rob_index_depend_on_me[i] = 0;
-            lq_index_depend_on_me[i] = 0;
-            sq_index_depend_on_me[i] = 0;
-        }
-#endif
     is_producer = 0;
     instr_merged = 0;
     load_merged = 0;
@@ -165,17 +260,27 @@ public:
     data_index = 0;
     lq_index = 0;
     sq_index = 0;
+    pf_metadata = 0;
+    trace_id = 0;
 
     address = 0;
     v_full_addr = 0;
     full_addr = 0;
     instruction_pa = 0;
+    data_pa = 0;
     data = 0;
     instr_id = 0;
     ip = 0;
     event_cycle = UINT64_MAX;
     cycle_enqueued = 0;
   };
+
+  const fastset &rob_index_depend_on_me() const { return deps.view().rob_index_depend_on_me; };
+  const fastset &lq_index_depend_on_me() const { return deps.view().lq_index_depend_on_me; };
+  const fastset &sq_index_depend_on_me() const { return deps.view().sq_index_depend_on_me; };
+
+  // to merge a request into this one
+  PACKET_DEPS &merge_deps() { return deps.get(); };
 };
 
 // packet queue
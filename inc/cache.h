@@ -6,6 +6,8 @@
 #include <sstream>
 
 #include "memory_class.h"
+#include "mrc.h"
+#include "repl_shadow.h"
 
 // PAGE
 extern uint32_t PAGE_TABLE_LATENCY, SWAP_LATENCY;
@@ -208,6 +210,71 @@ class CompulsoryMissRecorder {
     unordered_set<uint64_t> addresses_;
 };
 
+#define PF_FILTER_SIZE 256    // recent-miss table entries, power of two
+#define PF_FILTER_WINDOW 512  // cycles a recorded miss stays in flight
+
+/**
+ * @brief Drops prefetches that handle_prefetch would only discard later: lines already
+ * resident in the cache, and lines with a miss (demand or prefetch) recorded in the last
+ * PF_FILTER_WINDOW cycles. The recent misses are kept in a direct-mapped table indexed by
+ * block address, so a lookup is a single compare. A miss leaves the table when its line is
+ * filled or evicted, so a line evicted inside the window can be prefetched again.
+ */
+class PrefetchFilter {
+  public:
+    enum { DROP_RESIDENT, DROP_INFLIGHT, DROP_TYPES };
+
+    PrefetchFilter() : entries_(PF_FILTER_SIZE) {}
+
+    // true if a miss on `address` that fills at `fill_level` or above is still in flight
+    bool inflight(uint64_t address, int fill_level, uint64_t cycle) const {
+        const Entry &entry = entries_[address & (PF_FILTER_SIZE - 1)];
+        return entry.valid && entry.address == address && entry.fill_level <= fill_level &&
+               cycle < entry.cycle + PF_FILTER_WINDOW;
+    }
+
+    void record(uint64_t address, int fill_level, uint64_t cycle) {
+        Entry &entry = entries_[address & (PF_FILTER_SIZE - 1)];
+        entry.valid = true;
+        entry.address = address;
+        entry.fill_level = fill_level;
+        entry.cycle = cycle;
+    }
+
+    // the miss on `address` is over, its line was filled or evicted
+    void clear(uint64_t address) {
+        Entry &entry = entries_[address & (PF_FILTER_SIZE - 1)];
+        if (entry.address == address)
+            entry.valid = false;
+    }
+
+    void drop(int reason) { dropped[reason]++; }
+
+    uint64_t dropped[DROP_TYPES] = {};
+
+  private:
+    struct Entry {
+        bool valid = false;
+        int fill_level = 0;
+        uint64_t address = 0, cycle = 0;
+    };
+    vector<Entry> entries_;
+};
+
+/**
+ * @brief The counters print_roi_stats reports for one core, plus the prefetch fills the
+ * -summary accuracy needs. With -sample they are the sums of what changed inside the measured
+ * windows only.
+ */
+struct CACHE_ROI_STATS {
+    uint64_t access[NUM_TYPES] = {}, hit[NUM_TYPES] = {}, miss[NUM_TYPES] = {}, miss_latency[NUM_TYPES] = {};
+    uint64_t pf_requested = 0, pf_issued = 0, pf_useful = 0, pf_useless = 0, pf_late = 0, pf_fill = 0;
+    uint64_t pf_dropped[PrefetchFilter::DROP_TYPES] = {};
+    uint64_t total_miss_latency = 0;
+
+    // add what changed from `begin` to `end`
+    void add(const CACHE_ROI_STATS &begin, const CACHE_ROI_STATS &end);
+};
 
 #ifdef MEASURE
 extern PerformanceCounter batch_perf_counter[NUM_CPUS];
@@ -266,6 +333,9 @@ public:
     uint64_t total_miss_latency;
     uint64_t miss_latency[NUM_CPUS][NUM_TYPES];
 
+    // what changed in the region of interest (in the measured windows with -sample), from roi_begin
+    CACHE_ROI_STATS roi_begin[NUM_CPUS], roi_delta[NUM_CPUS];
+
     /* For cache accuracy measurement */
     uint64_t cycle, next_measure_cycle;
     uint64_t pf_useful_epoch, pf_filled_epoch;
@@ -275,6 +345,17 @@ public:
 #ifdef MEASURE_COMPULSORY
     CompulsoryMissRecorder cmr_;
 #endif
+    PrefetchFilter pf_filter;
+
+    // bound modes: a perfect cache turns every miss into a hit (-perfect_l1d/l2c/llc)
+    uint8_t perfect = 0;
+
+    // stack-distance profiler of the requests entering this cache (-mrc_l2c/-mrc_llc)
+    MRCProfiler *mrc = NULL;
+    // other replacement policies run on sampled shadow sets of this cache (-llc_shadow)
+    ReplacementShadow *shadow = NULL;
+    // replacement policy of a non-LLC cache (-l2c_replacement), LRU when NULL
+    Replacement::Policy *repl = NULL;
     /**
      * @brief dynamic functions needed by some prefetchers;
      * 
@@ -318,7 +399,7 @@ public:
                 miss_latency[i][j] = 0;
             }
 
-            for (int j = 0; j < 6; j++)
+            for (int j = 0; j < 64; j++)
             {
                 pref_useful[i][j] = 0;
                 pref_filled[i][j] = 0;
@@ -366,6 +447,7 @@ public:
         invalidate_entry(uint64_t inval_addr),
         check_mshr(PACKET *packet),
         prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int prefetch_fill_level, uint32_t prefetch_metadata),
+        prefetch_line(uint32_t pf_cpu, uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int prefetch_fill_level, uint32_t prefetch_metadata),
         kpc_prefetch_line(uint64_t base_addr, uint64_t pf_addr, int prefetch_fill_level, int delta, int depth, int signature, int confidence, uint32_t prefetch_metadata);
 
     virtual void handle_fill(),
@@ -391,11 +473,20 @@ public:
         l1d_prefetcher_operate(uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type),
         prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr),
         l1d_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in),
+        l1d_prefetcher_cycle_operate(),
+        l2c_prefetcher_cycle_operate(),
+        llc_prefetcher_cycle_operate(),
+        l1d_prefetcher_broadcast_bw(uint8_t bw_level),
+        l2c_prefetcher_broadcast_bw(uint8_t bw_level),
+        llc_prefetcher_broadcast_bw(uint8_t bw_level),
         //prefetcher_final_stats(),
         l1d_prefetcher_final_stats(),
         l2c_prefetcher_final_stats(),
         llc_prefetcher_final_stats();
     void l1d_prefetcher_operate(uint64_t v_addr, uint64_t p_addr, uint64_t ip, uint8_t cache_hit, uint8_t type);
+    // call the L1D prefetcher, recording the call when -capture_l1d is on
+    void l1d_prefetcher_notify(uint64_t v_addr, uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type),
+        l1d_prefetcher_notify_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in);
     void (*l1i_prefetcher_cache_operate)(uint32_t, uint64_t, uint8_t, uint8_t);
     void (*l1i_prefetcher_cache_fill)(uint32_t, uint64_t, uint32_t, uint32_t, uint8_t, uint64_t);
 
@@ -404,12 +495,27 @@ public:
         l2c_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in),
         llc_prefetcher_cache_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in);
 
+    // the counters as they are now, and as the region of interest ended
+    CACHE_ROI_STATS live_stats(uint32_t cpu), roi_stats(uint32_t cpu);
+
+    // no read, prefetch or miss in flight, so functional warming cannot race a fill
+    bool drained();
+
     uint32_t get_set(uint64_t address),
         get_way(uint64_t address, uint32_t set),
         find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type),
         llc_find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type),
         lru_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type);
 
+    // functional fast-forward: look up and fill the tag arrays without any timing
+    uint64_t warm_access(PACKET *packet);
+    CACHE *warm_lower();
+
+    // install a missing block in place for a perfect cache, returns the way or -1 on a bypass
+    int perfect_fill(PACKET *packet);
+    // oracle L1D prefetcher: prefetch the future footprint of the page (-oracle_l1d)
+    void oracle_prefetch(uint64_t v_addr, uint64_t addr, uint64_t ip);
+
     bool is_in_cache(uint64_t addr);
     bool print_timeliness_stat();
     void broadcast_bw(uint8_t bw_level);
@@ -7,6 +7,17 @@
 #define CPLX_TYPE 3 // complex stride
 #define NL_TYPE 4   // next line
 
+// ***************** PMP prefetch metadata *********************
+// pf_metadata of PMP's prefetches: the vote confidence in 1/15ths and whether the PC pattern
+// table (PPT) or the offset pattern table (OPT) gave it. Kept below 64, CACHE counts
+// pref_filled/pref_useful/pref_late by pf_metadata.
+#define PMP_META_VALID 0x20
+#define PMP_META_PPT 0x10
+#define PMP_META_CONF_MAX 15
+#define PMP_META(conf, ppt) (PMP_META_VALID | ((ppt) ? PMP_META_PPT : 0) | (conf))
+#define IS_PMP_META(m) (((m) & ~0x3fu) == 0 && ((m) & PMP_META_VALID))
+#define PMP_META_CONF(m) ((m) & PMP_META_CONF_MAX)
+
 
 #define ADD(x, MAX) (x = x >= MAX ? x : x + 1)
 #define ADD_ANY(x, y, MAX) (x = x + y >= MAX ? MAX : x + y)
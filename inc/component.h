@@ -9,6 +9,8 @@
 #include <functional>
 #include <sstream>
 #include <random>
+#include <new>
+#include <type_traits>
 
 class Table {
   public:
@@ -328,6 +330,95 @@ protected:
     int size;
 };
 
+/**
+ * A single contiguous slab owned by one structure. Tables carve their entries, tags and
+ * replacement state out of it at construction time, so copying and flushing a
+ * table walk one region instead of a tree of heap vectors. Regions are addressed by byte offset,
+ * which stays valid when the owning table is copied.
+ */
+class Arena {
+  public:
+    Arena(size_t capacity = 0) : capacity(capacity), used(0), trivial(true), slab(capacity ? new char[capacity] : nullptr) {}
+
+    Arena(const Arena &other)
+        : capacity(other.capacity), used(other.used), trivial(other.trivial), regions(other.regions),
+          slab(other.capacity ? new char[other.capacity] : nullptr) {
+        if (this->trivial)
+            memcpy(this->slab, other.slab, this->used);
+        else
+            for (auto &r : this->regions)
+                r.copy(this->slab + r.offset, other.slab + r.offset, r.count);
+    }
+
+    Arena &operator=(const Arena &other) {
+        if (this != &other) {
+            Arena tmp(other);
+            std::swap(this->capacity, tmp.capacity);
+            std::swap(this->used, tmp.used);
+            std::swap(this->trivial, tmp.trivial);
+            std::swap(this->regions, tmp.regions);
+            std::swap(this->slab, tmp.slab);
+        }
+        return *this;
+    }
+
+    ~Arena() {
+        if (!this->trivial)
+            for (auto &r : this->regions)
+                r.destroy(this->slab + r.offset, r.count);
+        delete[] this->slab;
+    }
+
+    /**
+     * Constructs `count` copies of `init` in the slab.
+     * @return The offset of the new region
+     */
+    template <class U> size_t alloc(size_t count, const U &init = U()) {
+        size_t offset = (this->used + alignof(U) - 1) / alignof(U) * alignof(U);
+        assert(offset + count * sizeof(U) <= this->capacity);
+        U *region = reinterpret_cast<U *>(this->slab + offset);
+        for (size_t i = 0; i < count; i += 1)
+            new (region + i) U(init);
+        this->used = offset + count * sizeof(U);
+        this->regions.push_back({offset, count, &Arena::copy_region<U>, &Arena::destroy_region<U>});
+        this->trivial = this->trivial && is_trivially_copyable<U>::value;
+        return offset;
+    }
+
+    template <class U> U *at(size_t offset) { return reinterpret_cast<U *>(this->slab + offset); }
+
+    template <class U> const U *at(size_t offset) const { return reinterpret_cast<const U *>(this->slab + offset); }
+
+    size_t size() const { return this->used; }
+
+  private:
+    struct Region {
+        size_t offset;
+        size_t count;
+        void (*copy)(char *dst, const char *src, size_t count);
+        void (*destroy)(char *base, size_t count);
+    };
+
+    template <class U> static void copy_region(char *dst, const char *src, size_t count) {
+        const U *from = reinterpret_cast<const U *>(src);
+        U *to = reinterpret_cast<U *>(dst);
+        for (size_t i = 0; i < count; i += 1)
+            new (to + i) U(from[i]);
+    }
+
+    template <class U> static void destroy_region(char *base, size_t count) {
+        U *region = reinterpret_cast<U *>(base);
+        for (size_t i = 0; i < count; i += 1)
+            region[i].~U();
+    }
+
+    size_t capacity;
+    size_t used;
+    bool trivial;
+    vector<Region> regions;
+    char *slab;
+};
+
 template <class T> class SetAssociativeCache {
   public:
     class Entry {
@@ -340,12 +431,13 @@ template <class T> class SetAssociativeCache {
     };
 
     SetAssociativeCache(int size, int num_ways, int debug_level = 0)
-        : size(size), num_ways(num_ways), num_sets(size / num_ways), entries(num_sets, vector<Entry>(num_ways)),
-          cams(num_sets, unordered_map<uint64_t, int>(num_ways)), debug_level(debug_level) {
+        : size(size), num_ways(num_ways), num_sets(size / num_ways),
+          arena(arena_capacity(size / num_ways, num_ways)), debug_level(debug_level) {
         // assert(size % num_ways == 0);
-        for (int i = 0; i < num_sets; i += 1)
-            for (int j = 0; j < num_ways; j += 1) 
-                entries[i][j].valid = false;
+        Entry invalid_entry = Entry();
+        invalid_entry.valid = false;
+        this->entries = this->arena.template alloc<Entry>(num_sets * num_ways, invalid_entry);
+        this->cams = this->arena.template alloc<uint64_t>(num_sets * num_ways, 0);
         /* calculate `index_len` (number of bits required to store the index) */
         for (int max_index = num_sets - 1; max_index > 0; max_index >>= 1)
             this->index_len += 1;
@@ -357,13 +449,8 @@ template <class T> class SetAssociativeCache {
      */
     Entry *erase(uint64_t key) {
         Entry *entry = this->find(key);
-        uint64_t index = key % this->num_sets;
-        uint64_t tag = key / this->num_sets;
-        auto &cam = cams[index];
-        int num_erased = cam.erase(tag);
         if (entry)
             entry->valid = false;
-        // assert(entry ? num_erased == 1 : num_erased == 0);
         return entry;
     }
 
@@ -379,7 +466,7 @@ template <class T> class SetAssociativeCache {
         }
         uint64_t index = key % this->num_sets;
         uint64_t tag = key / this->num_sets;
-        vector<Entry> &set = this->entries[index];
+        Entry *set = this->get_set(index);
         int victim_way = -1;
         for (int i = 0; i < this->num_ways; i += 1)
             if (!set[i].valid) {
@@ -392,35 +479,23 @@ template <class T> class SetAssociativeCache {
         Entry &victim = set[victim_way];
         Entry old_entry = victim;
         victim = {key, index, tag, true, data};
-        auto &cam = cams[index];
-        if (old_entry.valid) {
-            int num_erased = cam.erase(old_entry.tag);
-            // assert(num_erased == 1);
-        }
-        cam[tag] = victim_way;
+        this->get_cam(index)[victim_way] = tag;
         return old_entry;
     }
 
     Entry *find(uint64_t key) {
         uint64_t index = key % this->num_sets;
         uint64_t tag = key / this->num_sets;
-        auto &cam = cams[index];
-        if (cam.find(tag) == cam.end())
+        int way = this->get_way(index, tag);
+        if (way == -1)
             return nullptr;
-        int way = cam[tag];
-        Entry &entry = this->entries[index][way];
-        // assert(entry.tag == tag && entry.valid);
-        if (!entry.valid)
-            return nullptr;
-        return &entry;
+        return &this->get_set(index)[way];
     }
 
     void flush() {
-        for (int i = 0; i < num_sets; i += 1) {
-            cams[i].clear();
-            for (int j = 0; j < num_ways; j += 1)
-                entries[i][j].valid = false;
-        }
+        Entry *all = this->arena.template at<Entry>(this->entries);
+        for (int i = 0; i < num_sets * num_ways; i += 1)
+            all[i].valid = false;
     }
 
     /**
@@ -456,19 +531,44 @@ template <class T> class SetAssociativeCache {
 
     vector<Entry> get_valid_entries() {
         vector<Entry> valid_entries;
-        for (int i = 0; i < num_sets; i += 1)
+        for (int i = 0; i < num_sets; i += 1) {
+            Entry *set = this->get_set(i);
             for (int j = 0; j < num_ways; j += 1)
-                if (entries[i][j].valid)
-                    valid_entries.push_back(entries[i][j]);
+                if (set[j].valid)
+                    valid_entries.push_back(set[j]);
+        }
         return valid_entries;
     }
 
+    Entry *get_set(uint64_t index) { return this->arena.template at<Entry>(this->entries) + index * this->num_ways; }
+
+    uint64_t *get_cam(uint64_t index) { return this->arena.template at<uint64_t>(this->cams) + index * this->num_ways; }
+
+    /**
+     * @return The way holding a valid entry with the given tag, or -1
+     */
+    int get_way(uint64_t index, uint64_t tag) {
+        uint64_t *cam = this->get_cam(index);
+        for (int i = 0; i < this->num_ways; i += 1)
+            if (cam[i] == tag && this->get_set(index)[i].valid)
+                return i;
+        return -1;
+    }
+
+    /**
+     * Room for the entries, their tags, one word of replacement state per way and a few scalars.
+     */
+    static size_t arena_capacity(int num_sets, int num_ways) {
+        return num_sets * num_ways * (sizeof(Entry) + 2 * sizeof(uint64_t)) + 8 * sizeof(uint64_t) + alignof(Entry);
+    }
+
     int size;
     int num_ways;
     int num_sets;
     int index_len = 0; /* in bits */
-    vector<vector<Entry>> entries;
-    vector<unordered_map<uint64_t, int>> cams;
+    Arena arena;
+    size_t entries; /* offset of num_sets * num_ways entries in `arena` */
+    size_t cams;    /* offset of the per-way tags in `arena` */
     int debug_level = 0;
 };
 
@@ -476,10 +576,12 @@ template <class T> class LRUSetAssociativeCache : public SetAssociativeCache<T>
     typedef SetAssociativeCache<T> Super;
 
   public:
-    LRUSetAssociativeCache(int size, int num_ways, int debug_level = 0)
-        : Super(size, num_ways, debug_level), lru(this->num_sets, vector<uint64_t>(num_ways)) {}
+    LRUSetAssociativeCache(int size, int num_ways, int debug_level = 0) : Super(size, num_ways, debug_level) {
+        this->lru = this->arena.template alloc<uint64_t>(this->num_sets * num_ways, 0);
+        this->t = this->arena.template alloc<uint64_t>(1, 1);
+    }
 
-    void set_mru(uint64_t key) { *this->get_lru(key) = this->t++; }
+    void set_mru(uint64_t key) { *this->get_lru(key) = (*this->get_t())++; }
 
     void set_lru(uint64_t key) { *this->get_lru(key) = 0; }
 
@@ -490,20 +592,26 @@ template <class T> class LRUSetAssociativeCache : public SetAssociativeCache<T>
   protected:
     /* @override */
     int select_victim(uint64_t index) {
-        vector<uint64_t> &lru_set = this->lru[index];
-        return min_element(lru_set.begin(), lru_set.end()) - lru_set.begin();
+        uint64_t *lru_set = this->get_lru_set(index);
+        return min_element(lru_set, lru_set + this->num_ways) - lru_set;
+    }
+
+    uint64_t *get_lru_set(uint64_t index) {
+        return this->arena.template at<uint64_t>(this->lru) + index * this->num_ways;
     }
 
     uint64_t *get_lru(uint64_t key) {
         uint64_t index = key % this->num_sets;
         uint64_t tag = key / this->num_sets;
-        // assert(this->cams[index].count(tag) == 1);
-        int way = this->cams[index][tag];
-        return &this->lru[index][way];
+        int way = this->get_way(index, tag);
+        assert(way != -1);
+        return &this->get_lru_set(index)[way];
     }
 
-    vector<vector<uint64_t>> lru;
-    uint64_t t = 1;
+    uint64_t *get_t() { return this->arena.template at<uint64_t>(this->t); }
+
+    size_t lru;
+    size_t t;
 };
 
 template<class T> 
@@ -511,8 +619,9 @@ class LFUSetAssociativeCache: public SetAssociativeCache<T> {
     typedef SetAssociativeCache<T> Super;
 
   public:
-    LFUSetAssociativeCache(int size, int num_ways, int debug_level = 0)
-        : Super(size, num_ways, debug_level), frq_(this->num_sets, vector<uint64_t>(num_ways)) {}
+    LFUSetAssociativeCache(int size, int num_ways, int debug_level = 0) : Super(size, num_ways, debug_level) {
+        this->frq_ = this->arena.template alloc<uint64_t>(this->num_sets * num_ways, 0);
+    }
 
     void rp_promote(uint64_t key) { (*this->get_frequency(key))++;}
 
@@ -521,19 +630,23 @@ class LFUSetAssociativeCache: public SetAssociativeCache<T> {
   protected:
     /* @override */
     int select_victim(uint64_t index) {
-        vector<uint64_t> &frq_set = this->frq_[index];
-        return min_element(frq_set.begin(), frq_set.end()) - frq_set.begin();
+        uint64_t *frq_set = this->get_frequency_set(index);
+        return min_element(frq_set, frq_set + this->num_ways) - frq_set;
+    }
+
+    uint64_t *get_frequency_set(uint64_t index) {
+        return this->arena.template at<uint64_t>(this->frq_) + index * this->num_ways;
     }
 
     uint64_t *get_frequency(uint64_t key) {
         uint64_t index = key % this->num_sets;
         uint64_t tag = key / this->num_sets;
-        // assert(this->cams[index].count(tag) == 1);
-        int way = this->cams[index][tag];
-        return &this->frq_[index][way];
+        int way = this->get_way(index, tag);
+        assert(way != -1);
+        return &this->get_frequency_set(index)[way];
     }
 
-    vector<vector<uint64_t>> frq_;
+    size_t frq_;
 };
 
 /**
@@ -581,9 +694,9 @@ template <class T> class DynIndexSetAssociativeCache : public SetAssociativeCach
         } else {
             index = update_dyn_index(key & dyn_index_mask_);
             uint64_t new_key = index | (key & ~(this->num_sets-1));
-            this->cams[index].clear();
-            for (auto &e : this->entries[index]) {
-                e.valid = false;
+            typename Super::Entry *set = this->get_set(index);
+            for (int i = 0; i < this->num_ways; i += 1) {
+                set[i].valid = false;
             }
 
             return Super::insert(new_key, data);
@@ -614,8 +727,9 @@ template <class T> class SRRIPSetAssociativeCache : public SetAssociativeCache<T
 
   public:
     SRRIPSetAssociativeCache(int size, int num_ways, int debug_level = 0, int max_rrpv = 3)
-        : Super(size, num_ways, debug_level), rrpv(this->num_sets, vector<uint64_t>(num_ways)), 
-        max_rrpv(max_rrpv) {}
+        : Super(size, num_ways, debug_level), max_rrpv(max_rrpv) {
+        this->rrpv = this->arena.template alloc<uint64_t>(this->num_sets * num_ways, 0);
+    }
 
     void rp_promote(uint64_t key) {*this->get_rrpv(key) = 0;}
 
@@ -624,10 +738,10 @@ template <class T> class SRRIPSetAssociativeCache : public SetAssociativeCache<T
   protected:
     /* @override */
     int select_victim(uint64_t index) {
-        vector<uint64_t> &rrpv_set = this->rrpv[index];
+        uint64_t *rrpv_set = this->get_rrpv_set(index);
         for (;;) {
             for (int i = 0; i < this->num_ways; i++) {
-                if (rrpv_set[i] >= max_rrpv) {
+                if (rrpv_set[i] >= (uint64_t)max_rrpv) {
                     return i;
                 }
             }
@@ -635,22 +749,26 @@ template <class T> class SRRIPSetAssociativeCache : public SetAssociativeCache<T
         } 
     }
 
+    uint64_t *get_rrpv_set(uint64_t index) {
+        return this->arena.template at<uint64_t>(this->rrpv) + index * this->num_ways;
+    }
+
     uint64_t *get_rrpv(uint64_t key) {
         uint64_t index = key % this->num_sets;
         uint64_t tag = key / this->num_sets;
-        // assert(this->cams[index].count(tag) == 1);
-        int way = this->cams[index][tag];
-        return &this->rrpv[index][way];
+        int way = this->get_way(index, tag);
+        assert(way != -1);
+        return &this->get_rrpv_set(index)[way];
     }
   private:
     void aging(uint64_t index) {
-        vector<uint64_t> &rrpv_set = this->rrpv[index];
-        for (auto &r:rrpv_set) {
-            ADD(r, max_rrpv);
+        uint64_t *rrpv_set = this->get_rrpv_set(index);
+        for (int i = 0; i < this->num_ways; i++) {
+            ADD(rrpv_set[i], (uint64_t)max_rrpv);
         }
     }
 
-    vector<vector<uint64_t>> rrpv;
+    size_t rrpv;
     int max_rrpv;
 };
 
@@ -659,34 +777,42 @@ template <class T> class BIPSetAssociativeCache : public SetAssociativeCache<T>
 
   public:
     BIPSetAssociativeCache(int size, int num_ways, int debug_level = 0, double epsilon=0.1)
-        : Super(size, num_ways, debug_level), lru(this->num_sets, vector<uint64_t>(num_ways)), 
-        b_dist(epsilon) {}
+        : Super(size, num_ways, debug_level), b_dist(epsilon) {
+        this->lru = this->arena.template alloc<uint64_t>(this->num_sets * num_ways, 0);
+        this->t = this->arena.template alloc<uint64_t>(1, 1);
+    }
 
-    void set_mru(uint64_t key) { *this->get_lru(key) = this->t++; }
+    void set_mru(uint64_t key) { *this->get_lru(key) = (*this->get_t())++; }
 
     void set_lru(uint64_t key) { *this->get_lru(key) = 0; }
 
     void rp_promote(uint64_t key) {set_mru(key);}
 
-    void rp_insert(uint64_t key) { *this->get_lru(key) = b_dist(engine) ? t : t/2;}
+    void rp_insert(uint64_t key) { *this->get_lru(key) = b_dist(engine) ? *this->get_t() : *this->get_t()/2;}
 
   protected:
     /* @override */
     int select_victim(uint64_t index) {
-        vector<uint64_t> &lru_set = this->lru[index];
-        return min_element(lru_set.begin(), lru_set.end()) - lru_set.begin();
+        uint64_t *lru_set = this->get_lru_set(index);
+        return min_element(lru_set, lru_set + this->num_ways) - lru_set;
+    }
+
+    uint64_t *get_lru_set(uint64_t index) {
+        return this->arena.template at<uint64_t>(this->lru) + index * this->num_ways;
     }
 
     uint64_t *get_lru(uint64_t key) {
         uint64_t index = key % this->num_sets;
         uint64_t tag = key / this->num_sets;
-        // assert(this->cams[index].count(tag) == 1);
-        int way = this->cams[index][tag];
-        return &this->lru[index][way];
+        int way = this->get_way(index, tag);
+        assert(way != -1);
+        return &this->get_lru_set(index)[way];
     }
 
-    vector<vector<uint64_t>> lru;
-    uint64_t t = 1;
+    uint64_t *get_t() { return this->arena.template at<uint64_t>(this->t); }
+
+    size_t lru;
+    size_t t;
 
     default_random_engine engine;
     bernoulli_distribution b_dist;
@@ -697,8 +823,9 @@ template <class T> class BRRIPSetAssociativeCache : public SetAssociativeCache<T
 
   public:
     BRRIPSetAssociativeCache(int size, int num_ways, int debug_level = 0, int max_rrpv = 3, double epsilon = 0.1)
-        : Super(size, num_ways, debug_level), rrpv(this->num_sets, vector<uint64_t>(num_ways)), 
-        max_rrpv(max_rrpv), b_dist(epsilon) {}
+        : Super(size, num_ways, debug_level), max_rrpv(max_rrpv), b_dist(epsilon) {
+        this->rrpv = this->arena.template alloc<uint64_t>(this->num_sets * num_ways, 0);
+    }
 
     void rp_promote(uint64_t key) {*this->get_rrpv(key) = 0;}
 
@@ -707,10 +834,10 @@ template <class T> class BRRIPSetAssociativeCache : public SetAssociativeCache<T
   protected:
     /* @override */
     int select_victim(uint64_t index) {
-        vector<uint64_t> &rrpv_set = this->rrpv[index];
+        uint64_t *rrpv_set = this->get_rrpv_set(index);
         for (;;) {
             for (int i = 0; i < this->num_ways; i++) {
-                if (rrpv_set[i] >= max_rrpv) {
+                if (rrpv_set[i] >= (uint64_t)max_rrpv) {
                     return i;
                 }
             }
@@ -718,23 +845,27 @@ template <class T> class BRRIPSetAssociativeCache : public SetAssociativeCache<T
         } 
     }
 
+    uint64_t *get_rrpv_set(uint64_t index) {
+        return this->arena.template at<uint64_t>(this->rrpv) + index * this->num_ways;
+    }
+
     uint64_t *get_rrpv(uint64_t key) {
         uint64_t index = key % this->num_sets;
         uint64_t tag = key / this->num_sets;
-        // assert(this->cams[index].count(tag) == 1);
-        int way = this->cams[index][tag];
-        return &this->rrpv[index][way];
+        int way = this->get_way(index, tag);
+        assert(way != -1);
+        return &this->get_rrpv_set(index)[way];
     }
 
   private:
     void aging(uint64_t index) {
-        vector<uint64_t> &rrpv_set = this->rrpv[index];
-        for (auto &r:rrpv_set) {
-            ADD(r, max_rrpv);
+        uint64_t *rrpv_set = this->get_rrpv_set(index);
+        for (int i = 0; i < this->num_ways; i++) {
+            ADD(rrpv_set[i], (uint64_t)max_rrpv);
         }
     }
 
-    vector<vector<uint64_t>> rrpv;
+    size_t rrpv;
     int max_rrpv;
     default_random_engine engine;
     bernoulli_distribution b_dist;
@@ -744,25 +875,28 @@ template <class T> class NMRUSetAssociativeCache : public SetAssociativeCache<T>
     typedef SetAssociativeCache<T> Super;
 
 public:
-    NMRUSetAssociativeCache(int size, int num_ways) : Super(size, num_ways), mru(this->num_sets) {}
+    NMRUSetAssociativeCache(int size, int num_ways) : Super(size, num_ways) {
+        this->mru = this->arena.template alloc<int>(this->num_sets, 0);
+    }
 
     void set_mru(uint64_t key) {
         uint64_t index = key % this->num_sets;
         uint64_t tag = key / this->num_sets;
-        int way = this->cams[index][tag];
-        this->mru[index] = way;
+        int way = this->get_way(index, tag);
+        assert(way != -1);
+        this->arena.template at<int>(this->mru)[index] = way;
     }
 
 protected:
     /* @override */
     int select_victim(uint64_t index) {
         int way = rand() % (this->num_ways - 1);
-        if (way >= mru[index])
+        if (way >= this->arena.template at<int>(this->mru)[index])
             way += 1;
         return way;
     }
 
-    vector<int> mru;
+    size_t mru;
 };
 
 template <class T> class LRUFullyAssociativeCache : public LRUSetAssociativeCache<T> {
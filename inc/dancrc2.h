@@ -0,0 +1,195 @@
+#ifndef DANCRC2_H
+#define DANCRC2_H
+
+/*
+ * Multiperspective Reuse Predictor (replacement/dancrc2.cc)
+ *
+ * The class is declared here, and final, so dancrc2.llc_repl can drive the
+ * LLC through a Dancrc2 pointer and its calls bind statically; shadow copies
+ * still go through Replacement::Policy.
+ */
+
+#include <string.h>
+#include "replacement.h"
+
+#define MAX_PATH_LENGTH 16
+#define LLC_WAYS	16
+
+struct feature_spec;
+
+namespace Replacement
+{
+
+class Dancrc2 final : public Policy {
+public:
+	Dancrc2 (uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets);
+
+	uint32_t find_victim (uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t PC, uint64_t paddr, uint32_t type);
+	void update_replacement_state (uint32_t cpu, uint32_t set, uint32_t way, uint64_t paddr, uint64_t PC, uint64_t victim_addr, uint32_t type, uint8_t hit);
+
+private:
+	// one sampler entry
+
+	struct sdbp_sampler_entry {
+		unsigned int
+			lru_stack_position,
+			tag,
+
+			// copy of the trace used for the most recent prediction
+
+			trace_buffer[MAX_PATH_LENGTH+1];
+
+		// confidence from most recent prediction
+
+		int conf;
+
+		sdbp_sampler_entry (void) {
+			lru_stack_position = 0;
+			tag = 0;
+			memset (trace_buffer, 0, sizeof (trace_buffer));
+			conf = 0;
+		};
+	};
+
+	void set_parameters (void);
+	void update_plru_mdpp (int set, int32_t wayID, bool hit, int *vector, uint32_t accessType, bool really = true, int conf = 0);
+	int get_mdpp_plru_victim (int set);
+	void make_trace (uint32_t tid, uint32_t setIndex, uint64_t PC, uint32_t tag, int accessType, bool burst, bool insertion, bool lastmiss, unsigned int offset);
+	unsigned int mm (unsigned int x, unsigned int m[]);
+	void update_sampler (uint32_t setIndex, uint64_t tag, uint32_t tid, uint64_t PC, int32_t way, bool hit, uint32_t accessType, uint64_t paddr);
+	void sampler_access (uint32_t tid, int set, int real_set, uint64_t tag, uint64_t PC, int accessType, uint64_t paddr);
+	void make_predictor (void);
+	int get_prediction (uint32_t tid, int set);
+	void block_is_dead (uint32_t tid, sdbp_sampler_entry *block, unsigned int *trace_buffer, bool d, int conf, int pos);
+	void train_batch (void);
+
+	// set from the configuration number
+
+	unsigned int
+		llc_sets,
+		num_core;
+
+	int
+		config,	   // the configuration number
+		lognsets6, // log_2 number of sets plus 6
+		lognsets;  // log_2 number of sets
+
+	vector<uint16_t>
+		plru_bits; 	// per-set pseudo-LRU bits, bit k is node k of the tree of LLC_WAYS-1 nodes
+
+	vector<uint8_t>
+		lastmiss_bits;	// for lastmiss feature
+
+	vector<vector<unsigned char> >
+		rrpv;		// for RRIP policy
+
+	// trace is built here before prediction
+
+	unsigned int
+		trace_buffer[MAX_PATH_LENGTH+1];
+
+	// per-core array of recent PCs
+
+	vector<vector<unsigned int> >
+		addresses;
+
+	// placement vector
+
+	int plv[3][2];
+
+	// for set-dueling the best bypass threshold
+
+	int
+		psel = 0;
+
+	// leader sets: 1 when they duel with dan_dt1, 2 with dan_dt2, 0 for followers
+
+	vector<unsigned char>
+		leader;
+
+	// which features to use
+
+	feature_spec *specs;
+
+	// most recent access was a cache burst
+
+	bool was_burst = false;
+
+	// parameters
+
+	int
+		dan_promotion_threshold = 256,
+		dan_init_weight = 1,
+		dan_dt1 = 55, dan_dt2 = 1024,
+		dan_rrip_place_position = 0,
+		dan_leaders = 34,
+		dan_ignore_prefetch = 1, // don't predict hitting prefetches
+		dan_use_plru = 0, // 0 means use MDPP, 1 means use PLRU
+		dan_use_rrip = 0, // 1 means use RRIP instead of MDPP/PLRU
+		dan_bypass_threshold = 1000,
+		dan_record_types = 27, // mask for deciding which kinds of memory accesses to record in history
+		// sampler associativity
+		dan_sampler_assoc = 18,
+		// number of bits used to index predictor; determines number of
+		// entries in prediction tables
+		dan_predictor_index_bits = 8,
+		// number of prediction tables
+		dan_predictor_tables = 16, // default specs have 16 features
+		// width of prediction saturating counters
+		dan_counter_width = 6,
+		// predictor must meet this threshold to predict a block is dead
+		dan_threshold = 8,
+		dan_theta2 = 210,
+		dan_theta = 110,
+		// number of partial tag bits kept per sampler entry
+		dan_sampler_tag_bits = 16,
+		dan_samplers = 80,
+		// number of entries in prediction table; derived from # of index bits
+		dan_predictor_table_entries,
+		// maximum value of saturating counter; derived from counter width
+		dan_counter_min,
+		dan_counter_max;
+
+	// the sampler: nsampler_sets sets of dan_sampler_assoc entries
+
+	int
+		nsampler_sets;   // number of sampler sets
+
+	vector<sdbp_sampler_entry>
+		sampler_blocks;
+
+	// the sampler set of each LLC set, -1 if it is not sampled
+
+	vector<int>
+		sampler_set;
+
+	// the dead block predictor
+
+	vector<int8_t> weights;	// all the tables of saturating counters, packed back to back
+	unsigned int
+		table_offsets[MAX_PATH_LENGTH+1],	// where each table starts in weights
+		table_masks[MAX_PATH_LENGTH+1];		// table sizes are powers of two, so index with trace & mask
+
+	// the tables trained when a sampler block reaches each LRU position:
+	// dead blocks train the tables whose associativity is that position,
+	// live blocks the ones with a larger associativity (bit i is table i)
+	vector<unsigned int>
+		dead_tables,
+		live_tables;
+
+	// the trainings of one sampler access, gathered by block_is_dead and
+	// applied together by train_batch, in order
+
+	struct sampler_training {
+		const unsigned int *trace_buffer;
+		unsigned int tables;
+		bool dead;
+	};
+
+	vector<sampler_training>
+		training_batch;
+};
+
+} // namespace Replacement
+
+#endif
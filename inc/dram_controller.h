@@ -2,6 +2,8 @@
 #define DRAM_H
 
 #include "memory_class.h"
+#include "dram_mapping.h"
+#include "dram_timing.h"
 
 // DRAM configuration
 #define DRAM_CHANNEL_WIDTH 8 // 8B
@@ -16,11 +18,33 @@
 #define DRAM_DBUS_TURN_AROUND_TIME ((15*CPU_FREQ)/2000) // 7.5 ns 
 extern uint32_t DRAM_MTPS, DRAM_DBUS_RETURN_TIME, DRAM_DBUS_MAX_CAS;
 
-// these values control when to send out a burst of writes
+// these values control when to send out a burst of writes, the defaults of -dram_write_high_wm and
+// -dram_write_low_wm; -dram_write_min_batch defaults to 0, not MIN_DRAM_WRITES_PER_SWITCH
 #define DRAM_WRITE_HIGH_WM    ((DRAM_WQ_SIZE*7)>>3) // 7/8th
 #define DRAM_WRITE_LOW_WM     ((DRAM_WQ_SIZE*3)>>2) // 6/8th
 #define MIN_DRAM_WRITES_PER_SWITCH (DRAM_WQ_SIZE*1/4)
 
+// -dram_write_drain: when the channel switches to writes and back
+// watermark: writes from the high watermark until the low one, or the reads run out
+// eager:     also when there are no reads (the default)
+// rowhit:    eager, but once reads wait the drain only schedules row hits, and ends when they run out
+enum DRAM_WRITE_DRAIN { DRAIN_WATERMARK, DRAIN_EAGER, DRAIN_ROW_HIT };
+
+// per channel, to show what write drains cost the reads
+struct DRAM_WRITE_DRAIN_STATS {
+    uint64_t drains = 0, drain_writes = 0, drain_cycles = 0,
+             reads = 0, read_latency = 0, // the reads forwarded from the WQ count with no latency
+             forwarded_reads = 0,
+             reads_inflated = 0, read_inflation = 0; // the reads in the RQ while in write mode, and for how long
+};
+
+// per bank, to show how many banks the address mapping keeps busy at once
+struct DRAM_BANK_STATS {
+    uint64_t reads = 0, writes = 0, row_buffer_hits = 0,
+             busy_cycles = 0,     // scheduled to done, summed over requests
+             scheduled_cycle = 0; // of the request in flight
+};
+
 // DRAM
 class MEMORY_CONTROLLER : public MEMORY {
   public:
@@ -35,6 +59,23 @@ class MEMORY_CONTROLLER : public MEMORY {
 
     BANK_REQUEST bank_request[DRAM_CHANNELS][DRAM_RANKS][DRAM_BANKS];
 
+    DRAMMapping mapping;
+    DRAMTiming timing;
+
+    // write drain policy
+    DRAM_WRITE_DRAIN write_drain = DRAIN_EAGER;
+    uint32_t write_high_wm = DRAM_WRITE_HIGH_WM, write_low_wm = DRAM_WRITE_LOW_WM, min_writes_per_switch = 0;
+
+    DRAM_WRITE_DRAIN_STATS write_drain_stats[DRAM_CHANNELS];
+    uint64_t write_mode_cycles[DRAM_CHANNELS] = {}, write_mode_begin[DRAM_CHANNELS] = {};
+    uint32_t drain_writes[DRAM_CHANNELS] = {};
+    uint64_t rq_arrival[DRAM_CHANNELS][DRAM_RQ_SIZE], rq_arrival_write_mode_cycles[DRAM_CHANNELS][DRAM_RQ_SIZE];
+    DRAM_BANK_STATS bank_stats[DRAM_CHANNELS][DRAM_RANKS][DRAM_BANKS];
+    uint64_t bank_stats_begin_cycle = 0;
+
+    // -infinite_dram_bw: reads waiting out the unloaded latency, in arrival order
+    deque<PACKET> ideal_returns;
+
     // queues
     vector<PACKET_QUEUE> WQ, RQ;
 
@@ -96,10 +137,15 @@ class MEMORY_CONTROLLER : public MEMORY {
     uint32_t get_occupancy(uint8_t queue_type, uint64_t address),
              get_size(uint8_t queue_type, uint64_t address);
 
-    void schedule(PACKET_QUEUE *queue), process(PACKET_QUEUE *queue),
+    void schedule(PACKET_QUEUE *queue, bool row_hits_only = false), process(PACKET_QUEUE *queue),
          update_schedule_cycle(PACKET_QUEUE *queue),
          update_process_cycle(PACKET_QUEUE *queue),
-         reset_remain_requests(PACKET_QUEUE *queue, uint32_t channel);
+         reset_remain_requests(PACKET_QUEUE *queue, uint32_t channel),
+         reset_bank_stats(uint64_t cycle),
+         refresh(uint32_t channel),
+         switch_write_mode(uint32_t channel, uint8_t mode),
+         reset_write_drain_stats(),
+         count_bank_request(uint32_t channel, uint32_t rank, uint32_t bank, bool write, uint64_t cycle);
 
     uint32_t dram_get_channel(uint64_t address),
              dram_get_rank   (uint64_t address),
@@ -108,7 +154,10 @@ class MEMORY_CONTROLLER : public MEMORY {
              dram_get_column (uint64_t address),
              drc_check_hit (uint64_t address, uint32_t cpu, uint32_t channel, uint32_t rank, uint32_t bank, uint32_t row);
 
-    uint64_t get_bank_earliest_cycle();
+    uint64_t get_bank_earliest_cycle(),
+             get_write_mode_cycles(uint32_t channel);
+
+    bool has_row_hit(PACKET_QUEUE *queue);
 
     int check_dram_queue(PACKET_QUEUE *queue, PACKET *packet);
 };
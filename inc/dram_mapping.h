@@ -0,0 +1,55 @@
+#ifndef DRAM_MAPPING_H
+#define DRAM_MAPPING_H
+
+/*
+ * Block address to DRAM channel, rank, bank, row and column (-dram_mapping,
+ * -dram_interleave).
+ *
+ * -dram_interleave line (default): consecutive blocks go to consecutive
+ * channels, then banks; from the low address bits the fields are channel,
+ * bank, column, rank and row.
+ * -dram_interleave row: consecutive blocks fill a row of one bank before the
+ * next channel and bank; the fields are column, channel, bank, rank and row.
+ *
+ * -dram_mapping bitslice (default): each field is its address bits as is.
+ * -dram_mapping xor: permutation-based interleaving [Zhang et al., MICRO'00],
+ * the bank, rank and channel bits are XORed with the low row bits. The rows
+ * that would conflict in one bank are spread over all of them, and the
+ * blocks of one row still share a bank, so row buffer hits are kept.
+ *
+ * Each of these makes every coordinate bit the XOR of some address bits, so
+ * any of them is precomputed into one table per address byte and map() costs
+ * a few lookups. It returns the coordinates packed as the default mapping
+ * lays them out, which is what MEMORY_CONTROLLER::dram_get_* slice.
+ */
+
+#include <array>
+#include <string>
+#include <vector>
+#include "champsim.h"
+
+class DRAMMapping
+{
+  public:
+    // @return false if there is no such mapping or interleaving
+    bool configure(const string &mapping, const string &interleave);
+
+    uint64_t map(uint64_t address) const
+    {
+        if (identity)
+            return address;
+
+        uint64_t coordinates = 0;
+        for (uint32_t i = 0; i < table.size(); i++)
+            coordinates ^= table[i][(address >> (8 * i)) & 0xff];
+        return coordinates;
+    }
+
+    string mapping = "bitslice", interleave = "line";
+
+  private:
+    bool identity = true; // bitslice with line interleaving, the layout map() returns
+    vector<array<uint64_t, 256>> table;
+};
+
+#endif
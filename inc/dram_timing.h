@@ -0,0 +1,112 @@
+#ifndef DRAM_TIMING_H
+#define DRAM_TIMING_H
+
+/*
+ * DDR4/DDR5 style DRAM timing (-dram_timing ddr4|ddr5; legacy, the default,
+ * is MEMORY_CONTROLLER's tRP/tRCD/tCAS only).
+ *
+ * Besides tRP/tRCD/tCAS, which stay those of the legacy model so the two
+ * compare, a request has to respect
+ * - tRAS, tRC, tRTP and tWR on its bank,
+ * - tRRD_S/tRRD_L and tCCD_S/tCCD_L between banks of other/the same bank
+ *   group, DRAM_BANKS_PER_GROUP banks to a group,
+ * - tFAW, at most four activates in a window, per rank,
+ * - a refresh of each rank every tREFI, which closes its rows and holds off
+ *   activates for tRFC.
+ *
+ * MEMORY_CONTROLLER::schedule still picks the request. issue() then places its
+ * precharge, activate and column command at the first cycle each is legal and
+ * returns when its data is ready. A bank serves one request at a time, so it
+ * keeps its next legal activate and precharge cycle. The banks of a rank do
+ * not: a bank waiting out tRC or a refresh books its commands ahead of the
+ * others, so a rank keeps every activate and column command booked on it that
+ * can still constrain a new one, in cycle order, and a command fits between
+ * them as well as after. The lists are pruned to the last tFAW/tCCD_L, a few
+ * entries each.
+ *
+ * A request the controller takes back before its commands are issued (the
+ * read/write mode switches reset the scheduled requests) is cancel()ed, which
+ * frees what it booked, so only the activates that really happen are counted
+ * and constrain the others. Everything runs on the clock of CPU 0.
+ */
+
+#include <string>
+#include <vector>
+#include "champsim.h"
+
+#define DRAM_BANKS_PER_GROUP 4
+#define DRAM_BANK_GROUPS ((DRAM_BANKS + DRAM_BANKS_PER_GROUP - 1) / DRAM_BANKS_PER_GROUP)
+
+class DRAMTiming
+{
+  public:
+    // @return false if there is no such timing
+    bool configure(const string &name);
+
+    // @param row_hit the bank has the row open
+    // @param row_open the bank has another row open, to be precharged
+    // @return the cycle the data is ready
+    uint64_t issue(uint32_t channel, uint32_t rank, uint32_t bank, bool row_hit, bool row_open, bool write,
+                   uint64_t cycle);
+
+    bool refresh_due(uint32_t channel, uint32_t rank, uint64_t cycle) const
+    {
+        return cycle >= ranks[channel][rank].next_refresh;
+    }
+
+    // refresh the rank from start, after the requests in flight on it
+    void refresh(uint32_t channel, uint32_t rank, uint64_t start);
+
+    // take back the commands of the bank's request not issued by cycle
+    // @return true if the request's row is open, it was a row hit or its activate was issued
+    bool cancel(uint32_t channel, uint32_t rank, uint32_t bank, uint64_t cycle);
+
+    void reset_stats();
+    void print_stats() const;
+
+    bool enabled = false;
+    string name = "legacy";
+
+  private:
+    // all in CPU cycles
+    uint64_t tRAS = 0, tRC = 0, tRRD_S = 0, tRRD_L = 0, tFAW = 0, tCCD_S = 0, tCCD_L = 0, tRTP = 0, tWR = 0,
+             tREFI = 0, tRFC = 0;
+
+    struct Bank {
+        uint64_t next_activate = 0, next_precharge = 0;
+
+        // what the request on the bank booked, and the state before it, for cancel()
+        uint64_t precharge = 0, activate = 0, column = 0, prior_next_activate = 0, prior_next_precharge = 0;
+        int binding = -1;
+        uint64_t binding_delay = 0, column_wait = 0;
+    };
+
+    struct Command {
+        uint64_t cycle;
+        uint32_t group;
+    };
+
+    struct Rank {
+        vector<Command> activates, columns; // booked, in cycle order
+        uint64_t next_refresh = 0, refresh_end = 0;
+    };
+
+    // the first cycle from cycle on at least gap_s from every booked command and gap_l from those of group
+    static uint64_t spaced(const vector<Command> &booked, uint64_t cycle, uint32_t group, uint64_t gap_s, uint64_t gap_l);
+    // the first cycle from cycle on that would not be a fifth activate within tFAW
+    uint64_t four_activate_window(const vector<Command> &booked, uint64_t cycle) const;
+    // drop the commands that can no longer constrain one at cycle or later
+    static void prune(vector<Command> &booked, uint64_t cycle, uint64_t horizon);
+    static void book(vector<Command> &booked, uint64_t cycle, uint32_t group);
+    static void unbook(vector<Command> &booked, uint64_t cycle, uint32_t group);
+
+    Bank banks[DRAM_CHANNELS][DRAM_RANKS][DRAM_BANKS];
+    Rank ranks[DRAM_CHANNELS][DRAM_RANKS];
+
+    // which constraint held an activate back, and for how many cycles in total
+    enum Constraint { PRECHARGE, BANK_tRC, RANK_tRRD, RANK_tFAW, RANK_REFRESH, NUM_CONSTRAINTS };
+    uint64_t activates = 0, cancelled_activates = 0, refreshes = 0, column_delay = 0;
+    uint64_t delayed[NUM_CONSTRAINTS] = {}, delay[NUM_CONSTRAINTS] = {};
+};
+
+#endif
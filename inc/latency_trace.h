@@ -0,0 +1,101 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+/*
+ * Where a request spends its latency (-latency_trace FILE,
+ * -latency_trace_period N, -latency_trace_max N).
+ *
+ * Every Nth demand access to the L1D and every Nth prefetch a L1D, L2C or
+ * LLC prefetcher issues gets a record, and its PACKET carries the record's
+ * id down the hierarchy and back. Each CACHE queue, MSHR and the DRAM
+ * controller log the cycles the request enters and leaves them:
+ * - RQ/WQ/PQ: in the queue of that cache, RFOs enter the L1D by its WQ,
+ * - MSHR: in the MSHR of that cache, which includes the levels below,
+ * - fill: the data is back in the MSHR and waits to be filled,
+ * - DRAM queue/access: in the DRAM RQ, and from schedule to return.
+ * The record ends when the data reaches the level the request fills, or the
+ * request is dropped. A request that merges into another one's MSHR at that
+ * level waits in it until it fills, and a demand that merges into a traced
+ * prefetch's MSHR makes that prefetch late.
+ *
+ * The records are written to FILE in the Chrome trace format (chrome://tracing
+ * or ui.perfetto.dev; one microsecond there is one cycle), one track per
+ * request, and per stage log2 latency histograms of loads, RFOs, prefetches
+ * and late prefetches are printed with the stats.
+ *
+ * Tracing is off when trace_id is 0, each hook is a test of it. At most
+ * -latency_trace_max records, with up to LATENCY_TRACE_HOPS each, are kept;
+ * a record that runs out of hops is truncated, its latency is printed apart
+ * and its stages are left out of the histograms.
+ */
+
+#include <string>
+#include <vector>
+#include "memory_class.h"
+
+#define LATENCY_TRACE_HOPS 48
+#define LATENCY_TRACE_DRAM 7 // levels are IS_ITLB to IS_LLC, then DRAM
+
+class LatencyTrace
+{
+  public:
+    enum Span : uint8_t { RQ, WQ, PQ, MSHR, FILL, DRAM_QUEUE, DRAM_ACCESS, NUM_SPANS };
+
+    // @return the id of the new record, 0 if the request is not sampled
+    uint32_t sample(const PACKET &packet, uint8_t level, uint64_t cycle);
+
+    void begin(uint32_t id, uint8_t level, Span span, uint64_t cycle) { hop(id, level, span, true, cycle); }
+    void end(uint32_t id, uint8_t level, Span span, uint64_t cycle) { hop(id, level, span, false, cycle); }
+
+    // the data got to a cache that fills at fill_level, or the request ends there
+    void arrive(uint32_t id, uint32_t fill_level, uint64_t cycle);
+
+    // a demand merged into the prefetch's MSHR
+    void late(uint32_t id, uint64_t cycle);
+
+    // the request merged into another one's MSHR of the cache, it waits for that to fill
+    void merge(uint32_t id, const MEMORY *cache, uint8_t level, uint64_t address, uint32_t fill_level, uint64_t cycle);
+    void fill(const MEMORY *cache, uint8_t level, uint64_t address, uint32_t fill_level, uint64_t cycle);
+    bool merged_waiting() const { return !waiting.empty(); }
+
+    void print_stats() const;
+    void write() const;
+
+    bool enabled = false;
+    string path;
+    uint32_t period = 100, max_records = 10000;
+
+  private:
+    struct Hop {
+        uint64_t cycle;
+        uint8_t level, span, begin;
+    };
+
+    struct Record {
+        uint64_t address, begin_cycle, done_cycle = 0, late_cycle = 0;
+        uint32_t cpu, fill_level, hops = 0;
+        uint8_t type;
+        bool truncated = false, merged = false;
+        Hop hop[LATENCY_TRACE_HOPS];
+    };
+
+    enum Class { LOAD_CLASS, RFO_CLASS, PREFETCH_CLASS, LATE_PREFETCH_CLASS, NUM_CLASSES };
+    static const int BUCKETS = 32;
+
+    void hop(uint32_t id, uint8_t level, Span span, bool begin, uint64_t cycle);
+    int record_class(const Record &record) const;
+
+    struct Waiting {
+        uint32_t id;
+        const MEMORY *cache;
+        uint64_t address;
+    };
+
+    vector<Record> records;
+    vector<Waiting> waiting;
+    uint64_t candidates = 0, truncated = 0, merged = 0;
+};
+
+extern LatencyTrace latency_trace;
+
+#endif
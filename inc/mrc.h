@@ -0,0 +1,66 @@
+#ifndef MRC_H
+#define MRC_H
+
+/*
+ * Single-pass miss-ratio curves.
+ *
+ * -mrc_l2c / -mrc_llc attach a profiler to the stream of requests entering
+ * that cache (new RQ, WQ and PQ entries, plus warm_access during functional
+ * fast-forward). Every access measures its LRU stack distance, the number of
+ * distinct blocks touched since the previous access to the same block, with a
+ * Fenwick tree over access timestamps, so one simulation gives the demand miss
+ * ratio of a fully-associative LRU cache of every capacity. The histogram is
+ * cleared at the end of the warmup, the stack is kept. Under -sample only the
+ * measured windows are counted, so the MPKI shares their instruction count;
+ * the fast-forward and the detailed warmup just keep the stack warm.
+ *
+ * -mrc_rate R < 1 turns on SHARDS-style spatial sampling: only blocks whose
+ * hash falls below R are tracked and their distances and counts are scaled by
+ * 1/R, which bounds the memory and time of LLC profiling on long traces.
+ *
+ * The curve ignores set conflicts and the installed replacement policy, and a
+ * different LLC size would also change the timing and so the prefetch stream;
+ * it answers "how much capacity does this access stream need", not the IPC.
+ */
+
+#include <unordered_map>
+#include <vector>
+#include "memory_class.h"
+
+class MRCProfiler
+{
+  public:
+    MRCProfiler(const string &name, double rate);
+
+    // one lookup of a block address, any request type
+    void access(uint64_t block, uint8_t type);
+    // start a new measurement, the LRU stack is kept warm
+    void reset_stats();
+    // miss ratio and MPKI per capacity from 16 KB, two points per octave
+    void print(uint64_t instructions, uint64_t configured_blocks);
+
+    // cleared outside the measured windows of -sample, accesses then only update the stack
+    bool counting = true;
+
+  private:
+    // 0..15 are exact distances, then 8 buckets per power of two
+    static uint32_t bucket(uint64_t distance);
+    static uint64_t bucket_start(uint32_t index);
+
+    void mark(uint64_t time, int delta);
+    uint64_t marked_up_to(uint64_t time);
+    void compact();
+
+    string name;
+    uint32_t threshold;
+    double rate;
+
+    unordered_map<uint64_t, uint64_t> last_access;
+    vector<int32_t> tree;
+    uint64_t now = 0;
+
+    vector<uint64_t> hist;
+    uint64_t cold = 0, demand = 0, sampled = 0;
+};
+
+#endif
@@ -82,9 +82,16 @@ public:
   uint8_t fetch_stall;
   uint64_t fetch_resume_cycle;
   uint64_t num_branch, branch_mispredictions;
+  uint64_t roi_branch_mispredictions; // at the end of the ROI, or in the measured windows with -sample
   uint64_t total_rob_occupancy_at_branch_mispredict;
   uint64_t total_branch_types[8];
 
+  // oracle L1D prefetcher: trace instructions read ahead of the front end, and
+  // how often they touch each block of each virtual page
+  uint64_t oracle_lookahead;
+  deque<input_instr> oracle_window;
+  map<uint64_t, vector<uint32_t>> oracle_footprint;
+
   // TLBs and caches
   CACHE ITLB{"ITLB", ITLB_SET, ITLB_WAY, ITLB_SET *ITLB_WAY, ITLB_WQ_SIZE, ITLB_RQ_SIZE, ITLB_PQ_SIZE, ITLB_MSHR_SIZE},
       DTLB{"DTLB", DTLB_SET, DTLB_WAY, DTLB_SET *DTLB_WAY, DTLB_WQ_SIZE, DTLB_RQ_SIZE, DTLB_PQ_SIZE, DTLB_MSHR_SIZE},
@@ -137,11 +144,14 @@ public:
     fetch_resume_cycle = 0;
     num_branch = 0;
     branch_mispredictions = 0;
+    roi_branch_mispredictions = 0;
     for (uint32_t i = 0; i < 8; i++)
     {
       total_branch_types[i] = 0;
     }
 
+    oracle_lookahead = 0;
+
     for (uint32_t i = 0; i < STA_SIZE; i++)
       STA[i] = UINT64_MAX;
     STA_head = 0;
@@ -180,6 +190,8 @@ public:
 
   // functions
   void read_from_trace(),
+      warm_instruction(),
+      reopen_trace(),
       fetch_instruction(),
       decode_and_dispatch(),
       schedule_instruction(),
@@ -220,6 +232,11 @@ public:
 
   uint32_t check_and_add_lsq(uint32_t rob_index);
 
+  // the next trace instruction, through the oracle window when it is on
+  bool next_trace_instr(input_instr *instr);
+  void track_footprint(const input_instr &instr, int delta);
+  uint64_t future_footprint(uint64_t v_addr);
+
   // branch predictor
   uint8_t predict_branch(uint64_t ip);
   void initialize_branch_predictor(),
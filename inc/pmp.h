@@ -0,0 +1,999 @@
+#ifndef _PMP_H_
+#define _PMP_H_
+
+/*
+ * Pattern Merging Prefetcher tables, shared by the L1D, L2C and LLC variants
+ * (prefetcher/pmp.{l1d,l2c,llc}_pref). The pattern tables are trained at L1D
+ * only; the lower levels run a PrefetchBuffer fed by the L1D instance.
+ *
+ * Issuing is templated on the cache so the tables can also be driven by the
+ * functional L1D model of tools/pmp_sim.cc; anything with NAME, PQ, MSHR and
+ * prefetch_line() like CACHE will do.
+ */
+
+#include "cache.h"
+#include "common.h"
+#include "component.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+#define DEBUG(x)
+#define BOTTOM_BITS 6
+#define PC_BITS 5
+#define BACKOFF_TIMES 1
+
+#define IN_REGION_BITS 12
+#define OFFSET_BITS (IN_REGION_BITS - BOTTOM_BITS)
+#define OFFSET_MASK ((1 << OFFSET_BITS) - 1)
+#define __fine_offset(addr) (addr & OFFSET_MASK)
+#define __coarse_offset(fine_offset) ((fine_offset) >> (LOG2_BLOCK_SIZE - BOTTOM_BITS))
+
+#define START_CONF 0
+
+/* table payloads are fixed-size so they live inside the tables' arenas */
+#define MAX_PATTERN_LEN (1 << OFFSET_BITS)
+
+#define PATTERN_DEGRADE_LEVEL 2
+
+class FilterTableData
+{
+public:
+    int offset;
+    uint64_t pc;
+};
+
+#define FT_CACHE_TYPE SRRIPSetAssociativeCache
+
+class FilterTable : public FT_CACHE_TYPE<FilterTableData>
+{
+    typedef FT_CACHE_TYPE<FilterTableData> Super;
+
+public:
+    FilterTable(int size, int debug_level = 0, int num_ways = 16) : Super(size, num_ways)
+    {
+        if (this->debug_level >= 1)
+            cerr << "FilterTable::FilterTable(size=" << size << ", debug_level=" << debug_level
+                 << ", num_ways=" << num_ways << ")" << dec << endl;
+    }
+
+    Entry *find(uint64_t region_number)
+    {
+        if (this->debug_level >= 2)
+            cerr << "FilterTable::find(region_number=0x" << hex << region_number << ")" << dec << endl;
+        uint64_t key = this->build_key(region_number);
+        Entry *entry = Super::find(key);
+        if (!entry)
+        {
+            if (this->debug_level >= 2)
+                cerr << "[FilterTable::find] Miss!" << dec << endl;
+            return nullptr;
+        }
+        if (this->debug_level >= 2)
+            cerr << "[FilterTable::find] Hit!" << dec << endl;
+        Super::rp_promote(key);
+        return entry;
+    }
+
+    void insert(uint64_t region_number, int offset, uint64_t pc)
+    {
+        if (this->debug_level >= 2)
+            cerr << "FilterTable::insert(region_number=0x" << hex << region_number 
+                 << ", offset=" << dec << offset << ")" << dec << endl;
+        uint64_t key = this->build_key(region_number);
+        Super::insert(key, {offset, pc});
+        Super::rp_insert(key);
+    }
+
+    Entry *erase(uint64_t region_number)
+    {
+        uint64_t key = this->build_key(region_number);
+        return Super::erase(key);
+    }
+
+    string log()
+    {
+        vector<string> headers({"Region", "Offset"});
+        return Super::log(headers);
+    }
+
+private:
+    void write_data(Entry &entry, Table &table, int row)
+    {
+        uint64_t key = hash_index(entry.key, this->index_len);
+        table.set_cell(row, 0, key);
+        table.set_cell(row, 1, entry.data.offset);
+    }
+
+    uint64_t build_key(uint64_t region_number)
+    {
+        uint64_t key = region_number & ((1ULL << 37) - 1);
+        return hash_index(key, this->index_len);
+    }
+};
+
+class AccumulationTableData
+{
+public:
+    int offset;
+    uint64_t pc;
+    bool pattern[MAX_PATTERN_LEN];
+};
+
+#define AT_CACHE_TYPE LRUSetAssociativeCache
+class AccumulationTable : public AT_CACHE_TYPE<AccumulationTableData>
+{
+    typedef AT_CACHE_TYPE<AccumulationTableData> Super;
+
+public:
+    AccumulationTable(int size, int pattern_len, int debug_level = 0, int num_ways = 16)
+        : Super(size, num_ways), pattern_len(pattern_len)
+    {
+        assert(pattern_len <= MAX_PATTERN_LEN);
+        if (this->debug_level >= 1)
+            cerr << "AccumulationTable::AccumulationTable(size=" << size << ", pattern_len=" << pattern_len
+                 << ", debug_level=" << debug_level << ", num_ways=" << num_ways << ")" << dec << endl;
+    }
+
+    bool set_pattern(uint64_t region_number, int offset)
+    {
+        if (this->debug_level >= 2)
+            cerr << "AccumulationTable::set_pattern(region_number=0x" << hex << region_number << ", offset=" << dec
+                 << offset << ")" << dec << endl;
+        uint64_t key = this->build_key(region_number);
+        Entry *entry = Super::find(key);
+        if (!entry)
+        {
+            if (this->debug_level >= 2)
+                cerr << "[AccumulationTable::set_pattern] Not found!" << dec << endl;
+            return false;
+        }
+        entry->data.pattern[offset] = true;
+        Super::rp_promote(key);
+        if (this->debug_level >= 2)
+            cerr << "[AccumulationTable::set_pattern] OK!" << dec << endl;
+        return true;
+    }
+
+    Entry insert(uint64_t region_number, uint64_t pc, int offset)
+    {
+        if (this->debug_level >= 2)
+            cerr << "AccumulationTable::insert(region_number=0x" << hex << region_number
+                 << ", offset=" << dec << offset << dec << endl;
+        uint64_t key = this->build_key(region_number);
+        AccumulationTableData data = {offset, pc, {}};
+        data.pattern[__coarse_offset(offset)] = true;
+        Entry old_entry = Super::insert(key, data);
+        Super::rp_insert(key);
+        return old_entry;
+    }
+
+    Entry *erase(uint64_t region_number)
+    {
+        uint64_t key = this->build_key(region_number);
+        return Super::erase(key);
+    }
+
+    string log()
+    {
+        vector<string> headers({"Region", "Offset", "Pattern"});
+        return Super::log(headers);
+    }
+
+private:
+    void write_data(Entry &entry, Table &table, int row)
+    {
+        uint64_t key = hash_index(entry.key, this->index_len);
+        table.set_cell(row, 0, key);
+        table.set_cell(row, 1, entry.data.offset);
+        table.set_cell(row, 2, pattern_to_string(vector<bool>(entry.data.pattern, entry.data.pattern + this->pattern_len)));
+    }
+
+    uint64_t build_key(uint64_t region_number)
+    {
+        uint64_t key = region_number & ((1ULL << 37) - 1);
+        return hash_index(key, this->index_len);
+    }
+
+    int pattern_len;
+};
+
+
+class OffsetPatternTableData
+{
+public:
+    int pattern[MAX_PATTERN_LEN];
+};
+
+class OffsetPatternTable : public LRUSetAssociativeCache<OffsetPatternTableData>
+{
+    typedef LRUSetAssociativeCache<OffsetPatternTableData> Super;
+
+public:
+    OffsetPatternTable(int size, int pattern_len, int tag_size,
+                       int num_ways = 16, int max_conf = 32, 
+                       int debug_level = 0, int cpu = 0)
+        : Super(size, num_ways, debug_level), pattern_len(pattern_len), tag_size(tag_size),
+          max_conf(max_conf), cpu(cpu)
+    {
+        assert(pattern_len <= MAX_PATTERN_LEN);
+        if (this->debug_level >= 1)
+            cerr << "OffsetPatternTable::OffsetPatternTable(size=" << size << ", pattern_len=" << pattern_len
+                 << ", tag_size=" << tag_size 
+                 << ", debug_level=" << debug_level << ", num_ways=" << num_ways << ")"
+                 << dec << endl;
+    }
+
+    void insert(uint64_t address, uint64_t pc, vector<bool> pattern, int degrade_level)
+    {
+        if (this->debug_level >= 2)
+            cerr << "OffsetPatternTable::insert(" << hex << "address=0x" << address
+                 << ", pattern=" << pattern_to_string(pattern) << ")" << dec << endl;
+        int offset = __coarse_offset(__fine_offset(address));
+        offset /= degrade_level;
+        pattern = my_rotate(pattern, -offset);
+        uint64_t key = this->build_key(address, pc);
+        Entry *entry = Super::find(key);
+        assert(pattern[0]);
+        if (entry)
+        {
+            int max_value = 0;
+            auto &stored_pattern = entry->data.pattern; 
+            for (int i = 0; i < this->pattern_len; i++)
+            {
+                pattern[i] ? ADD(stored_pattern[i], max_conf) : 0;
+                if (i > 0 && max_value < stored_pattern[i]) {
+                    max_value = stored_pattern[i];
+                }
+            }
+            
+            if (entry->data.pattern[0] == max_conf) {
+                if (max_value < (1 << BACKOFF_TIMES)) {
+                    entry->data.pattern[0] = max_value;
+                }
+                else 
+                    for (int i = 0; i < this->pattern_len; i++) {
+                        stored_pattern[i] >>= BACKOFF_TIMES;
+                    }
+            }
+            Super::rp_promote(key);
+        }
+        else
+        {
+            OffsetPatternTableData data = {};
+            vector<int> converted = pattern_convert(pattern);
+            copy(converted.begin(), converted.end(), data.pattern);
+            Super::insert(key, data);
+            Super::rp_insert(key);
+        }
+    }
+
+    vector<OffsetPatternTableData> find(uint64_t pc, uint64_t block_number)
+    {
+        if (this->debug_level >= 2)
+            cerr << "OffsetPatternTable::find(pc=0x" << hex << pc << ", address=0x" << block_number << ")" << dec << endl;
+        uint64_t key = this->build_key(block_number, pc);
+        Entry* entry = Super::find(key);
+        vector<OffsetPatternTableData> matches;
+        if (entry)
+        {
+            auto &cur_pattern = entry->data;
+            matches.push_back(cur_pattern);
+        }
+        return matches;
+    }
+
+    string log()
+    {
+        vector<string> headers({"Key", "Pattern"});
+        return Super::log(headers);
+    }
+
+private:
+    void write_data(Entry &entry, Table &table, int row)
+    {
+
+        table.set_cell(row, 0, entry.key);
+        table.set_cell(row, 1, pattern_to_string(vector<int>(entry.data.pattern, entry.data.pattern + this->pattern_len)));
+    }
+
+    virtual uint64_t build_key(uint64_t address, uint64_t pc)
+    {
+        uint64_t offset = __fine_offset(address);
+        uint64_t key = offset & ((1 << this->tag_size) - 1);
+        return key;
+    }
+
+protected:
+    const int pattern_len;
+    const int tag_size, cpu;
+    const int max_conf;
+};
+
+class PCPatternTable : public OffsetPatternTable {
+public:
+    PCPatternTable(int size, int pattern_len, int tag_size,
+                   int num_ways = 16, int max_conf = 32, 
+                   int debug_level = 0, int cpu = 0) 
+                    : OffsetPatternTable(size, pattern_len, tag_size, num_ways, max_conf, debug_level,cpu) {}
+private:
+    virtual uint64_t build_key(uint64_t address, uint64_t pc) override {
+        return hash_index(pc, this->index_len) & ((1 << this->tag_size) - 1);
+    }
+};
+
+/*
+ * Bandwidth-aware throttling. The LLC broadcasts the DRAM bandwidth quartile every
+ * measure_dram_bw_epoch cycles; together with the accuracy/overprediction levels that
+ * handle_prefetch_feedback() keeps per cache it selects a throttle level. Level 0 is the
+ * unthrottled prefetcher, each level above raises the fill thresholds and lowers the degree.
+ */
+#define PMP_BW_THROTTLE 1
+#define PMP_THROTTLE_LEVELS 5
+
+/* blocks the background drain may issue per cycle */
+#define PF_DRAIN_DEGREE 1
+
+class PrefetchThrottle
+{
+public:
+    void update(uint8_t bw_level, uint32_t acc_level, uint32_t overprediction_level)
+    {
+#if PMP_BW_THROTTLE
+        /* only react once DRAM is more than half busy */
+        int level = bw_level >= 2 ? bw_level - 1 : 0;
+        if (level > 0)
+        {
+            if (acc_level >= CACHE_ACC_LEVELS * 3 / 4)
+                level -= 1;
+            else if (acc_level < CACHE_ACC_LEVELS / 4)
+                level += 1;
+            else if (overprediction_level >= CACHE_ACC_LEVELS / 2)
+            {
+                level += 1;
+                this->overprediction_raises += 1;
+            }
+        }
+        this->level = max(0, min(level, PMP_THROTTLE_LEVELS - 1));
+#endif
+        this->level_hist[this->level] += 1;
+    }
+
+    double l1d_thresh(double base) const { return min(1.0, base + 0.1 * this->level); }
+
+    double l2c_thresh(double base) const { return min(1.0, base + 0.05 * this->level); }
+
+    /* blocks issued per access to a region */
+    int access_degree() const
+    {
+        static const int degree[PMP_THROTTLE_LEVELS] = {INT_MAX, 16, 8, 4, 2};
+        return degree[this->level];
+    }
+
+    /* blocks drained per cycle when no access is pending; the drain stops above level 2 */
+    int drain_degree() const { return this->level >= 3 ? 0 : PF_DRAIN_DEGREE; }
+
+    string log() const
+    {
+        ostringstream oss;
+        oss << "Throttle level histogram:";
+        for (int i = 0; i < PMP_THROTTLE_LEVELS; i += 1)
+            oss << " " << this->level_hist[i];
+        oss << ", raised on overprediction: " << this->overprediction_raises << endl;
+        return oss.str();
+    }
+
+private:
+    int level = 0;
+    uint64_t level_hist[PMP_THROTTLE_LEVELS] = {};
+    uint64_t overprediction_raises = 0;
+};
+
+/* pending blocks are kept per fill level: FILL_L1, FILL_L2 and FILL_LLC */
+#define PF_BUFFER_LEVELS 3
+
+
+class PrefetchBufferData
+{
+public:
+    uint64_t region_number;
+    uint64_t pending[PF_BUFFER_LEVELS];
+    int last_offset; /* issue order is nearest-first from the last touched offset */
+    uint8_t metadata[MAX_PATTERN_LEN]; /* pf_metadata of each block, see PMP_META in common.h */
+};
+
+#define PS_CACHE_TYPE LRUSetAssociativeCache
+class PrefetchBuffer : public PS_CACHE_TYPE<PrefetchBufferData>
+{
+    typedef PS_CACHE_TYPE<PrefetchBufferData> Super;
+
+public:
+    PrefetchBuffer(int size, int pattern_len, int debug_level = 0, int num_ways = 16)
+        : Super(size, num_ways), pattern_len(pattern_len)
+    {
+        assert(pattern_len <= MAX_PATTERN_LEN && pattern_len <= 64);
+        if (this->debug_level >= 1)
+            cerr << "PrefetchBuffer::PrefetchBuffer(size=" << size << ", pattern_len=" << pattern_len
+                 << ", debug_level=" << debug_level << ", num_ways=" << num_ways << ")" << dec << endl;
+    }
+
+    void insert(uint64_t region_number, const vector<int> &pattern, int trigger_offset = 0,
+                const vector<uint32_t> &metadata = vector<uint32_t>())
+    {
+        if (this->debug_level >= 2)
+            cerr << "PrefetchBuffer::insert(region_number=0x" << hex << region_number
+                 << ", pattern=" << pattern_to_string(pattern) << ")" << dec << endl;
+        uint64_t key = this->build_key(region_number);
+        PrefetchBufferData data = {};
+        data.region_number = region_number;
+        data.last_offset = trigger_offset;
+        for (int i = 0; i < this->pattern_len; i += 1)
+            if (pattern[i] > 0)
+            {
+                data.pending[level_slot(pattern[i])] |= 1ULL << i;
+                data.metadata[i] = metadata.empty() ? 0 : metadata[i];
+            }
+        Super::insert(key, data);
+        Super::rp_insert(key);
+        this->idle = false;
+    }
+
+    /**
+     * Called on an access to the region: drops the touched block and issues the rest of the
+     * region nearest-first until the PQ/MSHR run out of room, on behalf of core `cpu`.
+     */
+    template <class Cache>
+    int prefetch(Cache *cache, uint32_t cpu, uint64_t block_address, int degree = INT_MAX)
+    {
+        if (this->debug_level >= 2)
+        {
+            cerr << "PrefetchBuffer::prefetch(cache=" << cache->NAME << ", block_address=0x" << hex << block_address
+                 << ")" << dec << endl;
+            cerr << "[PrefetchBuffer::prefetch] " << cache->PQ.occupancy << "/" << cache->PQ.SIZE
+                 << " PQ entries occupied." << dec << endl;
+            cerr << "[PrefetchBuffer::prefetch] " << cache->MSHR.occupancy << "/" << cache->MSHR.SIZE
+                 << " MSHR entries occupied." << dec << endl;
+        }
+        int region_offset = __coarse_offset(__fine_offset(block_address));
+        uint64_t region_number = block_address >> OFFSET_BITS;
+        uint64_t key = this->build_key(region_number);
+        Entry *entry = Super::find(key);
+        if (!entry)
+        {
+            if (this->debug_level >= 2)
+                cerr << "[PrefetchBuffer::prefetch] No entry found." << dec << endl;
+            return 0;
+        }
+        Super::rp_promote(key);
+        entry->data.last_offset = region_offset;
+        for (int i = 0; i < PF_BUFFER_LEVELS; i += 1)
+            entry->data.pending[i] &= ~(1ULL << region_offset);
+        return this->issue(cache, cpu, entry, degree);
+    }
+
+    /**
+     * Called every cycle: keeps issuing the most recently used region with pending blocks, so
+     * a pattern does not have to wait for the next access to its region.
+     */
+    template <class Cache>
+    int drain(Cache *cache, uint32_t cpu, int degree = PF_DRAIN_DEGREE)
+    {
+        if (this->idle || degree <= 0)
+            return 0;
+
+        Entry *best = nullptr;
+        uint64_t best_lru = 0;
+        for (int i = 0; i < this->num_sets; i += 1)
+        {
+            Entry *set = this->get_set(i);
+            uint64_t *lru_set = this->get_lru_set(i);
+            for (int j = 0; j < this->num_ways; j += 1)
+                if (set[j].valid && has_pending(set[j].data) && (!best || lru_set[j] > best_lru))
+                {
+                    best = &set[j];
+                    best_lru = lru_set[j];
+                }
+        }
+
+        if (!best)
+        {
+            this->idle = true;
+            return 0;
+        }
+        return this->issue(cache, cpu, best, degree);
+    }
+
+    string log()
+    {
+        vector<string> headers({"Region", "Pattern"});
+        return Super::log(headers);
+    }
+
+private:
+    static int level_slot(int fill_level) { return fill_level == FILL_L1 ? 0 : fill_level == FILL_L2 ? 1 : 2; }
+
+    static int slot_level(int slot) { return slot == 0 ? FILL_L1 : slot == 1 ? FILL_L2 : FILL_LLC; }
+
+    static bool has_pending(const PrefetchBufferData &data)
+    {
+        return (data.pending[0] | data.pending[1] | data.pending[2]) != 0;
+    }
+
+    static int slot_of(const PrefetchBufferData &data, int offset)
+    {
+        for (int i = 0; i < PF_BUFFER_LEVELS; i += 1)
+            if ((data.pending[i] >> offset) & 1)
+                return i;
+        return -1;
+    }
+
+    /**
+     * Picks the pending block closest to `last_offset`. On a tie the lower fill level goes
+     * first, then the block above the trigger, matching the old outward scan.
+     * @return The offset to issue, or -1 if nothing is pending
+     */
+    static int next_offset(const PrefetchBufferData &data)
+    {
+        uint64_t all = data.pending[0] | data.pending[1] | data.pending[2];
+        if (!all)
+            return -1;
+        int o = data.last_offset;
+        if ((all >> o) & 1)
+            return o;
+        uint64_t up = o >= 63 ? 0 : all & (~0ULL << (o + 1));
+        uint64_t down = all & ((1ULL << o) - 1);
+        int u = up ? __builtin_ctzll(up) : -1;
+        int d = down ? 63 - __builtin_clzll(down) : -1;
+        if (u < 0)
+            return d;
+        if (d < 0)
+            return u;
+        if (u - o != o - d)
+            return u - o < o - d ? u : d;
+        return slot_of(data, d) < slot_of(data, u) ? d : u;
+    }
+
+    template <class Cache>
+    int issue(Cache *cache, uint32_t cpu, Entry *entry, int degree)
+    {
+        PrefetchBufferData &data = entry->data;
+        uint64_t base_addr = (data.region_number * this->pattern_len + data.last_offset) << LOG2_BLOCK_SIZE;
+        int pf_issued = 0, pf_tried = 0;
+        DEBUG(cout << "[Prefetch Begin] base_addr " << hex << base_addr << ", " << dec;)
+        for (int pf_offset = next_offset(data); pf_offset >= 0; pf_offset = next_offset(data))
+        {
+            if (pf_tried >= degree)
+                break;
+            if (!(cache->PQ.occupancy + cache->MSHR.occupancy < cache->MSHR.SIZE - 1 &&
+                  cache->PQ.occupancy < cache->PQ.SIZE))
+            {
+                DEBUG(cout << endl;)
+                return pf_issued;
+            }
+            DEBUG(cout << pf_offset << " ";)
+            int slot = slot_of(data, pf_offset);
+            uint64_t pf_address = (data.region_number * this->pattern_len + pf_offset) << LOG2_BLOCK_SIZE;
+            pf_issued += cache->prefetch_line(cpu, 0, base_addr, pf_address, slot_level(slot), data.metadata[pf_offset]);
+            data.pending[slot] &= ~(1ULL << pf_offset);
+            pf_tried += 1;
+        }
+        DEBUG(cout << endl;)
+        if (!has_pending(data))
+            Super::erase(this->build_key(data.region_number));
+        return pf_issued;
+    }
+
+    void write_data(Entry &entry, Table &table, int row)
+    {
+        vector<int> pattern(this->pattern_len, 0);
+        for (int i = 0; i < this->pattern_len; i += 1)
+        {
+            int slot = slot_of(entry.data, i);
+            pattern[i] = slot < 0 ? 0 : slot_level(slot);
+        }
+        uint64_t key = hash_index(entry.key, this->index_len);
+        table.set_cell(row, 0, key);
+        table.set_cell(row, 1, pattern_to_string(pattern));
+    }
+
+    uint64_t build_key(uint64_t region_number)
+    {
+        uint64_t key = region_number;
+        return hash_index(key, this->index_len);
+    }
+
+    int pattern_len;
+    bool idle = true; /* no entry has pending blocks */
+};
+
+/*
+ * PrefetchBuffers registered by pmp.l2c_pref / pmp.llc_pref. The L1D instance forwards the
+ * low-confidence part of each pattern to them so those blocks are issued from the lower
+ * level's own PQ/MSHR. Null when that level runs another prefetcher, in which case L1D
+ * issues the whole pattern itself.
+ */
+inline PrefetchBuffer *&pmp_l2c_buffer(uint32_t cpu)
+{
+    static PrefetchBuffer *buffers[NUM_CPUS] = {};
+    return buffers[cpu];
+}
+
+inline PrefetchBuffer *&pmp_llc_buffer(uint32_t cpu)
+{
+    static PrefetchBuffer *buffers[NUM_CPUS] = {};
+    return buffers[cpu];
+}
+
+/*
+ * Fills, demand hits and late arrivals of the PMP prefetches in `cache` by the table and
+ * confidence of their vote, read back from the pref_* counters CACHE keeps by pf_metadata.
+ */
+template <class Cache>
+void pmp_confidence_stats(Cache *cache, const string &prefix)
+{
+    for (int conf = 0; conf <= PMP_META_CONF_MAX; conf += 1)
+    {
+        uint64_t filled[2] = {}, useful[2] = {}, late[2] = {};
+        for (int ppt = 0; ppt < 2; ppt += 1)
+            for (int i = 0; i < NUM_CPUS; i += 1)
+            {
+                filled[ppt] += cache->pref_filled[i][PMP_META(conf, ppt)];
+                useful[ppt] += cache->pref_useful[i][PMP_META(conf, ppt)];
+                late[ppt] += cache->pref_late[i][PMP_META(conf, ppt)];
+            }
+        if (!filled[0] && !filled[1] && !late[0] && !late[1])
+            continue;
+        cout << prefix << " PMP confidence " << setw(2) << conf << "/" << PMP_META_CONF_MAX;
+        for (int ppt = 0; ppt < 2; ppt += 1)
+            cout << (ppt ? "  PPT" : "  OPT") << " filled: " << setw(8) << filled[ppt] << " useful: " << setw(8)
+                 << useful[ppt] << " late: " << setw(8) << late[ppt];
+        cout << endl;
+    }
+}
+
+class PMP 
+{
+public:
+     PMP(int pattern_len, int offset_width, int opt_size, int opt_max_conf, int opt_ways, int pc_width, 
+          int ppt_size, int ppt_max_conf, int ppt_ways,int filter_table_size, int ft_way,
+          int accumulation_table_size, int at_way, int pf_buffer_size, int pf_buffer_way,
+          int debug_level = 0, int cpu = 0, int degrade_level = PATTERN_DEGRADE_LEVEL)
+        : pattern_len(pattern_len), degrade_level(degrade_level),
+          opt(opt_size, pattern_len, offset_width, opt_ways, opt_max_conf, debug_level, cpu),
+          ppt(ppt_size, pattern_len/degrade_level, pc_width, ppt_ways, ppt_max_conf, debug_level, cpu),
+          filter_table(filter_table_size, debug_level, ft_way),
+          accumulation_table(accumulation_table_size, pattern_len, debug_level, at_way),
+          pf_buffer(pf_buffer_size, pattern_len, debug_level, pf_buffer_way), 
+          debug_level(debug_level), cpu(cpu)
+    {
+        assert(pattern_len % degrade_level == 0);
+        if (this->debug_level >= 1)
+            cerr << " PMP:: PMP(pattern_len=" << pattern_len 
+                 << ", filter_table_size=" << filter_table_size
+                 << ", accumulation_table_size=" << accumulation_table_size 
+                 << ", pf_buffer_size=" << pf_buffer_size
+                 << ", debug_level=" << debug_level << ")" << endl;
+    }
+
+
+    void access(uint64_t block_number, uint64_t pc)
+    {
+        if (this->debug_level >= 2)
+            cerr << "[ PMP] access(block_number=0x" << hex << block_number << ", pc=0x" << pc << ")" << dec << endl;
+
+        uint64_t region_number = block_number >> OFFSET_BITS;
+        int region_offset = __fine_offset(block_number);
+        bool success = this->accumulation_table.set_pattern(region_number, __coarse_offset(region_offset));
+        if (success)
+            return;
+        FilterTable::Entry *entry = this->filter_table.find(region_number);
+        if (!entry)
+        {
+
+            this->filter_table.insert(region_number, region_offset, pc);
+            vector<uint32_t> metadata;
+            vector<int> pattern = this->find_in_opt(pc, block_number, metadata);
+            if (pattern.empty())
+            {
+                return;
+            }
+
+            if (this->forward(region_number, pattern, metadata, __coarse_offset(region_offset)))
+                this->pf_buffer.insert(region_number, pattern, __coarse_offset(region_offset), metadata);
+            return;
+        }
+        if (entry->data.offset != region_offset)
+        {
+            uint64_t region_number = hash_index(entry->key, this->filter_table.get_index_len());
+            AccumulationTable::Entry victim =
+                this->accumulation_table.insert(region_number, entry->data.pc, entry->data.offset);
+            this->accumulation_table.set_pattern(region_number, __coarse_offset(region_offset));
+            this->filter_table.erase(region_number);
+            if (victim.valid)
+            {
+                this->insert_in_opt(victim);
+            }
+        }
+    }
+
+    void eviction(uint64_t block_number)
+    {
+        if (this->debug_level >= 2)
+            cerr << "[ PMP] eviction(block_number=" << block_number << ")" << dec << endl;
+        uint64_t region_number = block_number / this->pattern_len;
+        this->filter_table.erase(region_number);
+        AccumulationTable::Entry *entry = this->accumulation_table.erase(region_number);
+        if (entry)
+        {
+            this->insert_in_opt(*entry);
+        }
+    }
+
+    template <class Cache>
+    int prefetch(Cache *cache, uint64_t block_number)
+    {
+        if (this->debug_level >= 2)
+            cerr << " PMP::prefetch(cache=" << cache->NAME << ", block_number=" << hex << block_number << ")" << dec
+                 << endl;
+        int pf_issued = this->pf_buffer.prefetch(cache, this->cpu, block_number, this->throttle.access_degree());
+        if (this->debug_level >= 2)
+            cerr << "[ PMP::prefetch] pf_issued=" << pf_issued << dec << endl;
+        return pf_issued;
+    }
+
+    template <class Cache>
+    int drain(Cache *cache)
+    {
+        return this->pf_buffer.drain(cache, this->cpu, this->throttle.drain_degree());
+    }
+
+    void broadcast_bw(uint8_t bw_level, uint32_t acc_level, uint32_t overprediction_level)
+    {
+        this->throttle.update(bw_level, acc_level, overprediction_level);
+    }
+
+    void set_debug_level(int debug_level)
+    {
+        this->filter_table.set_debug_level(debug_level);
+        this->accumulation_table.set_debug_level(debug_level);
+        this->opt.set_debug_level(debug_level);
+        this->ppt.set_debug_level(debug_level);
+        this->debug_level = debug_level;
+    }
+
+    void log()
+    {
+
+        cerr << "Filter table begin" << dec << endl;
+        cerr << this->filter_table.log();
+        cerr << "Filter table end" << endl;
+
+        cerr << "Accumulation table begin" << dec << endl;
+        cerr << this->accumulation_table.log();
+        cerr << "Accumulation table end" << endl;
+
+        cerr << "Offset pattern table begin" << dec << endl;
+        cerr << this->opt.log();
+        cerr << "Offset pattern table end" << endl;
+
+        cerr << "PC pattern table begin" << dec << endl;
+        cerr << this->ppt.log();
+        cerr << "PC pattern table end" << endl;
+
+        cerr << "Prefetch buffer begin" << dec << endl;
+        cerr << this->pf_buffer.log();
+        cerr << "Prefetch buffer end" << endl;
+
+        cerr << this->throttle.log();
+    }
+
+    /* base vote thresholds of the offset and PC tables, for design-space sweeps */
+    void set_thresholds(double l1d, double l2c, double pc_l1d, double pc_l2c)
+    {
+        this->L1D_THRESH = l1d;
+        this->L2C_THRESH = l2c;
+        this->PC_L1D_THRESH = pc_l1d;
+        this->PC_L2C_THRESH = pc_l2c;
+    }
+
+private:
+
+    /**
+     * Moves FILL_LLC blocks to the LLC buffer and FILL_L2 blocks to the L2C buffer when those
+     * levels run PMP, leaving only what L1D itself has to issue in `pattern`.
+     * @return False if nothing is left for L1D
+     */
+    bool forward(uint64_t region_number, vector<int> &pattern, const vector<uint32_t> &metadata, int trigger_offset)
+    {
+        PrefetchBuffer *l2c_buffer = pmp_l2c_buffer(this->cpu);
+        PrefetchBuffer *llc_buffer = pmp_llc_buffer(this->cpu);
+        if (!l2c_buffer && !llc_buffer)
+            return true;
+
+        vector<int> l2c_pattern(this->pattern_len, 0);
+        vector<int> llc_pattern(this->pattern_len, 0);
+        bool to_l2c = false, to_llc = false, left = false;
+        for (int i = 0; i < this->pattern_len; i += 1)
+        {
+            if (pattern[i] == FILL_LLC && llc_buffer)
+            {
+                llc_pattern[i] = pattern[i];
+                pattern[i] = 0;
+                to_llc = true;
+            }
+            else if ((pattern[i] == FILL_L2 || pattern[i] == FILL_LLC) && l2c_buffer)
+            {
+                l2c_pattern[i] = pattern[i];
+                pattern[i] = 0;
+                to_l2c = true;
+            }
+            else if (pattern[i])
+                left = true;
+        }
+
+        if (to_l2c)
+            l2c_buffer->insert(region_number, l2c_pattern, trigger_offset, metadata);
+        if (to_llc)
+            llc_buffer->insert(region_number, llc_pattern, trigger_offset, metadata);
+        return left;
+    }
+
+    /**
+     * @param metadata Set to the pf_metadata of each offset: the confidence of whichever table
+     *        voted higher for it, see PMP_META in common.h
+     */
+    vector<int> find_in_opt(uint64_t pc, uint64_t block_number, vector<uint32_t> &metadata)
+    {
+        if (this->debug_level >= 2)
+        {
+            cerr << "[ PMP] find_in_opt(pc=0x" << hex << pc << ", address=0x" << block_number << ")" << dec << endl;
+        }
+        vector<OffsetPatternTableData> matches = this->opt.find(pc, block_number);
+        vector<OffsetPatternTableData> matches_pc = this->ppt.find(pc, block_number);
+        vector<int> pattern;
+        vector<int> pattern_pc;
+        vector<int> result_pattern(this->pattern_len, 0);
+        metadata.assign(this->pattern_len, 0);
+        if (!matches.empty())
+        {
+            vector<double> conf, conf_pc;
+            pattern = this->vote(matches, false, &conf);
+            pattern_pc = this->vote(matches_pc, true, &conf_pc);
+            for (int i = 0; i < this->pattern_len; i++) {
+                bool from_ppt = !conf_pc.empty() && conf_pc[i/this->degrade_level] > conf[i];
+                double p = from_ppt ? conf_pc[i/this->degrade_level] : conf[i];
+                metadata[i] = PMP_META(min(PMP_META_CONF_MAX, int(p * PMP_META_CONF_MAX)), from_ppt);
+            }
+            if (pattern_pc.empty()) {
+                for (int i = 0; i < this->pattern_len; i++) {
+                    result_pattern[i] = pattern[i] == FILL_L1 ? FILL_L2 : pattern[i] == FILL_L2 ? FILL_LLC : 0;
+                }
+            } else {
+                for (int i = 0; i < this->pattern_len; i++) {
+                    if (pattern[i] == FILL_L1 && pattern_pc[i/this->degrade_level] == FILL_L1) {
+                        result_pattern[i] = FILL_L1;
+                    } else if (pattern[i] == FILL_L1 || pattern_pc[i/this->degrade_level] == FILL_L1 || 
+                               pattern[i] == FILL_L2 || pattern_pc[i/this->degrade_level] == FILL_L2) {
+                        result_pattern[i] = FILL_L2;
+                    }
+                }
+            }
+        } 
+
+        int offset = __coarse_offset(__fine_offset(block_number));
+        result_pattern = my_rotate(result_pattern, +offset);
+        metadata = my_rotate(metadata, +offset);
+        return result_pattern;
+    }
+
+    void insert_in_opt(const AccumulationTable::Entry &entry)
+    {
+        uint64_t region_number = hash_index(entry.key, this->accumulation_table.get_index_len());
+        uint64_t address = (region_number << OFFSET_BITS) + entry.data.offset;
+        if (this->debug_level >= 2)
+        {
+            cerr << "[ PMP] insert_in_opt(" << hex<< " address=0x" << address << ")" << dec << endl;
+        }
+        vector<bool> pattern(entry.data.pattern, entry.data.pattern + this->pattern_len);
+        if (count_bits(pattern_to_int(pattern)) != 1) {
+            this->opt.insert(address, entry.data.pc, pattern, 1);
+            this->ppt.insert(address, entry.data.pc, pattern_degrade(pattern, this->degrade_level), this->degrade_level);
+        }
+    }
+
+    /* @param confidence If given, set to the share of the voters that have each offset */
+    vector<int> vote(const vector<OffsetPatternTableData> &x, bool is_pc_opt=false, vector<double> *confidence=nullptr)
+    {
+        if (this->debug_level >= 2)
+            cerr << " PMP::vote(...)" << endl;
+        int n = x.size();
+        if (n == 0)
+        {
+            if (this->debug_level >= 2)
+                cerr << "[ PMP::vote] There are no voters." << endl;
+            return vector<int>();
+        }
+
+        if (this->debug_level >= 2)
+        {
+            cerr << "[ PMP::vote] Taking a vote among:" << endl;
+            for (int i = 0; i < n; i += 1)
+                cerr << "<" << setw(3) << i + 1 << "> " << pattern_to_string(vector<int>(x[i].pattern, x[i].pattern + (is_pc_opt ? this->pattern_len / this->degrade_level : this->pattern_len))) << endl;
+        }
+        bool pf_flag = false;
+        int pattern_len = is_pc_opt? this->pattern_len / this->degrade_level : this->pattern_len;
+        vector<int> res(pattern_len, 0);
+        if (confidence)
+            confidence->assign(pattern_len, 0);
+
+        for (int i = 0; i < pattern_len; i += 1)
+        {
+            int cnt = 0;
+            for (int j = 0; j < n; j += 1)
+            {
+                cnt += x[j].pattern[i];
+            }
+            double p = 1.0 * cnt / x[0].pattern[0];
+            if (p > 1) {
+                cout << "cnt:" << cnt << ",total:" << x[0].pattern[0] << endl;
+                assert(p <= 1);
+            }
+
+            if (x[0].pattern[0] <= START_CONF) {
+                break;
+            }
+            if (confidence)
+                (*confidence)[i] = p;
+
+            if (is_pc_opt) {
+                if (p >= this->throttle.l1d_thresh(PC_L1D_THRESH))
+                    res[i] = FILL_L1;
+                else if (p >= this->throttle.l2c_thresh(PC_L2C_THRESH))
+                    res[i] = FILL_L2;
+                else if (p >= PC_LLC_THRESH)
+                    res[i] = FILL_LLC;
+                else
+                    res[i] = 0;
+            } else {
+                if (p >= this->throttle.l1d_thresh(L1D_THRESH))
+                    res[i] = FILL_L1;
+                else if (p >= this->throttle.l2c_thresh(L2C_THRESH))
+                    res[i] = FILL_L2;
+                else if (p >= LLC_THRESH)
+                    res[i] = FILL_LLC;
+                else
+                    res[i] = 0;
+            }
+        }
+        if (this->debug_level >= 2)
+        {
+            cerr << "<res> " << pattern_to_string(res) << endl;
+        }
+        
+        return res;
+    }
+
+    /* vote thresholds, see set_thresholds() */
+    double L1D_THRESH = 0.50;
+    double L2C_THRESH = 0.150;
+    double LLC_THRESH = 1; /* off */
+
+    double PC_L1D_THRESH = 0.50;
+    double PC_L2C_THRESH = 0.150;
+    double PC_LLC_THRESH = 1; /* off */
+
+    /*======================*/
+
+    int pattern_len;
+    int degrade_level;
+    FilterTable filter_table;
+    AccumulationTable accumulation_table;
+    OffsetPatternTable opt;
+    PCPatternTable ppt;
+    PrefetchBuffer pf_buffer;
+    PrefetchThrottle throttle;
+    int debug_level = 0;
+    int cpu;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef REGION_STATS_H
+#define REGION_STATS_H
+
+/*
+ * Region-footprint analytics for PMP design (-region_stats).
+ *
+ * Follows the L1D access stream the prefetcher sees, in a full simulation or a
+ * -replay_l1d run, and cuts it into region generations the way PMP does: a
+ * generation of a 4 KB region (IN_REGION_BITS) starts at the first demand load
+ * to it, the trigger, and ends when one of its blocks leaves L1D. The
+ * footprint of a generation is a 64-bit bitmap anchored at the trigger
+ * offset, so long traces cost a few words per live region and per distinct
+ * footprint.
+ *
+ * At the end it reports popcount and lifetime distributions and, for every
+ * OffsetPatternTable key (trigger offset) and PCPatternTable key (hashed
+ * trigger PC, footprint degraded by PATTERN_DEGRADE_LEVEL), how many distinct
+ * footprints the key merges, the jaccard_similarity of each footprint to the
+ * previous one under the same key, and to the key's majority pattern. The
+ * last one is the best a merged entry can do for the footprints it stands for.
+ */
+
+#include <unordered_map>
+#include <vector>
+#include "champsim.h"
+
+class RegionAnalyzer
+{
+  public:
+    RegionAnalyzer(uint32_t cpu);
+
+    void access(uint64_t addr, uint64_t ip, uint8_t type);
+    void eviction(uint64_t evicted_addr);
+    // end every live generation and print the report
+    void print();
+    // start a new measurement, live generations are kept
+    void reset_stats();
+
+  private:
+    class Generation
+    {
+      public:
+        uint64_t footprint = 0, pc = 0, start_cycle = 0, accesses = 0;
+        uint32_t trigger = 0;
+    };
+
+    // footprints merged under one pattern-table key
+    class KeyStats
+    {
+      public:
+        unordered_map<uint64_t, uint64_t> footprints; // anchored footprint -> generations
+        uint64_t generations = 0, popcount = 0, last = 0;
+        double consecutive_similarity = 0;
+    };
+
+    void end(const Generation &generation);
+    static void add(KeyStats &stats, uint64_t footprint, uint32_t len);
+    void print_keys(const string &table, const vector<KeyStats> &keys, uint32_t len);
+
+    uint32_t cpu;
+    unordered_map<uint64_t, Generation> live;
+    vector<KeyStats> opt_keys, ppt_keys;
+    vector<uint64_t> popcount_hist, lifetime_hist;
+    uint64_t generations = 0, single_block = 0, accesses = 0;
+};
+
+// per-core analyzers; null when -region_stats is off
+extern RegionAnalyzer *region_analyzer[NUM_CPUS];
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef REPL_SHADOW_H
+#define REPL_SHADOW_H
+
+/*
+ * Shadow evaluation of LLC replacement policies (-llc_shadow).
+ *
+ * The policy the binary was built with drives the LLC. Every policy named in
+ * -llc_shadow lru,srrip,... gets its own tag array for a sample of the LLC
+ * sets (-llc_shadow_sets, 64 by default) and sees the requests entering the
+ * LLC in those sets, the same stream -mrc_llc profiles: new RQ, WQ and PQ
+ * entries, plus warm_access during functional fast-forward. A shadow lookup
+ * hits or misses and fills at once, through the policy's own find_victim and
+ * update_replacement_state, so one simulation estimates the miss rate of
+ * every policy on the same access stream. Counts are cleared at the end of
+ * the warmup, the shadow tags are kept. Under -sample, as for -mrc_llc, only
+ * the measured windows are counted.
+ *
+ * The shadow policies are full-size Replacement::Policy instances that only
+ * ever see the sampled sets; the ones that learn from leader or sampler sets
+ * pick those among the sampled sets (see replacement.h), so DRRIP needs at
+ * least 4 * NUM_CPUS sampled sets.
+ *
+ * The estimates leave out what a different policy would change elsewhere: the
+ * timing, the requests merged in the MSHRs and the writebacks and prefetches
+ * that follow from the LLC contents. Naming the policy the binary was built
+ * with calibrates them against the real LLC, printed next to them.
+ */
+
+#include <vector>
+#include "memory_class.h"
+#include "replacement.h"
+
+class ReplacementShadow
+{
+  public:
+    ReplacementShadow(const vector<string> &names, uint32_t sets, uint32_t ways, uint32_t sampled_sets);
+
+    // one request for a block in LLC set `set`, any request type
+    void access(uint32_t set, const PACKET &packet);
+    // start a new measurement, the shadow tags and policies are kept warm
+    void reset_stats();
+    // miss rates per policy, next to those of the real LLC
+    void print(uint64_t instructions, const uint64_t actual_access[NUM_TYPES], const uint64_t actual_miss[NUM_TYPES]);
+
+    // cleared outside the measured windows of -sample, accesses then only warm the shadow tags
+    bool counting = true;
+
+  private:
+    class Shadow
+    {
+      public:
+        string name;
+        Replacement::Policy *policy;
+        vector<BLOCK> blocks; // ways blocks per sampled set
+        uint64_t access[NUM_TYPES] = {}, miss[NUM_TYPES] = {}, bypass = 0;
+    };
+
+    uint32_t sets, ways;
+    vector<uint32_t> sampled;
+    vector<int32_t> slot; // the index of each LLC set in sampled, -1 if it is not sampled
+    vector<Shadow> shadows;
+};
+
+#endif
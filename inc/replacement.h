@@ -0,0 +1,75 @@
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+
+/*
+ * LLC replacement policies as classes.
+ *
+ * Every replacement/<name>.llc_repl is a thin adapter from the CACHE::llc_*
+ * hooks to one Replacement::Policy, and the policies themselves are always
+ * compiled in (replacement/base_replacement.cc, replacement/dancrc2.cc), so one
+ * binary can hold several instances of any of them: the one that drives the
+ * LLC, and the shadow copies of -llc_shadow (see repl_shadow.h).
+ *
+ * A shadow copy is given the sets it will see. A policy that learns from
+ * leader or sampler sets picks them among those, since sets it never sees
+ * could not train it; the policy that drives the cache gets an empty list and
+ * picks them among all the sets, as the .llc_repl files always did.
+ */
+
+#include <map>
+#include <set>
+#include <vector>
+#include "block.h"
+
+namespace Replacement
+{
+class Policy
+{
+  public:
+    Policy(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets);
+    virtual ~Policy() {}
+
+    // the CACHE::llc_find_victim hook, @return a way, or `ways` to bypass
+    virtual uint32_t find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip,
+                                 uint64_t full_addr, uint32_t type) = 0;
+    // the CACHE::llc_update_replacement_state hook, called on every hit and fill
+    virtual void update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip,
+                                          uint64_t victim_addr, uint32_t type, uint8_t hit) = 0;
+    virtual void final_stats() {}
+
+  protected:
+    // rand() for the policy driving the cache, a private generator for a shadow copy so it does not change the simulation
+    int random();
+
+    uint32_t sets, ways;
+    vector<uint32_t> sampled_sets;
+    bool shadow;
+
+  private:
+    uint64_t random_state = 0x9e3779b97f4a7c15ULL;
+};
+
+typedef Policy *(*PolicyFactory)(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets);
+
+// every policy linked in, by the name of its replacement/<name>.llc_repl
+map<string, PolicyFactory> &policies();
+
+// the policies whose find_victim may bypass, which only the LLC supports
+set<string> &bypassing_policies();
+
+struct PolicyRegistration
+{
+    PolicyRegistration(const string &name, PolicyFactory factory, bool bypasses = false)
+    {
+        policies()[name] = factory;
+        if (bypasses)
+            bypassing_policies().insert(name);
+    }
+};
+
+// @return NULL if there is no such policy
+Policy *make_policy(const string &name, uint32_t sets, uint32_t ways,
+                    const vector<uint32_t> &sampled_sets = vector<uint32_t>());
+} // namespace Replacement
+
+#endif
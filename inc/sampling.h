@@ -0,0 +1,101 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+/*
+ * SMARTS-style sampled simulation.
+ *
+ * After the normal warmup, every -sample_period instructions of the region of
+ * interest are split into a functional fast-forward (caches, TLBs, branch
+ * predictor and prefetchers stay warm through warm_instruction), a short
+ * detailed warmup of -sample_warmup instructions that refills the pipeline and
+ * queues, and a measured window of -sample_window instructions. CPI, branch
+ * MPKI and LLC MPKI are averaged over the windows with a 95% confidence
+ * interval. Sampling stops once the CPI interval is within -sample_error of the
+ * mean (and at least -sample_min windows were taken), or at the end of the
+ * region of interest.
+ *
+ * The ROI cache and prefetch statistics are the sums of what changed inside the
+ * measured windows, so they share the instruction count of the windows. Before
+ * a fast-forward the cores stop reading the trace until their pipelines and
+ * the cache queues and MSHRs are empty, so no fill lands on a line the
+ * functional warming has installed meanwhile.
+ */
+
+#include <cmath>
+#include "champsim.h"
+#include "cache.h"
+
+#define SAMPLED_CACHES 4 // L1D, L1I, L2C and the LLC
+
+// running mean and 95% confidence interval of a per-window metric
+class SampleStat
+{
+  public:
+    void add(double x)
+    {
+        n++;
+        sum += x;
+        sum_sq += x * x;
+    }
+
+    double mean() const { return n ? sum / n : 0; }
+
+    double half_width() const
+    {
+        if (n < 2)
+            return 0;
+        double var = (sum_sq - sum * sum / n) / (n - 1);
+        return 1.96 * sqrt(var > 0 ? var : 0) / sqrt(n);
+    }
+
+    uint64_t n = 0;
+
+  private:
+    double sum = 0, sum_sq = 0;
+};
+
+class SMARTSSampler
+{
+  public:
+    SMARTSSampler(uint64_t period, uint64_t warmup, uint64_t window, double error, uint64_t min_samples);
+
+    // schedule the next windows, called once warmup or a fast-forward is finished
+    void start();
+    // per-core window bookkeeping, called every cycle
+    void operate(uint32_t cpu);
+    // true once every core has finished its window of this round
+    bool round_done() const;
+    // true when the CPI of every core is within the error target
+    bool converged() const;
+    // true when a core has covered its region of interest
+    bool roi_done() const;
+    // true once nothing is in flight in any core or cache, so the next round may fast-forward
+    bool drained() const;
+    // instructions to fast-forward before the next round
+    uint64_t skip() const { return period - warmup - window; }
+
+    void print_stats(uint32_t cpu);
+
+    // the ROI statistics become those of the measured windows
+    void record_roi_stats(uint32_t cpu);
+
+    uint64_t detail_instr[NUM_CPUS] = {}, detail_cycle[NUM_CPUS] = {}, detail_mispredictions[NUM_CPUS] = {};
+
+  private:
+    uint64_t period, warmup, window, min_samples;
+    double error;
+
+    uint64_t window_start[NUM_CPUS], window_end[NUM_CPUS];
+    bool measuring[NUM_CPUS] = {}, measured[NUM_CPUS] = {};
+    uint64_t begin_instr[NUM_CPUS], begin_cycle[NUM_CPUS], begin_mispredictions[NUM_CPUS], begin_llc_miss[NUM_CPUS];
+
+    SampleStat cpi[NUM_CPUS], branch_mpki[NUM_CPUS], llc_mpki[NUM_CPUS];
+
+    // the miss-ratio curves and the LLC shadows count the measured windows only
+    void update_profile_counting(uint32_t cpu);
+
+    // summed into CACHE::roi_delta at the end of each window
+    CACHE_ROI_STATS window_begin[NUM_CPUS][SAMPLED_CACHES];
+};
+
+#endif
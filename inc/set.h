@@ -46,7 +46,7 @@ class fastset {
 
 	// get one of the bits
 
-	bool getbit (TYPE x) {
+	bool getbit (TYPE x) const {
 		int word = x >> 6;
 		int bit = x & 63;
 		return (data.bits[word] >> bit) & 1;
@@ -186,7 +186,7 @@ public:
 	// this set becomes the union of itself and the other set
 	// (call it "join" because "union" is a C++ keyword)
 
-	void join (fastset & other, int n) {
+	void join (const fastset & other, int n) {
 
 		// special rules for special sets
 
@@ -217,7 +217,7 @@ public:
 
 	// expand the entire set into the array v, returning the cardinality
 
-	int expand (TYPE v[], int n) {
+	int expand (TYPE v[], int n) const {
 		if (!card) return 0;
 
 		// a small set can just be copied
@@ -0,0 +1,31 @@
+#ifndef SIMPOINT_H
+#define SIMPOINT_H
+
+/*
+ * SimPoint-weighted multi-region runs.
+ *
+ * -regions <file> lists the SimPoint slices of one benchmark, one
+ * "<trace> <weight>" per line ('#' starts a comment). Every region is
+ * simulated by a child ChampSim with the same knobs, -region_jobs at a time
+ * (default: one per online CPU), writing its full output to
+ * <file>.<index>.out and its -summary to <file>.<index>.sum; the files of
+ * -capture_l1d and -latency_trace get the region index appended, so children
+ * running at the same time do not share them. The parent then
+ * prints the per-region results and their weighted combination: CPI and MPKI
+ * are weighted arithmetic means (IPC is the reciprocal of the weighted CPI),
+ * and the prefetch accuracy weights the useful and filled prefetches per
+ * kilo-instruction of each region.
+ *
+ * The simulator keeps its state in globals, so regions run as separate
+ * processes rather than threads.
+ */
+
+#include "champsim.h"
+
+// write the ROI counters of CPU 0 as "<key> <value>" lines for -regions
+void write_summary(const string &path);
+
+// run every region of `list` and report the weighted results; returns the exit status
+int run_regions(const string &list, uint32_t jobs, int argc, char **argv);
+
+#endif
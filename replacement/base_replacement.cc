@@ -1,33 +1,558 @@
 #include "cache.h"
+#include "common.h"
+#include "replacement.h"
 
 #define maxRRPV 3
 
 namespace Replacement
 {
+    Policy::Policy(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets)
+        : sets(sets), ways(ways), sampled_sets(sampled_sets), shadow(!sampled_sets.empty())
+    {
+    }
+
+    int Policy::random()
+    {
+        if (!shadow)
+            return rand();
+
+        // xorshift64*, folded to the range of rand()
+        random_state ^= random_state >> 12;
+        random_state ^= random_state << 25;
+        random_state ^= random_state >> 27;
+        return (int)((random_state * 0x2545f4914f6cdd1dULL) >> 33);
+    }
+
+    map<string, PolicyFactory> &policies()
+    {
+        static map<string, PolicyFactory> factories;
+        return factories;
+    }
+
+    set<string> &bypassing_policies()
+    {
+        static set<string> names;
+        return names;
+    }
+
+    Policy *make_policy(const string &name, uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets)
+    {
+        map<string, PolicyFactory>::iterator it = policies().find(name);
+        if (it == policies().end())
+            return NULL;
+        return it->second(sets, ways, sampled_sets);
+    }
+
+    template <class T>
+    Policy *make(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets)
+    {
+        return new T(sets, ways, sampled_sets);
+    }
+
+    // the placement of a block is ways - 1 - its recency, the block at ways - 1 is the victim
+    class Lru : public Policy
+    {
+    public:
+        Lru(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets)
+            : Policy(sets, ways, sampled_sets), lru(sets, vector<uint32_t>(ways))
+        {
+            for (uint32_t i = 0; i < sets; i++)
+                for (uint32_t j = 0; j < ways; j++)
+                    lru[i][j] = j;
+        }
+
+        uint32_t find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+        {
+            // fill invalid line first
+            for (uint32_t way = 0; way < ways; way++)
+                if (!current_set[way].valid)
+                    return way;
+
+            for (uint32_t way = 0; way < ways; way++)
+                if (lru[set][way] == ways - 1)
+                    return way;
+
+            cerr << "[LRU] " << __func__ << " no victim! set: " << set << endl;
+            assert(0);
+            return 0;
+        }
+
+        void update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)
+        {
+            if ((type == WRITEBACK) && ip)
+                assert(0);
+
+            // writeback hit does not update LRU state
+            if (hit && (type == WRITEBACK))
+                return;
+
+            for (uint32_t i = 0; i < ways; i++)
+                if (lru[set][i] < lru[set][way])
+                    lru[set][i]++;
+            lru[set][way] = 0; // promote to the MRU position
+        }
+
+    private:
+        vector<vector<uint32_t>> lru;
+    };
+
+    // SRRIP [Jaleel et al. ISCA' 10]: hits go to RRPV 0, fills to maxRRPV-1
+    class Srrip : public Policy
+    {
+    public:
+        Srrip(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets)
+            : Policy(sets, ways, sampled_sets), rrpv(sets, vector<uint32_t>(ways, maxRRPV))
+        {
+        }
+
+        uint32_t find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+        {
+            return rrpv_victim(rrpv[set]);
+        }
+
+        void update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)
+        {
+            if ((type == WRITEBACK) && ip)
+                assert(0);
+
+            if (hit)
+                rrpv[set][way] = 0;
+            else
+                rrpv[set][way] = maxRRPV - 1;
+        }
+
+        // look for a maxRRPV line, ageing the whole set until there is one
+        static uint32_t rrpv_victim(vector<uint32_t> &set_rrpv)
+        {
+            while (1)
+            {
+                for (uint32_t i = 0; i < set_rrpv.size(); i++)
+                    if (set_rrpv[i] == maxRRPV)
+                        return i;
+
+                for (uint32_t i = 0; i < set_rrpv.size(); i++)
+                    set_rrpv[i]++;
+            }
+        }
+
+    private:
+        vector<vector<uint32_t>> rrpv;
+    };
+
+// PMP votes below 7/15 (under L1D_THRESH) are inserted at distant RRPV
+#define PMP_SRRIP_LOW_CONF 7
+
+    // SRRIP with PMP's vote confidence (pf_metadata, see common.h): a prefetch PMP was unsure of is
+    // held at maxRRPV until its first demand hit, which promotes it like any hit. Prefetch and
+    // writeback hits leave it there, so the PQ re-requesting the block cannot keep it alive.
+    class PmpSrrip : public Policy
+    {
+    public:
+        PmpSrrip(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets)
+            : Policy(sets, ways, sampled_sets), rrpv(sets, vector<uint32_t>(ways, maxRRPV)),
+              distant(sets, vector<uint8_t>(ways, 0))
+        {
+        }
+
+        uint32_t find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+        {
+            // fill invalid line first, a demoted prefetch must not go before them
+            for (uint32_t way = 0; way < ways; way++)
+                if (!current_set[way].valid)
+                    return way;
+
+            // a fill is reported before fill_cache sets the prefetch bit and pf_metadata of the
+            // block, so the distant insertion is applied here, the first time the RRPV matters
+            for (uint32_t way = 0; way < ways; way++)
+                if (low_confidence(current_set[way]) && !distant[set][way])
+                {
+                    rrpv[set][way] = maxRRPV;
+                    distant[set][way] = 1;
+                    demoted++;
+                }
+            return Srrip::rrpv_victim(rrpv[set]);
+        }
+
+        void update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)
+        {
+            if ((type == WRITEBACK) && ip)
+                assert(0);
+
+            if (!hit)
+            {
+                rrpv[set][way] = maxRRPV - 1;
+                distant[set][way] = 0;
+                return;
+            }
+            if (distant[set][way] && type != LOAD && type != RFO)
+                return;
+
+            if (distant[set][way])
+                promoted++;
+            rrpv[set][way] = 0;
+            distant[set][way] = 0;
+        }
+
+        void final_stats()
+        {
+            cout << "PMP_SRRIP low-confidence prefetches demoted: " << demoted << " promoted by a demand hit: " << promoted
+                 << endl;
+        }
+
+    private:
+        static bool low_confidence(const BLOCK &block)
+        {
+            return block.prefetch && IS_PMP_META(block.pf_metadata) && PMP_META_CONF(block.pf_metadata) < PMP_SRRIP_LOW_CONF;
+        }
+
+        vector<vector<uint32_t>> rrpv;
+        // held at maxRRPV as a low-confidence prefetch, until the next demand hit or fill
+        vector<vector<uint8_t>> distant;
+        uint64_t demoted = 0, promoted = 0;
+    };
+
+#define DRRIP_NUM_POLICY 2
+#define DRRIP_SDM_SIZE 32
+#define DRRIP_BIP_MAX 32
+#define DRRIP_PSEL_WIDTH 10
+#define DRRIP_PSEL_MAX ((1 << DRRIP_PSEL_WIDTH) - 1)
+#define DRRIP_PSEL_THRS DRRIP_PSEL_MAX / 2
+
+    // DRRIP: per-core set dueling between BIP (leader 0) and SRRIP (leader 1) insertion
+    class Drrip : public Policy
+    {
+    public:
+        Drrip(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets)
+            : Policy(sets, ways, sampled_sets), rrpv(sets, vector<uint32_t>(ways, maxRRPV)), leader_cpu(sets, -1),
+              leader(sets, -1), PSEL(NUM_CPUS, 0)
+        {
+            uint32_t sdm_size = DRRIP_SDM_SIZE;
+            vector<uint32_t> rand_sets;
+            if (shadow)
+            {
+                // a quarter of the sampled sets lead, the rest follow
+                sdm_size = min((uint32_t)DRRIP_SDM_SIZE, (uint32_t)(sampled_sets.size() / (2 * DRRIP_NUM_POLICY * NUM_CPUS)));
+                assert(sdm_size > 0);
+                rand_sets.assign(sampled_sets.begin(), sampled_sets.begin() + NUM_CPUS * DRRIP_NUM_POLICY * sdm_size);
+            }
+            else
+            {
+                // randomly selected sampler sets
+                unsigned long rand_seed = 1;
+                unsigned long max_rand = 1048576;
+                uint32_t my_set = sets;
+                int do_again = 0;
+                rand_sets.resize(NUM_CPUS * DRRIP_NUM_POLICY * sdm_size);
+                for (uint32_t i = 0; i < rand_sets.size(); i++)
+                {
+                    do
+                    {
+                        do_again = 0;
+                        rand_seed = rand_seed * 1103515245 + 12345;
+                        rand_sets[i] = ((unsigned)((rand_seed / 65536) % max_rand)) % my_set;
+                        printf("Assign rand_sets[%d]: %u  LLC: %u\n", i, rand_sets[i], my_set);
+                        for (uint32_t j = 0; j < i; j++)
+                        {
+                            if (rand_sets[i] == rand_sets[j])
+                            {
+                                do_again = 1;
+                                break;
+                            }
+                        }
+                    } while (do_again);
+                    printf("rand_sets[%d]: %d\n", i, rand_sets[i]);
+                }
+            }
+
+            // each core has sdm_size leader sets per policy
+            for (uint32_t i = 0; i < rand_sets.size(); i++)
+            {
+                leader_cpu[rand_sets[i]] = i / (DRRIP_NUM_POLICY * sdm_size);
+                leader[rand_sets[i]] = (i % (DRRIP_NUM_POLICY * sdm_size)) / sdm_size;
+            }
+        }
+
+        uint32_t find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+        {
+            return Srrip::rrpv_victim(rrpv[set]);
+        }
+
+        void update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)
+        {
+            // do not update replacement state for writebacks
+            if (type == WRITEBACK)
+            {
+                rrpv[set][way] = maxRRPV - 1;
+                return;
+            }
+
+            // cache hit
+            if (hit)
+            {
+                rrpv[set][way] = 0; // for cache hit, DRRIP always promotes a cache line to the MRU position
+                return;
+            }
+
+            // cache miss
+            int leader_policy = leader_cpu[set] == (int)cpu ? leader[set] : -1;
+
+            if (leader_policy == -1)
+            { // follower sets
+                if (PSEL[cpu] > DRRIP_PSEL_THRS)
+                    bip_insert(set, way); // follow BIP
+                else                      // follow SRRIP
+                    rrpv[set][way] = maxRRPV - 1;
+            }
+            else if (leader_policy == 0)
+            { // leader 0: BIP
+                // decrease score if more miss happens in BIP sets
+                // followers will choose SRRIP if the score is too low
+                if (PSEL[cpu] > 0)
+                    PSEL[cpu]--;
+                bip_insert(set, way);
+            }
+            else if (leader_policy == 1)
+            { // leader 1: SRRIP
+                if (PSEL[cpu] < DRRIP_PSEL_MAX)
+                    PSEL[cpu]++;
+                rrpv[set][way] = maxRRPV - 1;
+            }
+            else // WE SHOULD NOT REACH HERE
+                assert(0);
+        }
+
+    private:
+        // distant insertion, with a long one once every BIP_MAX misses
+        void bip_insert(uint32_t set, uint32_t way)
+        {
+            rrpv[set][way] = maxRRPV;
+
+            bip_counter++;
+            if (bip_counter == DRRIP_BIP_MAX)
+                bip_counter = 0;
+            if (bip_counter == 0)
+                rrpv[set][way] = maxRRPV - 1;
+        }
+
+        vector<vector<uint32_t>> rrpv;
+        // the core a leader set belongs to and the policy it plays, -1 for followers
+        vector<int> leader_cpu, leader;
+        uint32_t bip_counter = 0;
+        vector<uint32_t> PSEL;
+    };
+
+#define SHIP_SHCT_SIZE 16384
+#define SHIP_SHCT_PRIME 16381
+#define SHIP_SAMPLER_SET (256 * NUM_CPUS)
+#define SHIP_SHCT_MAX 7
+
+    // SHiP: a per-core signature (PC) history counter table, trained by LRU sampler sets, predicts distant fills
+    class Ship : public Policy
+    {
+    public:
+        Ship(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets)
+            : Policy(sets, ways, sampled_sets), rrpv(sets, vector<uint32_t>(ways, maxRRPV)), sampler_index(sets, -1),
+              SHCT(NUM_CPUS, vector<uint32_t>(SHIP_SHCT_SIZE, 0))
+        {
+            vector<uint32_t> rand_sets;
+            if (shadow)
+                rand_sets.assign(sampled_sets.begin(), sampled_sets.begin() + min((size_t)SHIP_SAMPLER_SET, sampled_sets.size()));
+            else
+            {
+                // randomly selected sampler sets
+                unsigned long rand_seed = 1;
+                unsigned long max_rand = 1048576;
+                uint32_t my_set = sets;
+                int do_again = 0;
+                rand_sets.resize(SHIP_SAMPLER_SET);
+                for (uint32_t i = 0; i < rand_sets.size(); i++)
+                {
+                    do
+                    {
+                        do_again = 0;
+                        rand_seed = rand_seed * 1103515245 + 12345;
+                        rand_sets[i] = ((unsigned)((rand_seed / 65536) % max_rand)) % my_set;
+                        printf("Assign rand_sets[%d]: %u  LLC: %u\n", i, rand_sets[i], my_set);
+                        for (uint32_t j = 0; j < i; j++)
+                        {
+                            if (rand_sets[i] == rand_sets[j])
+                            {
+                                do_again = 1;
+                                break;
+                            }
+                        }
+                    } while (do_again);
+                    printf("rand_sets[%d]: %d\n", i, rand_sets[i]);
+                }
+            }
+
+            sampler.assign(rand_sets.size(), vector<SamplerEntry>(ways));
+            for (uint32_t i = 0; i < rand_sets.size(); i++)
+            {
+                sampler_index[rand_sets[i]] = i;
+                for (uint32_t j = 0; j < ways; j++)
+                    sampler[i][j].lru = j;
+            }
+        }
+
+        uint32_t find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
+        {
+            return Srrip::rrpv_victim(rrpv[set]);
+        }
+
+        void update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)
+        {
+            if ((type == WRITEBACK) && ip)
+                assert(0);
+
+            // handle writeback access
+            if (type == WRITEBACK)
+            {
+                if (!hit)
+                    rrpv[set][way] = maxRRPV - 1;
+                return;
+            }
+
+            // update sampler
+            if (sampler_index[set] >= 0)
+                update_sampler(cpu, sampler_index[set], full_addr, ip, type);
+
+            if (hit)
+                rrpv[set][way] = 0;
+            else
+            {
+                // SHIP prediction
+                uint32_t SHCT_idx = ip % SHIP_SHCT_PRIME;
+
+                rrpv[set][way] = maxRRPV - 1;
+                // zeal4u: which is opposite to what the paper describes.
+                if (SHCT[cpu][SHCT_idx] == SHIP_SHCT_MAX)
+                    rrpv[set][way] = maxRRPV;
+            }
+        }
+
+    private:
+        class SamplerEntry
+        {
+        public:
+            uint8_t valid = 0, type = 0, used = 0;
+            uint64_t tag = 0, ip = 0;
+            uint32_t lru = 0;
+        };
+
+        void update_sampler(uint32_t cpu, uint32_t s_idx, uint64_t address, uint64_t ip, uint8_t type)
+        {
+            vector<SamplerEntry> &s_set = sampler[s_idx];
+            uint64_t tag = address / (64 * sets);
+            uint32_t match;
+
+            // check hit
+            for (match = 0; match < ways; match++)
+            {
+                if (s_set[match].valid && (s_set[match].tag == tag))
+                {
+                    uint32_t SHCT_idx = s_set[match].ip % SHIP_SHCT_PRIME;
+                    if (SHCT[cpu][SHCT_idx] > 0)
+                        SHCT[cpu][SHCT_idx]--;
+
+                    // SHIP does not update ip on sampler hit
+                    s_set[match].type = type;
+                    s_set[match].used = 1;
+                    break;
+                }
+            }
+
+            // check invalid
+            if (match == ways)
+            {
+                for (match = 0; match < ways; match++)
+                {
+                    if (s_set[match].valid == 0)
+                    {
+                        s_set[match].valid = 1;
+                        s_set[match].tag = tag;
+                        s_set[match].ip = ip;
+                        s_set[match].type = type;
+                        s_set[match].used = 0;
+                        break;
+                    }
+                }
+            }
+
+            // miss
+            if (match == ways)
+            {
+                for (match = 0; match < ways; match++)
+                {
+                    if (s_set[match].lru == (ways - 1)) // Sampler uses LRU replacement
+                    {
+                        if (s_set[match].used == 0)
+                        {
+                            uint32_t SHCT_idx = s_set[match].ip % SHIP_SHCT_PRIME;
+                            if (SHCT[cpu][SHCT_idx] < SHIP_SHCT_MAX)
+                                SHCT[cpu][SHCT_idx]++;
+                        }
+
+                        s_set[match].tag = tag;
+                        s_set[match].ip = ip;
+                        s_set[match].type = type;
+                        s_set[match].used = 0;
+                        break;
+                    }
+                }
+            }
+
+            // update LRU state
+            uint32_t curr_position = s_set[match].lru;
+            for (uint32_t i = 0; i < ways; i++)
+            {
+                if (s_set[i].lru < curr_position)
+                    s_set[i].lru++;
+            }
+            s_set[match].lru = 0;
+        }
+
+        vector<vector<uint32_t>> rrpv;
+        vector<vector<SamplerEntry>> sampler;
+        // the sampler set of each LLC set, -1 if it is not sampled
+        vector<int> sampler_index;
+        vector<vector<uint32_t>> SHCT;
+    };
+
 // These two are only for sampled sets (we use 64 sets)
 #define NUM_LEADER_SETS 64
 #define maxSHCTR 7
-// #define SHCT_SIZE (1<<14)
-#define SAT_INC(x, max) (x < max) ? x + 1 : x
-#define SAT_DEC(x) (x > 0) ? x - 1 : x
-    class ShipPP
+#define SHIPPP_SHCT_SIZE (1 << 14)
+#define RRIP_OVERRIDE_PERC 0
+#define SAT_INC(x, max) ((x < max) ? x + 1 : x)
+#define SAT_DEC(x) ((x > 0) ? x - 1 : x)
+
+    // SHiP++ [Young et al. CRC2 '17], over SRRIP
+    class ShipPP : public Policy
     {
     public:
-        ShipPP(int sets, int ways, int NUM_CORE, int SHCT_SIZE, int maxrrpv, int maxshctr)
-            : sets(sets), ways(ways), shct_size(SHCT_SIZE), maxrrpv(maxrrpv), maxshctr(maxshctr),
-              line_rrpv(sets, vector<uint32_t>(ways, maxrrpv)),
+        ShipPP(uint32_t sets, uint32_t ways, const vector<uint32_t> &sampled_sets)
+            : Policy(sets, ways, sampled_sets),
+              line_rrpv(sets, vector<uint32_t>(ways, maxRRPV)),
               is_prefetch(sets, vector<uint32_t>(ways, false)),
-              fill_core(sets, vector<uint32_t>(ways)),
+              fill_core(sets, vector<uint32_t>(ways, 0)),
+              ship_sample(sets, 0),
               line_reuse(sets, vector<uint32_t>(ways, false)),
               line_sig(sets, vector<uint64_t>(ways, 0)),
-              ship_sample(sets),
-              SHCT(NUM_CORE, vector<uint32_t>(SHCT_SIZE, 1))
+              SHCT(NUM_CPUS, vector<uint32_t>(SHIPPP_SHCT_SIZE, 1)) // Assume weakly re-use start
         {
+            if (shadow)
+            {
+                for (uint32_t i = 0; i < NUM_LEADER_SETS && i < sampled_sets.size(); i++)
+                    ship_sample[sampled_sets[i]] = 1;
+                return;
+            }
+
             int leaders = 0;
 
             while (leaders < NUM_LEADER_SETS)
             {
-                int randval = rand() % sets;
+                int randval = random() % sets;
 
                 if (ship_sample[randval] == 0)
                 {
@@ -37,6 +562,11 @@ namespace Replacement
             }
         }
 
+        uint32_t find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t PC, uint64_t paddr, uint32_t type)
+        {
+            return Srrip::rrpv_victim(line_rrpv[set]);
+        }
+
         void update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t paddr,
                                       uint64_t PC, uint64_t victim_addr, uint32_t type, uint8_t hit)
         {
@@ -49,9 +579,7 @@ namespace Replacement
 
                     if ((type == PREFETCH) && is_prefetch[set][way])
                     {
-                        //                line_rrpv[set][way] = 0;
-
-                        if ((ship_sample[set] == 1) && ((rand() % 100 < 5) || (NUM_CPUS == 4)))
+                        if ((ship_sample[set] == 1) && ((random() % 100 < 5) || (NUM_CPUS == 4)))
                         {
                             uint32_t fill_cpu = fill_core[set][way];
 
@@ -65,16 +593,17 @@ namespace Replacement
 
                         if (is_prefetch[set][way])
                         {
-                            line_rrpv[set][way] = maxrrpv;
+                            line_rrpv[set][way] = maxRRPV;
                             is_prefetch[set][way] = false;
+                            total_prefetch_downgrades++;
                         }
 
-                        if ((ship_sample[set] == 1) && (line_reuse[set][way] == 0))
+                        if ((ship_sample[set] == 1) && (line_reuse[set][way] == 0)) // first re-reference
                         {
                             uint32_t fill_cpu = fill_core[set][way];
 
                             SHCT[fill_cpu][sig] = SAT_INC(SHCT[fill_cpu][sig], maxSHCTR);
-                            line_reuse[set][way] = false;
+                            line_reuse[set][way] = true;
                         }
                     }
                 }
@@ -85,7 +614,7 @@ namespace Replacement
             //--- All of the below is done only on misses -------
             // remember signature of what is being inserted
             uint64_t use_PC = (type == PREFETCH) ? ((PC << 1) + 1) : (PC << 1);
-            uint32_t new_sig = use_PC % shct_size;
+            uint32_t new_sig = use_PC % SHIPPP_SHCT_SIZE;
 
             if (ship_sample[set] == 1)
             {
@@ -110,17 +639,17 @@ namespace Replacement
 
             // Now determine the insertion prediciton
 
-            uint32_t priority_rrpv = maxrrpv - 1; // default SHIP
+            uint32_t priority_rrpv = maxRRPV - 1; // default SHIP
 
             if (type == WRITEBACK)
             {
-                line_rrpv[set][way] = maxrrpv;
+                line_rrpv[set][way] = maxRRPV;
             }
             else if (SHCT[cpu][new_sig] == 0)
             {
-                line_rrpv[set][way] = (rand() % 100 >= 0) ? maxrrpv : priority_rrpv; // LowPriorityInstallMostly
+                line_rrpv[set][way] = (random() % 100 >= RRIP_OVERRIDE_PERC) ? maxRRPV : priority_rrpv; // LowPriorityInstallMostly
             }
-            else if (SHCT[cpu][new_sig] == 7)
+            else if (SHCT[cpu][new_sig] == maxSHCTR)
             {
                 line_rrpv[set][way] = (type == PREFETCH) ? 1 : 0; // HighPriority Install
             }
@@ -128,26 +657,27 @@ namespace Replacement
             {
                 line_rrpv[set][way] = priority_rrpv; // HighPriority Install
             }
+
+            // Stat tracking for what insertion it was at
+            insertion_distrib[type][line_rrpv[set][way]]++;
         }
 
-        uint32_t find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t PC, uint64_t paddr, uint32_t type)
+        void final_stats()
         {
-            // look for the maxRRPV line
-            while (1)
-            {
-                for (int i = 0; i < ways; i++)
-                    if (line_rrpv[set][i] == maxRRPV)
-                    { // found victim
-                        return i;
-                    }
+            const char *names[] = {"LOAD", "RFO", "PREF", "WRITEBACK"};
 
-                for (int i = 0; i < ways; i++)
-                    line_rrpv[set][i]++;
+            cout << "Insertion Distribution: " << endl;
+            for (uint32_t i = 0; i < NUM_TYPES; i++)
+            {
+                cout << "\t" << names[i] << " ";
+                for (uint32_t v = 0; v < maxRRPV + 1; v++)
+                {
+                    cout << insertion_distrib[i][v] << " ";
+                }
+                cout << endl;
             }
 
-            // WE SHOULD NOT REACH HERE
-            assert(0);
-            return 0;
+            cout << "Total Prefetch Downgrades: " << total_prefetch_downgrades << endl;
         }
 
     private:
@@ -163,8 +693,14 @@ namespace Replacement
         // per-core 16K entry. 14-bit signature = 16k entry. 3-bit per entry
         vector<vector<uint32_t>> SHCT;
 
-        int sets, ways, shct_size, maxrrpv, maxshctr;
+        // Statistics
+        uint64_t insertion_distrib[NUM_TYPES][maxRRPV + 1] = {};
+        uint64_t total_prefetch_downgrades = 0;
     };
+
+    static PolicyRegistration lru_registration("lru", make<Lru>), srrip_registration("srrip", make<Srrip>),
+        drrip_registration("drrip", make<Drrip>), ship_registration("ship", make<Ship>),
+        ship_pp_registration("ship++", make<ShipPP>), pmp_srrip_registration("pmp_srrip", make<PmpSrrip>);
 }
 
 static uint32_t rrpv[L1D_SET][L1D_WAY] = {0};
@@ -194,7 +730,7 @@ void rrpv_update(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, u
         rrpv[set][way] = maxRRPV - 1;
 }
 
-Replacement::ShipPP ship(L1D_SET, L1D_WAY, NUM_CPUS, 1<<14, 3, 7);
+Replacement::ShipPP ship(L1D_SET, L1D_WAY, vector<uint32_t>());
 
 uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const BLOCK *current_set, uint64_t ip, uint64_t full_addr, uint32_t type)
 {
@@ -205,11 +741,25 @@ uint32_t CACHE::find_victim(uint32_t cpu, uint64_t instr_id, uint32_t set, const
     //     return ship.find_victim(cpu, instr_id, set, current_set, ip, full_addr, type);
     // }
 
+    if (repl)
+    {
+        uint32_t way = repl->find_victim(cpu, instr_id, set, current_set, ip, full_addr, type);
+        if (way >= NUM_WAY)
+        {
+            cerr << "[" << NAME << "] " << __func__ << " only the LLC can bypass, set: " << set << endl;
+            assert(0);
+        }
+        return way;
+    }
+
     return lru_victim(cpu, instr_id, set, current_set, ip, full_addr, type);
 }
 
 void CACHE::update_replacement_state(uint32_t cpu, uint32_t set, uint32_t way, uint64_t full_addr, uint64_t ip, uint64_t victim_addr, uint32_t type, uint8_t hit)
 {
+    if (repl)
+        return repl->update_replacement_state(cpu, set, way, full_addr, ip, victim_addr, type, hit);
+
     if (type == WRITEBACK)
     {
         if (hit) // wrietback hit does not update LRU state
@@ -305,6 +855,11 @@ void CACHE::lru_update(uint32_t set, uint32_t way)
 
 void CACHE::replacement_final_stats()
 {
+    if (repl)
+    {
+        cout << "CPU " << cpu << " " << NAME << " replacement" << endl;
+        repl->final_stats();
+    }
 }
 
 #ifdef NO_CRC2_COMPILE
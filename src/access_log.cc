@@ -0,0 +1,184 @@
+#include "access_log.h"
+#include "ooo_cpu.h"
+
+L1DAccessLog *l1d_capture[NUM_CPUS];
+L1DReplay *l1d_replay[NUM_CPUS];
+
+string l1d_log_path(const string &path, uint32_t cpu)
+{
+    return NUM_CPUS > 1 ? path + "." + to_string(cpu) : path;
+}
+
+static uint64_t zigzag(int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+
+static int64_t unzigzag(uint64_t value) { return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+
+L1DAccessLog::L1DAccessLog(const string &path, bool write) : writing(write)
+{
+    char magic[sizeof(L1D_LOG_MAGIC)] = L1D_LOG_MAGIC;
+    file = fopen(path.c_str(), write ? "wb" : "rb");
+    if (!file) {
+        cerr << "cannot open L1D access log " << path << endl;
+        assert(0);
+    }
+    if (write)
+        fwrite(magic, sizeof(magic), 1, file);
+    else if (fread(magic, sizeof(magic), 1, file) != 1 || strcmp(magic, L1D_LOG_MAGIC)) {
+        cerr << path << " is not an L1D access log" << endl;
+        assert(0);
+    }
+}
+
+L1DAccessLog::~L1DAccessLog()
+{
+    fclose(file);
+}
+
+void L1DAccessLog::put_varint(uint64_t value)
+{
+    uint8_t buf[10];
+    int len = 0;
+    do {
+        buf[len] = value & 0x7f;
+        value >>= 7;
+        if (value)
+            buf[len] |= 0x80;
+        len++;
+    } while (value);
+    fwrite(buf, 1, len, file);
+}
+
+bool L1DAccessLog::get_varint(uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF)
+            return false;
+        value |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void L1DAccessLog::write(const L1DAccessRecord &record)
+{
+    assert(writing);
+    fputc(record.kind | (record.hit << 1) | (record.prefetch << 2) | (record.type << 3), file);
+    put_varint(record.cycle - last.cycle);
+    put_varint(record.instr - last.instr);
+    put_varint(zigzag(record.addr - last.addr));
+    if (record.kind == L1DAccessRecord::ACCESS) {
+        put_varint(zigzag(record.ip - last.ip));
+        last.ip = record.ip;
+    }
+    else
+        put_varint(zigzag(record.evicted_addr - record.addr));
+
+    last.cycle = record.cycle;
+    last.instr = record.instr;
+    last.addr = record.addr;
+    records++;
+}
+
+bool L1DAccessLog::read(L1DAccessRecord &record)
+{
+    assert(!writing);
+    int flags = fgetc(file);
+    if (flags == EOF)
+        return false;
+
+    uint64_t cycle, instr, addr, other;
+    if (!get_varint(cycle) || !get_varint(instr) || !get_varint(addr) || !get_varint(other)) {
+        cerr << "truncated L1D access log after " << records << " records" << endl;
+        return false;
+    }
+    record.kind = flags & 1;
+    record.hit = (flags >> 1) & 1;
+    record.prefetch = (flags >> 2) & 1;
+    record.type = flags >> 3;
+    record.cycle = last.cycle + cycle;
+    record.instr = last.instr + instr;
+    record.addr = last.addr + unzigzag(addr);
+    if (record.kind == L1DAccessRecord::ACCESS) {
+        record.ip = last.ip + unzigzag(other);
+        record.evicted_addr = 0;
+        last.ip = record.ip;
+    }
+    else {
+        record.ip = 0;
+        record.evicted_addr = record.addr + unzigzag(other);
+    }
+
+    last.cycle = record.cycle;
+    last.instr = record.instr;
+    last.addr = record.addr;
+    records++;
+    return true;
+}
+
+void capture_l1d_access(uint32_t cpu, uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type)
+{
+    L1DAccessRecord record;
+    record.kind = L1DAccessRecord::ACCESS;
+    record.hit = cache_hit;
+    record.type = type;
+    record.cycle = current_core_cycle[cpu];
+    record.instr = ooo_cpu[cpu].num_retired;
+    record.addr = addr;
+    record.ip = ip;
+    l1d_capture[cpu]->write(record);
+}
+
+void capture_l1d_fill(uint32_t cpu, uint64_t addr, uint8_t prefetch, uint64_t evicted_addr)
+{
+    L1DAccessRecord record;
+    record.kind = L1DAccessRecord::FILL;
+    record.prefetch = prefetch;
+    record.cycle = current_core_cycle[cpu];
+    record.instr = ooo_cpu[cpu].num_retired;
+    record.addr = addr;
+    record.evicted_addr = evicted_addr;
+    l1d_capture[cpu]->write(record);
+}
+
+L1DReplay::L1DReplay(const string &path) : log(path, false)
+{
+    has_next = log.read(next);
+}
+
+void L1DReplay::operate(CACHE *l1d)
+{
+    uint32_t cpu = l1d->cpu;
+    while (has_next && next.cycle + skew <= current_core_cycle[cpu]) {
+        // only demand loads are replayed, fills and prefetch hits are re-created by the caches
+        if (next.kind == L1DAccessRecord::ACCESS && next.type == LOAD) {
+            PACKET packet;
+            packet.fill_level = FILL_L1;
+            packet.fill_l1d = 1;
+            packet.cpu = cpu;
+            packet.address = next.addr >> LOG2_BLOCK_SIZE;
+            packet.full_addr = next.addr;
+            packet.v_full_addr = next.addr;
+            packet.instr_id = instr_id++;
+            packet.ip = next.ip;
+            packet.type = LOAD;
+            packet.event_cycle = current_core_cycle[cpu];
+
+            if (l1d->add_rq(&packet) == -2) {
+                // the RQ is full, everything after this access slips by a cycle
+                skew++;
+                stall_cycles++;
+                break;
+            }
+            injected++;
+        }
+        instructions = next.instr;
+        has_next = log.read(next);
+    }
+
+    // nobody waits for the data
+    while (l1d->PROCESSED.occupancy)
+        l1d->PROCESSED.remove_queue(&l1d->PROCESSED.entry[l1d->PROCESSED.head]);
+}
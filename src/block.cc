@@ -1,5 +1,37 @@
 #include "block.h"
 
+PACKET_DEPS_POOL &packet_deps_pool()
+{
+    // never destroyed, packets in static queues may still release handles at exit
+    static PACKET_DEPS_POOL *pool = new PACKET_DEPS_POOL;
+    return *pool;
+}
+
+uint32_t PACKET_DEPS_POOL::allocate()
+{
+    if (free_list.empty()) {
+        uint32_t base = capacity();
+        chunk.push_back(new PACKET_DEPS[PACKET_DEPS_CHUNK]);
+        for (uint32_t i=PACKET_DEPS_CHUNK; i>0; i--)
+            free_list.push_back(base + i - 1);
+    }
+
+    uint32_t handle = free_list.back();
+    free_list.pop_back();
+    return handle;
+}
+
+void PACKET_DEPS_POOL::release(uint32_t handle)
+{
+#ifdef SANITY_CHECK
+    if (handle >= capacity())
+        assert(0);
+#endif
+
+    (*this)[handle] = PACKET_DEPS();
+    free_list.push_back(handle);
+}
+
 int PACKET_QUEUE::check_queue(PACKET *packet)
 {
     if ((head == tail) && occupancy == 0)
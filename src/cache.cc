@@ -1,14 +1,32 @@
 #include "cache.h"
+#include "common.h"
+#include "latency_trace.h"
 #include "set.h"
+#include "access_log.h"
+#include "region_stats.h"
+#include "ooo_cpu.h"
 
 namespace knob{
   bool measure_cache_acc = true;
   uint64_t measure_cache_acc_epoch = 1024;
+  bool filter_prefetch = true;
 }
 uint64_t l2pf_access = 0;
 
 #define EXTRACT_TYPE(metadata) ((metadata >> 8) & 15)
 
+// the pref_filled/pref_useful/pref_late slot of a prefetch: the IPCP type in its metadata, or PMP's metadata as is
+static inline uint32_t pref_stat_index(uint32_t pf_metadata)
+{
+  if (IS_PMP_META(pf_metadata))
+    return pf_metadata;
+#ifdef MATRYOSHKA
+  return EXTRACT_TYPE(pf_metadata);
+#else
+  return pf_metadata;
+#endif
+}
+
 void InfinityCACHE::handle_fill()
 {
   // handle fill
@@ -37,7 +55,7 @@ void InfinityCACHE::handle_fill()
         l1i_prefetcher_cache_fill(fill_cpu, ((MSHR.entry[mshr_index].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE, 0, 0, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0, ((blocks[key].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE);
       if (cache_type == IS_L1D)
         // you can't get full address in low level cache
-        l1d_prefetcher_cache_fill(MSHR.entry[mshr_index].full_addr, 0, 0, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0, blocks[key].address << LOG2_BLOCK_SIZE,
+        l1d_prefetcher_notify_fill(MSHR.entry[mshr_index].full_addr, 0, 0, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0, blocks[key].address << LOG2_BLOCK_SIZE,
                                   MSHR.entry[mshr_index].pf_metadata);
       if (cache_type == IS_L2C)
         MSHR.entry[mshr_index].pf_metadata = l2c_prefetcher_cache_fill(MSHR.entry[mshr_index].address << LOG2_BLOCK_SIZE /* 这是准备替换的address */, 0, 0, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0,
@@ -207,6 +225,20 @@ void CACHE::handle_fill()
         miss_latency[cpu][MSHR.entry[mshr_index].type] += current_miss_latency;
       }
 
+      // the line bypassed this cache, it is no longer in flight here
+      if (knob::filter_prefetch)
+        pf_filter.clear(MSHR.entry[mshr_index].address);
+
+      if (MSHR.entry[mshr_index].trace_id)
+      {
+        uint32_t trace_id = MSHR.entry[mshr_index].trace_id;
+        latency_trace.end(trace_id, cache_type, LatencyTrace::FILL, current_core_cycle[fill_cpu]);
+        latency_trace.end(trace_id, cache_type, LatencyTrace::MSHR, current_core_cycle[fill_cpu]);
+        latency_trace.arrive(trace_id, fill_level, current_core_cycle[fill_cpu]);
+      }
+      if (latency_trace.merged_waiting())
+        latency_trace.fill(this, cache_type, MSHR.entry[mshr_index].address, fill_level, current_core_cycle[fill_cpu]);
+
       MSHR.remove_queue(&MSHR.entry[mshr_index]);
       MSHR.num_returned--;
 
@@ -278,7 +310,7 @@ void CACHE::handle_fill()
         l1i_prefetcher_cache_fill(fill_cpu, ((MSHR.entry[mshr_index].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE, set, way, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0, ((block[set][way].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE);
       if (cache_type == IS_L1D)
         // you can't get full address in low level cache
-        l1d_prefetcher_cache_fill(MSHR.entry[mshr_index].full_addr, set, way, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0, block[set][way].address << LOG2_BLOCK_SIZE,
+        l1d_prefetcher_notify_fill(MSHR.entry[mshr_index].full_addr, set, way, (MSHR.entry[mshr_index].type == PREFETCH) ? 1 : 0, block[set][way].address << LOG2_BLOCK_SIZE,
                                   MSHR.entry[mshr_index].pf_metadata);
       if (cache_type == IS_L2C) {
       
@@ -389,6 +421,16 @@ void CACHE::handle_fill()
         miss_latency[cpu][MSHR.entry[mshr_index].type] += current_miss_latency;
       }
 
+      if (MSHR.entry[mshr_index].trace_id)
+      {
+        uint32_t trace_id = MSHR.entry[mshr_index].trace_id;
+        latency_trace.end(trace_id, cache_type, LatencyTrace::FILL, current_core_cycle[fill_cpu]);
+        latency_trace.end(trace_id, cache_type, LatencyTrace::MSHR, current_core_cycle[fill_cpu]);
+        latency_trace.arrive(trace_id, fill_level, current_core_cycle[fill_cpu]);
+      }
+      if (latency_trace.merged_waiting())
+        latency_trace.fill(this, cache_type, MSHR.entry[mshr_index].address, fill_level, current_core_cycle[fill_cpu]);
+
       MSHR.remove_queue(&MSHR.entry[mshr_index]);
       MSHR.num_returned--;
 
@@ -650,6 +692,8 @@ void CACHE::handle_writeback()
     // access cache
     uint32_t set = this->get_set(WQ.entry[index].address);
     int way = check_hit(&WQ.entry[index]);
+    if (way < 0 && perfect)
+      way = perfect_fill(&WQ.entry[index]);
 
     if (way >= 0)
     { // writeback hit (or RFO hit for L1D)
@@ -703,6 +747,12 @@ void CACHE::handle_writeback()
       HIT[WQ.entry[index].type]++;
       ACCESS[WQ.entry[index].type]++;
 
+      if (WQ.entry[index].trace_id)
+      {
+        latency_trace.end(WQ.entry[index].trace_id, cache_type, LatencyTrace::WQ, current_core_cycle[writeback_cpu]);
+        latency_trace.arrive(WQ.entry[index].trace_id, fill_level, current_core_cycle[writeback_cpu]);
+      }
+
       // remove this entry from WQ
       WQ.remove_queue(&WQ.entry[index]);
     }
@@ -786,12 +836,24 @@ void CACHE::handle_writeback()
             {
               uint8_t prior_returned = MSHR.entry[mshr_index].returned;
               uint64_t prior_event_cycle = MSHR.entry[mshr_index].event_cycle;
+              uint32_t prior_trace_id = MSHR.entry[mshr_index].trace_id;
               MSHR.entry[mshr_index] = WQ.entry[index];
 
               // in case request is already returned, we should keep event_cycle and retunred variables
               MSHR.entry[mshr_index].returned = prior_returned;
               MSHR.entry[mshr_index].event_cycle = prior_event_cycle;
+
+              if (prior_trace_id)
+              {
+                MSHR.entry[mshr_index].trace_id = prior_trace_id;
+                latency_trace.late(prior_trace_id, current_core_cycle[writeback_cpu]);
+              }
+              else if (MSHR.entry[mshr_index].trace_id)
+                latency_trace.begin(MSHR.entry[mshr_index].trace_id, cache_type, LatencyTrace::MSHR, current_core_cycle[writeback_cpu]);
             }
+            if (WQ.entry[index].trace_id && (WQ.entry[index].trace_id != MSHR.entry[mshr_index].trace_id))
+              latency_trace.merge(WQ.entry[index].trace_id, this, cache_type, MSHR.entry[mshr_index].address, fill_level,
+                                  current_core_cycle[writeback_cpu]);
 
             MSHR_MERGED[WQ.entry[index].type]++;
 
@@ -817,6 +879,9 @@ void CACHE::handle_writeback()
           MISS[WQ.entry[index].type]++;
           ACCESS[WQ.entry[index].type]++;
 
+          if (WQ.entry[index].trace_id)
+            latency_trace.end(WQ.entry[index].trace_id, cache_type, LatencyTrace::WQ, current_core_cycle[writeback_cpu]);
+
           // remove this entry from WQ
           WQ.remove_queue(&WQ.entry[index]);
         }
@@ -898,7 +963,7 @@ void CACHE::handle_writeback()
           if (cache_type == IS_L1I)
             l1i_prefetcher_cache_fill(writeback_cpu, ((WQ.entry[index].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE, set, way, 0, ((block[set][way].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE);
           if (cache_type == IS_L1D)
-            l1d_prefetcher_cache_fill(WQ.entry[index].full_addr, set, way, 0, block[set][way].address << LOG2_BLOCK_SIZE, WQ.entry[index].pf_metadata);
+            l1d_prefetcher_notify_fill(WQ.entry[index].full_addr, set, way, 0, block[set][way].address << LOG2_BLOCK_SIZE, WQ.entry[index].pf_metadata);
           else if (cache_type == IS_L2C)
 #ifdef FULL_ADDR
             WQ.entry[index].pf_metadata = l2c_prefetcher_cache_fill(WQ.entry[index].full_addr, set, way, 0,
@@ -1024,10 +1089,7 @@ void InfinityCACHE::handle_read()
           if (cache_type == IS_L1I)
             l1i_prefetcher_cache_operate(read_cpu, RQ.entry[index].ip, 1, blocks[key].prefetch);
           if (cache_type == IS_L1D)
-            if (SUPPORT_VA)
-              l1d_prefetcher_operate(RQ.entry[index].v_full_addr, RQ.entry[index].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type);
-            else
-              l1d_prefetcher_operate(RQ.entry[index].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type);
+            l1d_prefetcher_notify(RQ.entry[index].v_full_addr, RQ.entry[index].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type);
           else if (cache_type == IS_L2C)
 #ifdef FULL_ADDR
             l2c_prefetcher_operate(blocks[key].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type, 0);
@@ -1081,13 +1143,7 @@ void InfinityCACHE::handle_read()
           pf_useful++;
           pf_useful_epoch++;
           // TODO
-#ifdef MATRYOSHKA
-          int type = EXTRACT_TYPE(blocks[key].pf_metadata);
-          pref_useful[cpu][type]++;
-#else
-          int trigger_offset = (blocks[key].pf_metadata);
-          pref_useful[cpu][trigger_offset]++;
-#endif
+          pref_useful[cpu][pref_stat_index(blocks[key].pf_metadata)]++;
           blocks[key].prefetch = 0;
         }
         blocks[key].used = 1;
@@ -1184,8 +1240,8 @@ void InfinityCACHE::handle_read()
               {
                 uint32_t sq_index = RQ.entry[index].sq_index;
                 MSHR.entry[mshr_index].store_merged = 1;
-                MSHR.entry[mshr_index].sq_index_depend_on_me.insert(sq_index);
-                MSHR.entry[mshr_index].sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me, SQ_SIZE);
+                MSHR.entry[mshr_index].merge_deps().sq_index_depend_on_me.insert(sq_index);
+                MSHR.entry[mshr_index].merge_deps().sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me(), SQ_SIZE);
               }
 
               if (RQ.entry[index].load_merged)
@@ -1193,7 +1249,7 @@ void InfinityCACHE::handle_read()
                 //uint32_t lq_index = RQ.entry[index].lq_index;
                 MSHR.entry[mshr_index].load_merged = 1;
                 //MSHR.entry[mshr_index].lq_index_depend_on_me[lq_index] = 1;
-                MSHR.entry[mshr_index].lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me, LQ_SIZE);
+                MSHR.entry[mshr_index].merge_deps().lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me(), LQ_SIZE);
               }
             }
             else
@@ -1203,7 +1259,7 @@ void InfinityCACHE::handle_read()
                 uint32_t rob_index = RQ.entry[index].rob_index;
                 MSHR.entry[mshr_index].instruction = 1; // add as instruction type
                 MSHR.entry[mshr_index].instr_merged = 1;
-                MSHR.entry[mshr_index].rob_index_depend_on_me.insert(rob_index);
+                MSHR.entry[mshr_index].merge_deps().rob_index_depend_on_me.insert(rob_index);
 
                 DP(if (warmup_complete[MSHR.entry[mshr_index].cpu])
                    {
@@ -1213,7 +1269,7 @@ void InfinityCACHE::handle_read()
 
                 if (RQ.entry[index].instr_merged)
                 {
-                  MSHR.entry[mshr_index].rob_index_depend_on_me.join(RQ.entry[index].rob_index_depend_on_me, ROB_SIZE);
+                  MSHR.entry[mshr_index].merge_deps().rob_index_depend_on_me.join(RQ.entry[index].rob_index_depend_on_me(), ROB_SIZE);
                   DP(if (warmup_complete[MSHR.entry[mshr_index].cpu])
                      {
                        cout << "[INSTR_MERGED] " << __func__ << " cpu: " << MSHR.entry[mshr_index].cpu << " instr_id: " << MSHR.entry[mshr_index].instr_id;
@@ -1226,18 +1282,18 @@ void InfinityCACHE::handle_read()
                 uint32_t lq_index = RQ.entry[index].lq_index;
                 MSHR.entry[mshr_index].is_data = 1; // add as data type
                 MSHR.entry[mshr_index].load_merged = 1;
-                MSHR.entry[mshr_index].lq_index_depend_on_me.insert(lq_index);
+                MSHR.entry[mshr_index].merge_deps().lq_index_depend_on_me.insert(lq_index);
 
                 DP(if (warmup_complete[read_cpu])
                    {
                      cout << "[DATA_MERGED] " << __func__ << " cpu: " << read_cpu << " instr_id: " << RQ.entry[index].instr_id;
                      cout << " merged rob_index: " << RQ.entry[index].rob_index << " instr_id: " << RQ.entry[index].instr_id << " lq_index: " << RQ.entry[index].lq_index << endl;
                    });
-                MSHR.entry[mshr_index].lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me, LQ_SIZE);
+                MSHR.entry[mshr_index].merge_deps().lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me(), LQ_SIZE);
                 if (RQ.entry[index].store_merged)
                 {
                   MSHR.entry[mshr_index].store_merged = 1;
-                  MSHR.entry[mshr_index].sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me, SQ_SIZE);
+                  MSHR.entry[mshr_index].merge_deps().sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me(), SQ_SIZE);
                 }
               }
             }
@@ -1293,10 +1349,7 @@ void InfinityCACHE::handle_read()
             if (cache_type == IS_L1I)
               l1i_prefetcher_cache_operate(read_cpu, RQ.entry[index].ip, 0, 0);
             if (cache_type == IS_L1D)
-              if (SUPPORT_VA)
-                l1d_prefetcher_operate(RQ.entry[index].v_full_addr, RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type);
-              else
-                l1d_prefetcher_operate(RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type);
+              l1d_prefetcher_notify(RQ.entry[index].v_full_addr, RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type);
             if (cache_type == IS_L2C)
 #ifdef FULL_ADDR
               l2c_prefetcher_operate(RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type, 0);
@@ -1354,6 +1407,8 @@ void CACHE::handle_read()
       // access cache
       uint32_t set = this->get_set(RQ.entry[index].address);
       int way = check_hit(&RQ.entry[index]);
+      if (way < 0 && perfect)
+        way = perfect_fill(&RQ.entry[index]);
 
       if (way >= 0)
       { // read hit
@@ -1391,10 +1446,7 @@ void CACHE::handle_read()
           if (cache_type == IS_L1I)
             l1i_prefetcher_cache_operate(read_cpu, RQ.entry[index].ip, 1, block[set][way].prefetch);
           if (cache_type == IS_L1D)
-            if (SUPPORT_VA)
-              l1d_prefetcher_operate(RQ.entry[index].v_full_addr, RQ.entry[index].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type);
-            else
-              l1d_prefetcher_operate(RQ.entry[index].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type);
+            l1d_prefetcher_notify(RQ.entry[index].v_full_addr, RQ.entry[index].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type);
           else if (cache_type == IS_L2C)
 #ifdef FULL_ADDR
             l2c_prefetcher_operate(block[set][way].full_addr, RQ.entry[index].ip, 1, RQ.entry[index].type, 0);
@@ -1465,13 +1517,7 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
           pf_useful++;
           pf_useful_epoch++;
           // TODO
-#ifdef MATRYOSHKA
-          int type = EXTRACT_TYPE(block[set][way].pf_metadata);
-          pref_useful[cpu][type]++;
-#else
-          int trigger_offset = (block[set][way].pf_metadata);
-          pref_useful[cpu][trigger_offset]++;
-#endif
+          pref_useful[cpu][pref_stat_index(block[set][way].pf_metadata)]++;
 
           block[set][way].prefetch = 0;
         }
@@ -1480,6 +1526,12 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
         HIT[RQ.entry[index].type]++;
         ACCESS[RQ.entry[index].type]++;
 
+        if (RQ.entry[index].trace_id)
+        {
+          latency_trace.end(RQ.entry[index].trace_id, cache_type, LatencyTrace::RQ, current_core_cycle[read_cpu]);
+          latency_trace.arrive(RQ.entry[index].trace_id, fill_level, current_core_cycle[read_cpu]);
+        }
+
         // remove this entry from RQ
         RQ.remove_queue(&RQ.entry[index]);
         reads_available_this_cycle--;
@@ -1571,8 +1623,8 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
               {
                 uint32_t sq_index = RQ.entry[index].sq_index;
                 MSHR.entry[mshr_index].store_merged = 1;
-                MSHR.entry[mshr_index].sq_index_depend_on_me.insert(sq_index);
-                MSHR.entry[mshr_index].sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me, SQ_SIZE);
+                MSHR.entry[mshr_index].merge_deps().sq_index_depend_on_me.insert(sq_index);
+                MSHR.entry[mshr_index].merge_deps().sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me(), SQ_SIZE);
               }
 
               if (RQ.entry[index].load_merged)
@@ -1580,7 +1632,7 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
                 //uint32_t lq_index = RQ.entry[index].lq_index;
                 MSHR.entry[mshr_index].load_merged = 1;
                 //MSHR.entry[mshr_index].lq_index_depend_on_me[lq_index] = 1;
-                MSHR.entry[mshr_index].lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me, LQ_SIZE);
+                MSHR.entry[mshr_index].merge_deps().lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me(), LQ_SIZE);
               }
             }
             else
@@ -1590,7 +1642,7 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
                 uint32_t rob_index = RQ.entry[index].rob_index;
                 MSHR.entry[mshr_index].instruction = 1; // add as instruction type
                 MSHR.entry[mshr_index].instr_merged = 1;
-                MSHR.entry[mshr_index].rob_index_depend_on_me.insert(rob_index);
+                MSHR.entry[mshr_index].merge_deps().rob_index_depend_on_me.insert(rob_index);
 
                 DP(if (warmup_complete[MSHR.entry[mshr_index].cpu])
                    {
@@ -1600,7 +1652,7 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
 
                 if (RQ.entry[index].instr_merged)
                 {
-                  MSHR.entry[mshr_index].rob_index_depend_on_me.join(RQ.entry[index].rob_index_depend_on_me, ROB_SIZE);
+                  MSHR.entry[mshr_index].merge_deps().rob_index_depend_on_me.join(RQ.entry[index].rob_index_depend_on_me(), ROB_SIZE);
                   DP(if (warmup_complete[MSHR.entry[mshr_index].cpu])
                      {
                        cout << "[INSTR_MERGED] " << __func__ << " cpu: " << MSHR.entry[mshr_index].cpu << " instr_id: " << MSHR.entry[mshr_index].instr_id;
@@ -1613,18 +1665,18 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
                 uint32_t lq_index = RQ.entry[index].lq_index;
                 MSHR.entry[mshr_index].is_data = 1; // add as data type
                 MSHR.entry[mshr_index].load_merged = 1;
-                MSHR.entry[mshr_index].lq_index_depend_on_me.insert(lq_index);
+                MSHR.entry[mshr_index].merge_deps().lq_index_depend_on_me.insert(lq_index);
 
                 DP(if (warmup_complete[read_cpu])
                    {
                      cout << "[DATA_MERGED] " << __func__ << " cpu: " << read_cpu << " instr_id: " << RQ.entry[index].instr_id;
                      cout << " merged rob_index: " << RQ.entry[index].rob_index << " instr_id: " << RQ.entry[index].instr_id << " lq_index: " << RQ.entry[index].lq_index << endl;
                    });
-                MSHR.entry[mshr_index].lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me, LQ_SIZE);
+                MSHR.entry[mshr_index].merge_deps().lq_index_depend_on_me.join(RQ.entry[index].lq_index_depend_on_me(), LQ_SIZE);
                 if (RQ.entry[index].store_merged)
                 {
                   MSHR.entry[mshr_index].store_merged = 1;
-                  MSHR.entry[mshr_index].sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me, SQ_SIZE);
+                  MSHR.entry[mshr_index].merge_deps().sq_index_depend_on_me.join(RQ.entry[index].sq_index_depend_on_me(), SQ_SIZE);
                 }
               }
             }
@@ -1647,12 +1699,25 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
             {
               uint8_t prior_returned = MSHR.entry[mshr_index].returned;
               uint64_t prior_event_cycle = MSHR.entry[mshr_index].event_cycle;
+              uint32_t prior_trace_id = MSHR.entry[mshr_index].trace_id;
               MSHR.entry[mshr_index] = RQ.entry[index];
 
               // in case request is already returned, we should keep event_cycle and retunred variables
               MSHR.entry[mshr_index].returned = prior_returned;
               MSHR.entry[mshr_index].event_cycle = prior_event_cycle;
+
+              // a traced prefetch keeps its record, the demand waiting on it makes it late
+              if (prior_trace_id)
+              {
+                MSHR.entry[mshr_index].trace_id = prior_trace_id;
+                latency_trace.late(prior_trace_id, current_core_cycle[read_cpu]);
+              }
+              else if (MSHR.entry[mshr_index].trace_id)
+                latency_trace.begin(MSHR.entry[mshr_index].trace_id, cache_type, LatencyTrace::MSHR, current_core_cycle[read_cpu]);
             }
+            if (RQ.entry[index].trace_id && (RQ.entry[index].trace_id != MSHR.entry[mshr_index].trace_id))
+              latency_trace.merge(RQ.entry[index].trace_id, this, cache_type, MSHR.entry[mshr_index].address, fill_level,
+                                  current_core_cycle[read_cpu]);
 
             MSHR_MERGED[RQ.entry[index].type]++;
 
@@ -1680,11 +1745,7 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
             if (cache_type == IS_L1I)
               l1i_prefetcher_cache_operate(read_cpu, RQ.entry[index].ip, 0, 0);
             if (cache_type == IS_L1D)
-              if (SUPPORT_VA){
-                l1d_prefetcher_operate(RQ.entry[index].v_full_addr, RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type);
-              } else {
-                l1d_prefetcher_operate(RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type);
-              }
+              l1d_prefetcher_notify(RQ.entry[index].v_full_addr, RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type);
             if (cache_type == IS_L2C)
 #ifdef FULL_ADDR
               l2c_prefetcher_operate(RQ.entry[index].full_addr, RQ.entry[index].ip, 0, RQ.entry[index].type, 0);
@@ -1707,6 +1768,9 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
           MISS[RQ.entry[index].type]++;
           ACCESS[RQ.entry[index].type]++;
 
+          if (RQ.entry[index].trace_id)
+            latency_trace.end(RQ.entry[index].trace_id, cache_type, LatencyTrace::RQ, current_core_cycle[read_cpu]);
+
           // remove this entry from RQ
           RQ.remove_queue(&RQ.entry[index]);
           reads_available_this_cycle--;
@@ -1756,10 +1820,7 @@ void InfinityCACHE::handle_prefetch()
         if (PQ.entry[index].pf_origin_level < fill_level)
         {
           if (cache_type == IS_L1D)
-            if (SUPPORT_VA)
-              l1d_prefetcher_operate(PQ.entry[index].v_full_addr, PQ.entry[index].full_addr, PQ.entry[index].ip, 1, PREFETCH);
-            else
-              l1d_prefetcher_operate(PQ.entry[index].full_addr, PQ.entry[index].ip, 1, PREFETCH);
+            l1d_prefetcher_notify(PQ.entry[index].v_full_addr, PQ.entry[index].full_addr, PQ.entry[index].ip, 1, PREFETCH);
           else if (cache_type == IS_L2C)
 #ifdef FULL_ADDR
             PQ.entry[index].pf_metadata = l2c_prefetcher_operate(blocks[key].full_addr, PQ.entry[index].ip, 1, PREFETCH, PQ.entry[index].pf_metadata);
@@ -1883,10 +1944,7 @@ void InfinityCACHE::handle_prefetch()
                 if (PQ.entry[index].pf_origin_level < fill_level)
                 {
                   if (cache_type == IS_L1D)
-                    if (SUPPORT_VA)
-                      l1d_prefetcher_operate(PQ.entry[index].v_full_addr, PQ.entry[index].full_addr, PQ.entry[index].ip, 0, PREFETCH);
-                    else
-                      l1d_prefetcher_operate(PQ.entry[index].full_addr, PQ.entry[index].ip, 0, PREFETCH);
+                    l1d_prefetcher_notify(PQ.entry[index].v_full_addr, PQ.entry[index].full_addr, PQ.entry[index].ip, 0, PREFETCH);
                   if (cache_type == IS_L2C)
 #ifdef FULL_ADDR
                     PQ.entry[index].pf_metadata = l2c_prefetcher_operate(PQ.entry[index].full_addr, PQ.entry[index].ip, 0, PREFETCH, PQ.entry[index].pf_metadata);
@@ -1919,13 +1977,7 @@ void InfinityCACHE::handle_prefetch()
           { // already in-flight miss
             // int type = EXTRACT_TYPE(PQ.entry[index].pf_metadata);
             if (!MSHR.entry[mshr_index].prefetched) {
-#ifdef MATRYOSHKA
-              int type = EXTRACT_TYPE(PQ.entry[index].pf_metadata);
-              pref_late[cpu][type]++;
-#else
-              int trigger_offset = (PQ.entry[index].pf_metadata);
-              pref_late[cpu][trigger_offset]++;
-#endif
+              pref_late[cpu][pref_stat_index(PQ.entry[index].pf_metadata)]++;
               pf_late++;
             }
 
@@ -2012,6 +2064,8 @@ void CACHE::handle_prefetch()
       // access cache
       uint32_t set = this->get_set(PQ.entry[index].address);
       int way = check_hit(&PQ.entry[index]);
+      if (way < 0 && perfect)
+        way = perfect_fill(&PQ.entry[index]);
 
       if (way >= 0)
       { // prefetch hit
@@ -2048,10 +2102,7 @@ void CACHE::handle_prefetch()
         if (PQ.entry[index].pf_origin_level < fill_level)
         {
           if (cache_type == IS_L1D)
-            if (SUPPORT_VA)
-              l1d_prefetcher_operate(PQ.entry[index].v_full_addr, PQ.entry[index].full_addr, PQ.entry[index].ip, 1, PREFETCH);
-            else
-              l1d_prefetcher_operate(PQ.entry[index].full_addr, PQ.entry[index].ip, 1, PREFETCH);
+            l1d_prefetcher_notify(PQ.entry[index].v_full_addr, PQ.entry[index].full_addr, PQ.entry[index].ip, 1, PREFETCH);
           else if (cache_type == IS_L2C)
 #ifdef FULL_ADDR
             PQ.entry[index].pf_metadata = l2c_prefetcher_operate(block[set][way].full_addr, PQ.entry[index].ip, 1, PREFETCH, PQ.entry[index].pf_metadata);
@@ -2098,6 +2149,12 @@ void CACHE::handle_prefetch()
         HIT[PQ.entry[index].type]++;
         ACCESS[PQ.entry[index].type]++;
 
+        if (PQ.entry[index].trace_id)
+        {
+          latency_trace.end(PQ.entry[index].trace_id, cache_type, LatencyTrace::PQ, current_core_cycle[prefetch_cpu]);
+          latency_trace.arrive(PQ.entry[index].trace_id, fill_level, current_core_cycle[prefetch_cpu]);
+        }
+
         // remove this entry from PQ
         PQ.remove_queue(&PQ.entry[index]);
         reads_available_this_cycle--;
@@ -2175,10 +2232,7 @@ void CACHE::handle_prefetch()
                 if (PQ.entry[index].pf_origin_level < fill_level)
                 {
                   if (cache_type == IS_L1D)
-                    if (SUPPORT_VA)
-                      l1d_prefetcher_operate(PQ.entry[index].v_full_addr, PQ.entry[index].full_addr, PQ.entry[index].ip, 0, PREFETCH);
-                    else
-                      l1d_prefetcher_operate(PQ.entry[index].full_addr, PQ.entry[index].ip, 0, PREFETCH);
+                    l1d_prefetcher_notify(PQ.entry[index].v_full_addr, PQ.entry[index].full_addr, PQ.entry[index].ip, 0, PREFETCH);
                   if (cache_type == IS_L2C)
 #ifdef FULL_ADDR
                     PQ.entry[index].pf_metadata = l2c_prefetcher_operate(PQ.entry[index].full_addr, PQ.entry[index].ip, 0, PREFETCH, PQ.entry[index].pf_metadata);
@@ -2211,12 +2265,8 @@ void CACHE::handle_prefetch()
           else if (mshr_index != -1)
           { // already in-flight miss
             if (!MSHR.entry[mshr_index].prefetched) {
-#ifdef MATRYOSHKA
-              int type = EXTRACT_TYPE(PQ.entry[index].pf_metadata);
-              pref_late[cpu][type]++;
-#else
-              int trigger_offset = (PQ.entry[index].pf_metadata);
-              pref_late[cpu][trigger_offset]++;
+              pref_late[cpu][pref_stat_index(PQ.entry[index].pf_metadata)]++;
+#ifndef MATRYOSHKA
               pf_late++;
 #endif
             }
@@ -2237,6 +2287,10 @@ void CACHE::handle_prefetch()
 
             MSHR_MERGED[PQ.entry[index].type]++;
 
+            if (PQ.entry[index].trace_id && (PQ.entry[index].trace_id != MSHR.entry[mshr_index].trace_id))
+              latency_trace.merge(PQ.entry[index].trace_id, this, cache_type, MSHR.entry[mshr_index].address, fill_level,
+                                  current_core_cycle[prefetch_cpu]);
+
             DP(if (warmup_complete[prefetch_cpu])
                {
                  cout << "[" << NAME << "] " << __func__ << " mshr merged";
@@ -2267,6 +2321,9 @@ void CACHE::handle_prefetch()
           MISS[PQ.entry[index].type]++;
           ACCESS[PQ.entry[index].type]++;
 
+          if (PQ.entry[index].trace_id)
+            latency_trace.end(PQ.entry[index].trace_id, cache_type, LatencyTrace::PQ, current_core_cycle[prefetch_cpu]);
+
           // remove this entry from PQ
           PQ.remove_queue(&PQ.entry[index]);
           reads_available_this_cycle--;
@@ -2294,6 +2351,14 @@ void CACHE::operate()
 
   if (PQ.occupancy && (reads_available_this_cycle > 0))
     this->handle_prefetch();
+
+  // let prefetchers issue work queued in earlier cycles
+  if (cache_type == IS_L1D)
+    l1d_prefetcher_cycle_operate();
+  else if (cache_type == IS_L2C)
+    l2c_prefetcher_cycle_operate();
+  else if (cache_type == IS_LLC)
+    llc_prefetcher_cycle_operate();
   
   handle_prefetch_feedback();
 }
@@ -2354,17 +2419,7 @@ void InfinityCACHE::fill_cache(PACKET *packet)
   if (blocks[key].prefetch)
   {
     pf_fill++;
-    /**
-     * @brief extract the prefetch type from metadata
-     *        only work for ipcp 2020
-     */
-#ifdef MATRYOSHKA
-    int type = EXTRACT_TYPE(packet->pf_metadata);
-    pref_filled[cpu][type]++;
-#else
-    int trigger_offset = (blocks[key].pf_metadata);
-    pref_filled[cpu][trigger_offset]++;
-#endif
+    pref_filled[cpu][pref_stat_index(packet->pf_metadata)]++;
   }
 
   blocks[key].delta = packet->delta;
@@ -2423,6 +2478,13 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
     pf_useless++;
   }
 
+  if (knob::filter_prefetch)
+  {
+    if (block[set][way].valid)
+      pf_filter.clear(block[set][way].address);
+    pf_filter.clear(packet->address);
+  }
+
   if (block[set][way].valid == 0)
     block[set][way].valid = 1;
   block[set][way].dirty = 0;
@@ -2433,17 +2495,7 @@ g_fout.fout << pf_addr_scores[address].pattern << "," << block[set][way].full_ad
   {
     pf_fill++;
     pf_filled_epoch++;
-    /**
-     * @brief extract the prefetch type from metadata
-     *        only work for ipcp 2020
-     */
-#ifdef MATRYOHSKA
-    int type = EXTRACT_TYPE(packet->pf_metadata);
-    pref_filled[cpu][type]++;
-#else
-    int trigger_offset = packet->pf_metadata;
-    pref_filled[cpu][trigger_offset]++;
-#endif
+    pref_filled[cpu][pref_stat_index(packet->pf_metadata)]++;
   }
 
   block[set][way].delta = packet->delta;
@@ -2612,7 +2664,7 @@ int CACHE::add_rq(PACKET *packet)
     if (packet->instruction)
     {
       uint32_t rob_index = packet->rob_index;
-      RQ.entry[index].rob_index_depend_on_me.insert(rob_index);
+      RQ.entry[index].merge_deps().rob_index_depend_on_me.insert(rob_index);
       RQ.entry[index].instruction = 1; // add as instruction type
       RQ.entry[index].instr_merged = 1;
 
@@ -2629,13 +2681,13 @@ int CACHE::add_rq(PACKET *packet)
       {
 
         uint32_t sq_index = packet->sq_index;
-        RQ.entry[index].sq_index_depend_on_me.insert(sq_index);
+        RQ.entry[index].merge_deps().sq_index_depend_on_me.insert(sq_index);
         RQ.entry[index].store_merged = 1;
       }
       else
       {
         uint32_t lq_index = packet->lq_index;
-        RQ.entry[index].lq_index_depend_on_me.insert(lq_index);
+        RQ.entry[index].merge_deps().lq_index_depend_on_me.insert(lq_index);
         RQ.entry[index].load_merged = 1;
 
         DP(if (warmup_complete[packet->cpu])
@@ -2683,6 +2735,12 @@ int CACHE::add_rq(PACKET *packet)
   }
 #endif
 
+  // sample the core's data accesses
+  if (latency_trace.enabled && (cache_type == IS_L1D))
+    packet->trace_id = latency_trace.sample(*packet, cache_type, current_core_cycle[packet->cpu]);
+  if (packet->trace_id)
+    latency_trace.begin(packet->trace_id, cache_type, LatencyTrace::RQ, current_core_cycle[packet->cpu]);
+
   RQ.entry[index] = *packet;
 
   // ADD LATENCY
@@ -2710,6 +2768,11 @@ int CACHE::add_rq(PACKET *packet)
   RQ.TO_CACHE++;
   RQ.ACCESS++;
 
+  if (mrc)
+    mrc->access(packet->address, packet->type);
+  if (shadow)
+    shadow->access(get_set(packet->address), *packet);
+
   return -1;
 }
 
@@ -2740,6 +2803,12 @@ int CACHE::add_wq(PACKET *packet)
     assert(0);
   }
 
+  // sample the core's stores, RFOs come through the L1D WQ
+  if (latency_trace.enabled && (cache_type == IS_L1D))
+    packet->trace_id = latency_trace.sample(*packet, cache_type, current_core_cycle[packet->cpu]);
+  if (packet->trace_id)
+    latency_trace.begin(packet->trace_id, cache_type, LatencyTrace::WQ, current_core_cycle[packet->cpu]);
+
   WQ.entry[index] = *packet;
 
   // ADD LATENCY
@@ -2765,10 +2834,21 @@ int CACHE::add_wq(PACKET *packet)
   WQ.TO_CACHE++;
   WQ.ACCESS++;
 
+  if (mrc)
+    mrc->access(packet->address, packet->type);
+  if (shadow)
+    shadow->access(get_set(packet->address), *packet);
+
   return -1;
 }
 
 int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int pf_fill_level, uint32_t prefetch_metadata)
+{
+  return prefetch_line(cpu, ip, base_addr, pf_addr, pf_fill_level, prefetch_metadata);
+}
+
+// for a prefetcher of a shared cache that issues on behalf of another core than the one it last served
+int CACHE::prefetch_line(uint32_t pf_cpu, uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int pf_fill_level, uint32_t prefetch_metadata)
 {
   pf_requested++;
 
@@ -2776,6 +2856,45 @@ int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int
   {
     if ((base_addr >> LOG2_PAGE_SIZE) == (pf_addr >> LOG2_PAGE_SIZE))
     {
+      if (functional_warming)
+      {
+        // fast-forward: fill the target level (and the ones below it) right away
+        CACHE *target = this;
+        while (target->fill_level < pf_fill_level && target->warm_lower())
+          target = target->warm_lower();
+
+        PACKET pf_packet;
+        pf_packet.fill_level = pf_fill_level;
+        pf_packet.pf_origin_level = fill_level;
+        pf_packet.pf_metadata = prefetch_metadata;
+        pf_packet.cpu = pf_cpu;
+        pf_packet.address = pf_addr >> LOG2_BLOCK_SIZE;
+        pf_packet.full_addr = pf_addr;
+        pf_packet.ip = ip;
+        pf_packet.type = PREFETCH;
+        target->warm_access(&pf_packet);
+
+        pf_issued++;
+        return 1;
+      }
+
+      if (knob::filter_prefetch)
+      {
+        // don't spend a PQ slot on a line handle_prefetch would drop anyway
+        uint64_t pf_block = pf_addr >> LOG2_BLOCK_SIZE;
+        if (get_way(pf_block, get_set(pf_block)) < NUM_WAY)
+        {
+          pf_filter.drop(PrefetchFilter::DROP_RESIDENT);
+          return 0;
+        }
+        if (pf_filter.inflight(pf_block, pf_fill_level, current_core_cycle[pf_cpu]))
+        {
+          pf_filter.drop(PrefetchFilter::DROP_INFLIGHT);
+          return 0;
+        }
+        pf_filter.record(pf_block, pf_fill_level, current_core_cycle[pf_cpu]);
+      }
+
       PACKET pf_packet;
       pf_packet.fill_level = pf_fill_level;
       pf_packet.pf_origin_level = fill_level;
@@ -2784,7 +2903,7 @@ int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int
         pf_packet.fill_l1d = 1;
       }
       pf_packet.pf_metadata = prefetch_metadata;
-      pf_packet.cpu = cpu;
+      pf_packet.cpu = pf_cpu;
       //pf_packet.data_index = LQ.entry[lq_index].data_index;
       //pf_packet.lq_index = lq_index;
       pf_packet.address = pf_addr >> LOG2_BLOCK_SIZE;
@@ -2793,7 +2912,7 @@ int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int
       //pf_packet.rob_index = LQ.entry[lq_index].rob_index;
       pf_packet.ip = ip;
       pf_packet.type = PREFETCH;
-      pf_packet.event_cycle = current_core_cycle[cpu];
+      pf_packet.event_cycle = current_core_cycle[pf_cpu];
       pf_packet.prefetched = 1;
       // give a dummy 0 as the IP of a prefetch
       add_pq(&pf_packet);
@@ -2807,6 +2926,224 @@ int CACHE::prefetch_line(uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int
   return 0;
 }
 
+void CACHE::l1d_prefetcher_notify(uint64_t v_addr, uint64_t addr, uint64_t ip, uint8_t cache_hit, uint8_t type)
+{
+  if (l1d_capture[cpu] && !functional_warming)
+    capture_l1d_access(cpu, addr, ip, cache_hit, type);
+  if (region_analyzer[cpu] && !functional_warming)
+    region_analyzer[cpu]->access(addr, ip, type);
+
+  if (ooo_cpu[cpu].oracle_lookahead)
+  {
+    // the oracle stands in for the compiled-in prefetcher
+    if (type == LOAD)
+      oracle_prefetch(v_addr, addr, ip);
+    return;
+  }
+
+  if (SUPPORT_VA)
+    l1d_prefetcher_operate(v_addr, addr, ip, cache_hit, type);
+  else
+    l1d_prefetcher_operate(addr, ip, cache_hit, type);
+}
+
+void CACHE::l1d_prefetcher_notify_fill(uint64_t addr, uint32_t set, uint32_t way, uint8_t prefetch, uint64_t evicted_addr, uint32_t metadata_in)
+{
+  if (l1d_capture[cpu] && !functional_warming)
+    capture_l1d_fill(cpu, addr, prefetch, evicted_addr);
+  if (region_analyzer[cpu] && !functional_warming && block[set][way].valid)
+    region_analyzer[cpu]->eviction(evicted_addr);
+
+  // the oracle stands in for the compiled-in prefetcher, which must not train on its fills
+  if (ooo_cpu[cpu].oracle_lookahead)
+    return;
+  l1d_prefetcher_cache_fill(addr, set, way, prefetch, evicted_addr, metadata_in);
+}
+
+/**
+ * @brief Upper-bound mode of a perfect cache: the missing block is installed
+ * right away, as if it had always been there, so the access takes the hit path
+ * at this level's latency. Nothing is requested from or written back to the
+ * levels below; a dirty victim is simply dropped.
+ */
+int CACHE::perfect_fill(PACKET *packet)
+{
+  uint32_t set = get_set(packet->address), way;
+  if (cache_type == IS_LLC)
+    way = llc_find_victim(packet->cpu, packet->instr_id, set, block[set], packet->ip, packet->full_addr, packet->type);
+  else
+    way = find_victim(packet->cpu, packet->instr_id, set, block[set], packet->ip, packet->full_addr, packet->type);
+  if (way == NUM_WAY)
+    return -1; // the policy bypasses the block, treat it as a normal miss
+
+  if (cache_type == IS_LLC)
+    llc_update_replacement_state(packet->cpu, set, way, packet->full_addr, packet->ip, block[set][way].full_addr, packet->type, 0);
+  else
+    update_replacement_state(packet->cpu, set, way, packet->full_addr, packet->ip, block[set][way].full_addr, packet->type, 0);
+
+  fill_cache(set, way, packet);
+  return way;
+}
+
+/**
+ * @brief Oracle L1D prefetcher: every demand load prefetches the blocks of its
+ * page that the next -oracle_l1d trace instructions will touch. The requests go
+ * through prefetch_line like any prefetcher's, so PQ size, MSHRs and memory
+ * latency still decide whether they arrive in time.
+ */
+void CACHE::oracle_prefetch(uint64_t v_addr, uint64_t addr, uint64_t ip)
+{
+  const int blocks = PAGE_SIZE / BLOCK_SIZE;
+  int trigger = (addr >> LOG2_BLOCK_SIZE) & (blocks - 1);
+  uint64_t page = (addr >> LOG2_PAGE_SIZE) << LOG2_PAGE_SIZE;
+  uint64_t footprint = ooo_cpu[cpu].future_footprint(v_addr) & ~(1ull << trigger);
+
+  // nearest blocks first, a full PQ cuts off the far end of the footprint
+  for (int distance = 1; footprint && distance < blocks && PQ.occupancy < PQ.SIZE; distance++)
+  {
+    int offsets[2] = {trigger + distance, trigger - distance};
+    for (int offset : offsets)
+    {
+      if (offset < 0 || offset >= blocks || !((footprint >> offset) & 1))
+        continue;
+      prefetch_line(ip, addr, page | ((uint64_t)offset << LOG2_BLOCK_SIZE), FILL_L1, 0);
+      footprint &= ~(1ull << offset);
+    }
+  }
+}
+
+CACHE *CACHE::warm_lower()
+{
+  // the LLC sits on DRAM and the STLB walks the page table, neither has a CACHE below
+  if (cache_type == IS_LLC || cache_type == IS_STLB)
+    return NULL;
+  return (CACHE *)lower_level;
+}
+
+/**
+ * @brief Functional access used while fast-forwarding the warmup: a miss is
+ * fetched from the levels below, filled and written back at once, and the
+ * replacement policy and prefetchers see the same calls as in handle_read,
+ * handle_prefetch and handle_fill. Queues, MSHRs and cycles are not touched.
+ *
+ * @return the data of the block, which is the physical page for TLBs
+ */
+uint64_t CACHE::warm_access(PACKET *packet)
+{
+  uint32_t warm_cpu = packet->cpu;
+  uint32_t set = get_set(packet->address), way = get_way(packet->address, set);
+  uint8_t hit = (way < NUM_WAY), was_prefetch = hit ? block[set][way].prefetch : 0;
+#ifdef FULL_ADDR
+  uint64_t hook_addr = packet->full_addr;
+#else
+  uint64_t hook_addr = packet->address << LOG2_BLOCK_SIZE;
+#endif
+
+  if (mrc)
+    mrc->access(packet->address, packet->type);
+  if (shadow)
+    shadow->access(get_set(packet->address), *packet);
+
+  if (hit)
+  {
+    if (cache_type == IS_LLC)
+      llc_update_replacement_state(warm_cpu, set, way, block[set][way].full_addr, packet->ip, 0, packet->type, 1);
+    else
+      update_replacement_state(warm_cpu, set, way, block[set][way].full_addr, packet->ip, 0, packet->type, 1);
+
+    if (packet->type == WRITEBACK || (cache_type == IS_L1D && packet->type == RFO))
+      block[set][way].dirty = 1;
+    if (packet->type != PREFETCH && packet->type != WRITEBACK)
+    {
+      if (block[set][way].prefetch)
+      {
+        pf_useful++;
+        pf_useful_epoch++;
+        block[set][way].prefetch = 0;
+      }
+      block[set][way].used = 1;
+    }
+  }
+  else
+  {
+    PACKET fill_packet = *packet;
+    if (packet->type != WRITEBACK)
+    {
+      // a writeback allocates without reading, everything else comes from below first
+      if (CACHE *lower = warm_lower())
+        fill_packet.data = lower->warm_access(packet);
+      else if (cache_type == IS_STLB)
+        fill_packet.data = va_to_pa(warm_cpu, packet->instr_id, packet->full_addr, packet->address, 0) >> LOG2_PAGE_SIZE;
+    }
+
+    if (cache_type == IS_LLC)
+      way = llc_find_victim(warm_cpu, packet->instr_id, set, block[set], packet->ip, packet->full_addr, packet->type);
+    else
+      way = find_victim(warm_cpu, packet->instr_id, set, block[set], packet->ip, packet->full_addr, packet->type);
+    if (way == NUM_WAY)
+      return fill_packet.data; // bypassed
+
+    if (block[set][way].dirty && warm_lower())
+    {
+      PACKET writeback_packet;
+      writeback_packet.fill_level = fill_level << 1;
+      writeback_packet.cpu = warm_cpu;
+      writeback_packet.address = block[set][way].address;
+      writeback_packet.full_addr = block[set][way].full_addr;
+      writeback_packet.data = block[set][way].data;
+      writeback_packet.type = WRITEBACK;
+      warm_lower()->warm_access(&writeback_packet);
+    }
+
+    uint8_t prefetch = (packet->type == PREFETCH) ? 1 : 0;
+    if (cache_type == IS_L1I)
+      l1i_prefetcher_cache_fill(warm_cpu, ((packet->ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE, set, way, prefetch, ((block[set][way].ip) >> LOG2_BLOCK_SIZE) << LOG2_BLOCK_SIZE);
+    if (cache_type == IS_L1D)
+      l1d_prefetcher_notify_fill(packet->full_addr, set, way, prefetch, block[set][way].address << LOG2_BLOCK_SIZE, packet->pf_metadata);
+#ifdef FULL_ADDR
+    uint64_t evicted_addr = block[set][way].full_addr;
+#else
+    uint64_t evicted_addr = block[set][way].address << LOG2_BLOCK_SIZE;
+#endif
+    if (cache_type == IS_L2C)
+      fill_packet.pf_metadata = l2c_prefetcher_cache_fill(hook_addr, set, way, prefetch, evicted_addr, packet->pf_metadata);
+    if (cache_type == IS_LLC)
+    {
+      cpu = warm_cpu;
+      fill_packet.pf_metadata = llc_prefetcher_cache_fill(hook_addr, set, way, prefetch, evicted_addr, packet->pf_metadata);
+      cpu = 0;
+    }
+
+    if (cache_type == IS_LLC)
+      llc_update_replacement_state(warm_cpu, set, way, packet->full_addr, packet->ip, block[set][way].full_addr, packet->type, 0);
+    else
+      update_replacement_state(warm_cpu, set, way, packet->full_addr, packet->ip, block[set][way].full_addr, packet->type, 0);
+
+    fill_cache(set, way, &fill_packet);
+    if (packet->type == WRITEBACK || (cache_type == IS_L1D && packet->type == RFO))
+      block[set][way].dirty = 1;
+  }
+
+  // train the prefetchers after the fill so their first prefetches don't race the demand line
+  if (packet->type == LOAD || (packet->type == PREFETCH && packet->pf_origin_level < fill_level))
+  {
+    if (cache_type == IS_L1I && packet->type == LOAD)
+      l1i_prefetcher_cache_operate(warm_cpu, packet->ip, hit, was_prefetch);
+    else if (cache_type == IS_L1D && packet->type == LOAD)
+      l1d_prefetcher_notify(packet->v_full_addr, packet->full_addr, packet->ip, hit, packet->type);
+    else if (cache_type == IS_L2C)
+      l2c_prefetcher_operate(hook_addr, packet->ip, hit, packet->type, packet->pf_metadata);
+    else if (cache_type == IS_LLC)
+    {
+      cpu = warm_cpu;
+      llc_prefetcher_operate(hook_addr, packet->ip, hit, packet->type, packet->pf_metadata);
+      cpu = 0;
+    }
+  }
+
+  return block[set][way].data;
+}
+
 int CACHE::kpc_prefetch_line(uint64_t base_addr, uint64_t pf_addr, int pf_fill_level, int delta, int depth, int signature, int confidence, uint32_t prefetch_metadata)
 {
   if (PQ.occupancy < PQ.SIZE)
@@ -2944,6 +3281,12 @@ int CACHE::add_pq(PACKET *packet)
   }
 #endif
 
+  // sample the prefetches of this cache's prefetcher
+  if (latency_trace.enabled && (packet->pf_origin_level == fill_level) && (cache_type == IS_L1D || cache_type == IS_L2C || cache_type == IS_LLC))
+    packet->trace_id = latency_trace.sample(*packet, cache_type, current_core_cycle[packet->cpu]);
+  if (packet->trace_id)
+    latency_trace.begin(packet->trace_id, cache_type, LatencyTrace::PQ, current_core_cycle[packet->cpu]);
+
   PQ.entry[index] = *packet;
 
   // ADD LATENCY
@@ -2971,6 +3314,11 @@ int CACHE::add_pq(PACKET *packet)
   PQ.TO_CACHE++;
   PQ.ACCESS++;
 
+  if (mrc)
+    mrc->access(packet->address, packet->type);
+  if (shadow)
+    shadow->access(get_set(packet->address), *packet);
+
   return -1;
 }
 
@@ -3000,6 +3348,8 @@ void CACHE::return_data(PACKET *packet)
   MSHR.entry[mshr_index].returned = COMPLETED;
   MSHR.entry[mshr_index].data = packet->data;
   MSHR.entry[mshr_index].pf_metadata = packet->pf_metadata;
+  if (MSHR.entry[mshr_index].trace_id)
+    latency_trace.begin(MSHR.entry[mshr_index].trace_id, cache_type, LatencyTrace::FILL, current_core_cycle[packet->cpu]);
 
   // ADD LATENCY
   if (MSHR.entry[mshr_index].event_cycle < current_core_cycle[packet->cpu])
@@ -3120,6 +3470,8 @@ void CACHE::add_mshr(PACKET *packet)
   uint32_t index = 0;
 
   packet->cycle_enqueued = current_core_cycle[packet->cpu];
+  if (knob::filter_prefetch)
+    pf_filter.record(packet->address, packet->fill_level, current_core_cycle[packet->cpu]);
 
   // search mshr
   for (index = 0; index < MSHR_SIZE; index++)
@@ -3129,6 +3481,8 @@ void CACHE::add_mshr(PACKET *packet)
 
       MSHR.entry[index] = *packet;
       MSHR.entry[index].returned = INFLIGHT;
+      if (packet->trace_id)
+        latency_trace.begin(packet->trace_id, cache_type, LatencyTrace::MSHR, current_core_cycle[packet->cpu]);
       MSHR.occupancy++;
 
       DP(if (warmup_complete[packet->cpu])
@@ -3231,17 +3585,15 @@ void CACHE::broadcast_bw(uint8_t bw_level)
     this->cur_bw_level = bw_level;
     switch(cache_type)
     {
-        // case IS_L1I:
-        //     break;
-        // case IS_L1D:
-        //     l1d_prefetcher_broadcast_bw(bw_level);
-        //     break;
-        // case IS_L2C:
-        //     l2c_prefetcher_broadcast_bw(bw_level);
-        //     break;
-        // case IS_LLC:
-        //     llc_prefetcher_broadcast_bw(bw_level);
-        //     break;
+        case IS_L1D:
+            l1d_prefetcher_broadcast_bw(bw_level);
+            break;
+        case IS_L2C:
+            l2c_prefetcher_broadcast_bw(bw_level);
+            break;
+        case IS_LLC:
+            llc_prefetcher_broadcast_bw(bw_level);
+            break;
     }
 
     /* recursively broadcast to higher caches */
@@ -3307,7 +3659,7 @@ void CACHE::handle_prefetch_feedback()
         }
         uint32_t this_epoch_overp = total_load_miss != last_total_load_miss ? 100*(pf_useless - last_period_useless)/(total_load_miss - last_total_load_miss) : 0;
         pref_overp = (pref_overp + this_epoch_overp)/2;
-        this->overprediction_level = (pref_overp/(float)100/CACHE_ACC_LEVELS);
+        this->overprediction_level = pref_overp / ((float)100/CACHE_ACC_LEVELS); // same buckets as the accuracy
         if (this->overprediction_level >= CACHE_ACC_LEVELS)
           this->overprediction_level = CACHE_ACC_LEVELS - 1;
 
@@ -3315,3 +3667,62 @@ void CACHE::handle_prefetch_feedback()
         last_period_useless = pf_useless;
     }
 }
+
+void CACHE_ROI_STATS::add(const CACHE_ROI_STATS &begin, const CACHE_ROI_STATS &end)
+{
+  for (uint32_t i = 0; i < NUM_TYPES; i++)
+  {
+    access[i] += end.access[i] - begin.access[i];
+    hit[i] += end.hit[i] - begin.hit[i];
+    miss[i] += end.miss[i] - begin.miss[i];
+    miss_latency[i] += end.miss_latency[i] - begin.miss_latency[i];
+  }
+  pf_requested += end.pf_requested - begin.pf_requested;
+  pf_issued += end.pf_issued - begin.pf_issued;
+  pf_useful += end.pf_useful - begin.pf_useful;
+  pf_useless += end.pf_useless - begin.pf_useless;
+  pf_late += end.pf_late - begin.pf_late;
+  pf_fill += end.pf_fill - begin.pf_fill;
+  for (int i = 0; i < PrefetchFilter::DROP_TYPES; i++)
+    pf_dropped[i] += end.pf_dropped[i] - begin.pf_dropped[i];
+  total_miss_latency += end.total_miss_latency - begin.total_miss_latency;
+}
+
+CACHE_ROI_STATS CACHE::live_stats(uint32_t cpu)
+{
+  CACHE_ROI_STATS stats = roi_stats(cpu);
+  for (uint32_t i = 0; i < NUM_TYPES; i++)
+  {
+    stats.access[i] = sim_access[cpu][i];
+    stats.hit[i] = sim_hit[cpu][i];
+    stats.miss[i] = sim_miss[cpu][i];
+  }
+  return stats;
+}
+
+CACHE_ROI_STATS CACHE::roi_stats(uint32_t cpu)
+{
+  CACHE_ROI_STATS stats;
+  for (uint32_t i = 0; i < NUM_TYPES; i++)
+  {
+    stats.access[i] = roi_access[cpu][i];
+    stats.hit[i] = roi_hit[cpu][i];
+    stats.miss[i] = roi_miss[cpu][i];
+    stats.miss_latency[i] = miss_latency[cpu][i];
+  }
+  stats.pf_requested = pf_requested;
+  stats.pf_issued = pf_issued;
+  stats.pf_useful = pf_useful;
+  stats.pf_useless = pf_useless;
+  stats.pf_late = pf_late;
+  stats.pf_fill = pf_fill;
+  for (int i = 0; i < PrefetchFilter::DROP_TYPES; i++)
+    stats.pf_dropped[i] = pf_filter.dropped[i];
+  stats.total_miss_latency = total_miss_latency;
+  return stats;
+}
+
+bool CACHE::drained()
+{
+  return (RQ.occupancy == 0) && (PQ.occupancy == 0) && (MSHR.occupancy == 0);
+}
@@ -88,7 +88,7 @@ count_bits(const vector<bool> &x)
 double 
 jaccard_similarity(vector<bool> pattern1, vector<bool> pattern2) 
 {
-    int a = pattern_to_int(pattern1), b = pattern_to_int(pattern2);
+    uint64_t a = pattern_to_int(pattern1), b = pattern_to_int(pattern2);
     return double(count_bits(a & b)) / double(count_bits(a | b));
 }
 
@@ -1,4 +1,5 @@
 #include "dram_controller.h"
+#include "latency_trace.h"
 
 // initialized in main.cc
 uint32_t DRAM_MTPS, DRAM_DBUS_RETURN_TIME, DRAM_DBUS_MAX_CAS,
@@ -20,12 +21,23 @@ void MEMORY_CONTROLLER::reset_remain_requests(PACKET_QUEUE *queue, uint32_t chan
             //uint32_t op_column = dram_get_column(op_addr);
 #endif
 
-            // update open row
-            if ((bank_request[op_channel][op_rank][op_bank].cycle_available - tCAS) <= current_core_cycle[op_cpu])
+            // update open row; with the timing model the commands it has not issued yet are taken back,
+            // and the row is open once its activate was issued
+            bool row_open;
+            if (timing.enabled)
+                row_open = timing.cancel(op_channel, op_rank, op_bank, current_core_cycle[0]);
+            else
+                row_open = (bank_request[op_channel][op_rank][op_bank].cycle_available - tCAS) <= current_core_cycle[op_cpu];
+            if (row_open)
                 bank_request[op_channel][op_rank][op_bank].open_row = op_row;
             else
                 bank_request[op_channel][op_rank][op_bank].open_row = UINT32_MAX;
 
+            // the request goes back to the queue, only its time on the bank counts
+            DRAM_BANK_STATS &stats = bank_stats[op_channel][op_rank][op_bank];
+            if (bank_request[op_channel][op_rank][op_bank].working && current_core_cycle[op_cpu] > stats.scheduled_cycle)
+                stats.busy_cycles += current_core_cycle[op_cpu] - stats.scheduled_cycle;
+
             // this bank is ready for another DRAM request
             bank_request[op_channel][op_rank][op_bank].request_index = -1;
             bank_request[op_channel][op_rank][op_bank].row_buffer_hit = 0;
@@ -42,6 +54,10 @@ void MEMORY_CONTROLLER::reset_remain_requests(PACKET_QUEUE *queue, uint32_t chan
 
             queue->entry[i].scheduled = 0;
             queue->entry[i].event_cycle = current_core_cycle[op_cpu];
+            if (queue->entry[i].trace_id) {
+                latency_trace.end(queue->entry[i].trace_id, LATENCY_TRACE_DRAM, LatencyTrace::DRAM_ACCESS, current_core_cycle[op_cpu]);
+                latency_trace.begin(queue->entry[i].trace_id, LATENCY_TRACE_DRAM, LatencyTrace::DRAM_QUEUE, current_core_cycle[op_cpu]);
+            }
 
             DP ( if (warmup_complete[op_cpu]) {
             cout << queue->NAME << " instr_id: " << queue->entry[i].instr_id << " swrites: " << scheduled_writes[channel] << " sreads: " << scheduled_reads[channel] << endl; });
@@ -68,10 +84,29 @@ void MEMORY_CONTROLLER::reset_remain_requests(PACKET_QUEUE *queue, uint32_t chan
 
 void MEMORY_CONTROLLER::operate()
 {
+    while (ideal_returns.size() && (ideal_returns.front().event_cycle <= current_core_cycle[ideal_returns.front().cpu])) {
+        PACKET &ideal = ideal_returns.front();
+        upper_level_dcache[ideal.cpu]->return_data(&ideal);
+
+        // an ideal read is a row miss with no queueing, count it like one
+        uint32_t channel = dram_get_channel(ideal.address);
+        DRAM_BANK_STATS &stats = bank_stats[channel][dram_get_rank(ideal.address)][dram_get_bank(ideal.address)];
+        RQ[channel].ROW_BUFFER_MISS++;
+        stats.reads++;
+        stats.busy_cycles += tRP + tRCD + tCAS;
+        write_drain_stats[channel].reads++;
+        write_drain_stats[channel].read_latency += tRP + tRCD + tCAS + DRAM_DBUS_RETURN_TIME;
+        ideal_returns.pop_front();
+    }
+
     for (uint32_t i=0; i<DRAM_CHANNELS; i++) {
+        if (timing.enabled)
+            refresh(i);
+
+        bool row_hits_only = false;
         //if ((write_mode[i] == 0) && (WQ[i].occupancy >= DRAM_WRITE_HIGH_WM)) {
-      if ((write_mode[i] == 0) && ((WQ[i].occupancy >= DRAM_WRITE_HIGH_WM) || ((RQ[i].occupancy == 0) && (WQ[i].occupancy > 0)))) { // use idle cycles to perform writes
-            write_mode[i] = 1;
+      if ((write_mode[i] == 0) && ((WQ[i].occupancy >= write_high_wm) || ((write_drain != DRAIN_WATERMARK) && (RQ[i].occupancy == 0) && (WQ[i].occupancy > 0)))) { // use idle cycles to perform writes
+            switch_write_mode(i, 1);
 
             // reset scheduled RQ requests
             reset_remain_requests(&RQ[i], i);
@@ -80,9 +115,18 @@ void MEMORY_CONTROLLER::operate()
         } else if (write_mode[i]) {
 
             if (WQ[i].occupancy == 0)
-                write_mode[i] = 0;
-            else if (RQ[i].occupancy && (WQ[i].occupancy < DRAM_WRITE_LOW_WM))
-                write_mode[i] = 0;
+                switch_write_mode(i, 0);
+            else if (RQ[i].occupancy && (drain_writes[i] >= min_writes_per_switch)) {
+                if (WQ[i].occupancy < write_low_wm)
+                    switch_write_mode(i, 0);
+                // reads are waiting: only the writes to an open row are still worth scheduling, the
+                // drain ends once those and the writes in flight are done, the rest wait for the next
+                else if ((write_drain == DRAIN_ROW_HIT) && (WQ[i].occupancy < write_high_wm)) {
+                    row_hits_only = true;
+                    if ((scheduled_writes[i] == 0) && !has_row_hit(&WQ[i]))
+                        switch_write_mode(i, 0);
+                }
+            }
 
             if (write_mode[i] == 0) {
                 // reset scheduled WQ requests
@@ -96,7 +140,7 @@ void MEMORY_CONTROLLER::operate()
         // schedule new entry
         if (write_mode[i] && (WQ[i].next_schedule_index < WQ[i].SIZE)) {
             if (WQ[i].next_schedule_cycle <= current_core_cycle[WQ[i].entry[WQ[i].next_schedule_index].cpu])
-                schedule(&WQ[i]);
+                schedule(&WQ[i], row_hits_only);
         }
 
         // process DRAM requests
@@ -120,7 +164,65 @@ void MEMORY_CONTROLLER::operate()
     }
 }
 
-void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
+void MEMORY_CONTROLLER::refresh(uint32_t channel)
+{
+    for (uint32_t j=0; j<DRAM_RANKS; j++) {
+        if (!timing.refresh_due(channel, j, current_core_cycle[0]))
+            continue;
+
+        // the refresh waits for the requests in flight, then closes every row of the rank
+        uint64_t start = current_core_cycle[0];
+        for (uint32_t k=0; k<DRAM_BANKS; k++) {
+            if (bank_request[channel][j][k].working)
+                start = max(start, bank_request[channel][j][k].cycle_available);
+            bank_request[channel][j][k].open_row = UINT32_MAX;
+        }
+        timing.refresh(channel, j, start);
+    }
+}
+
+void MEMORY_CONTROLLER::switch_write_mode(uint32_t channel, uint8_t mode)
+{
+    uint64_t cycle = current_core_cycle[0];
+    write_mode[channel] = mode;
+    if (mode) {
+        write_mode_begin[channel] = cycle;
+        drain_writes[channel] = 0;
+        return;
+    }
+
+    write_mode_cycles[channel] += cycle - write_mode_begin[channel];
+    write_drain_stats[channel].drains++;
+    write_drain_stats[channel].drain_writes += drain_writes[channel];
+    write_drain_stats[channel].drain_cycles += cycle - write_mode_begin[channel];
+}
+
+uint64_t MEMORY_CONTROLLER::get_write_mode_cycles(uint32_t channel)
+{
+    if (write_mode[channel])
+        return write_mode_cycles[channel] + current_core_cycle[0] - write_mode_begin[channel];
+    return write_mode_cycles[channel];
+}
+
+bool MEMORY_CONTROLLER::has_row_hit(PACKET_QUEUE *queue)
+{
+    for (uint32_t i=0; i<queue->SIZE; i++) {
+        uint64_t addr = queue->entry[i].address;
+        if (queue->entry[i].scheduled || (addr == 0))
+            continue;
+        if (bank_request[dram_get_channel(addr)][dram_get_rank(addr)][dram_get_bank(addr)].open_row == dram_get_row(addr))
+            return true;
+    }
+    return false;
+}
+
+void MEMORY_CONTROLLER::reset_write_drain_stats()
+{
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++)
+        write_drain_stats[i] = DRAM_WRITE_DRAIN_STATS();
+}
+
+void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue, bool row_hits_only)
 {
     uint64_t read_addr;
     uint32_t read_channel, read_rank, read_bank, read_row;
@@ -182,6 +284,10 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
         }	  
     }
 
+    // a rowhit drain winding down leaves the row misses for the next drain
+    if ((oldest_index == -1) && row_hits_only)
+        return;
+
     if (oldest_index == -1) { // no matching open_row (row buffer miss)
 
         oldest_cycle = UINT64_MAX;
@@ -217,12 +323,6 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
     // at this point, the scheduler knows which bank to access and if the request is a row buffer hit or miss
     if (oldest_index != -1) { // scheduler might not find anything if all requests are already scheduled or all banks are busy
 
-        uint64_t LATENCY = 0;
-        if (row_buffer_hit)  
-            LATENCY = tCAS;
-        else 
-            LATENCY = tRP + tRCD + tCAS;
-
         uint64_t op_addr = queue->entry[oldest_index].address;
         uint32_t op_cpu = queue->entry[oldest_index].cpu,
                  op_channel = dram_get_channel(op_addr), 
@@ -233,6 +333,16 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
         uint32_t op_column = dram_get_column(op_addr);
 #endif
 
+        uint64_t LATENCY = 0;
+        if (timing.enabled)
+            LATENCY = timing.issue(op_channel, op_rank, op_bank, row_buffer_hit,
+                                   bank_request[op_channel][op_rank][op_bank].open_row != UINT32_MAX, queue->is_WQ,
+                                   current_core_cycle[0]) - current_core_cycle[0];
+        else if (row_buffer_hit)  
+            LATENCY = tCAS;
+        else 
+            LATENCY = tRP + tRCD + tCAS;
+
         // this bank is now busy
         bank_request[op_channel][op_rank][op_bank].working = 1;
         bank_request[op_channel][op_rank][op_bank].working_type = queue->entry[oldest_index].type;
@@ -253,8 +363,13 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
 
         // update open row
         bank_request[op_channel][op_rank][op_bank].open_row = op_row;
+        bank_stats[op_channel][op_rank][op_bank].scheduled_cycle = current_core_cycle[op_cpu];
 
         queue->entry[oldest_index].scheduled = 1;
+        if (queue->entry[oldest_index].trace_id) {
+            latency_trace.end(queue->entry[oldest_index].trace_id, LATENCY_TRACE_DRAM, LatencyTrace::DRAM_QUEUE, current_core_cycle[op_cpu]);
+            latency_trace.begin(queue->entry[oldest_index].trace_id, LATENCY_TRACE_DRAM, LatencyTrace::DRAM_ACCESS, current_core_cycle[op_cpu]);
+        }
         queue->entry[oldest_index].event_cycle = current_core_cycle[op_cpu] + LATENCY;
 
         update_schedule_cycle(queue);
@@ -271,6 +386,33 @@ void MEMORY_CONTROLLER::schedule(PACKET_QUEUE *queue)
     }
 }
 
+void MEMORY_CONTROLLER::count_bank_request(uint32_t channel, uint32_t rank, uint32_t bank, bool write, uint64_t cycle)
+{
+    DRAM_BANK_STATS &stats = bank_stats[channel][rank][bank];
+    if (write)
+        stats.writes++;
+    else
+        stats.reads++;
+    if (bank_request[channel][rank][bank].row_buffer_hit)
+        stats.row_buffer_hits++;
+    if (cycle > stats.scheduled_cycle)
+        stats.busy_cycles += cycle - stats.scheduled_cycle;
+}
+
+void MEMORY_CONTROLLER::reset_bank_stats(uint64_t cycle)
+{
+    for (uint32_t i=0; i<DRAM_CHANNELS; i++)
+        for (uint32_t j=0; j<DRAM_RANKS; j++)
+            for (uint32_t k=0; k<DRAM_BANKS; k++) {
+                DRAM_BANK_STATS &stats = bank_stats[i][j][k];
+                // a request in flight counts from here on
+                uint64_t scheduled_cycle = max(stats.scheduled_cycle, cycle);
+                stats = DRAM_BANK_STATS();
+                stats.scheduled_cycle = scheduled_cycle;
+            }
+    bank_stats_begin_cycle = cycle;
+}
+
 void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
 {
     uint32_t request_index = queue->next_process_index;
@@ -309,6 +451,8 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
                     queue->ROW_BUFFER_HIT++;
                 else
                     queue->ROW_BUFFER_MISS++;
+                count_bank_request(op_channel, op_rank, op_bank, true, current_core_cycle[op_cpu]);
+                drain_writes[op_channel]++;
 
                 // this bank is ready for another DRAM request
                 bank_request[op_channel][op_rank][op_bank].request_index = -1;
@@ -330,6 +474,9 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
                 cout << " row: " << op_row << " column: " << op_column;
                 cout << " current_cycle: " << current_core_cycle[op_cpu] << " event_cycle: " << queue->entry[request_index].event_cycle << endl; });
 
+                if (queue->entry[request_index].trace_id)
+                    latency_trace.end(queue->entry[request_index].trace_id, LATENCY_TRACE_DRAM, LatencyTrace::DRAM_ACCESS, current_core_cycle[op_cpu]);
+
                 // send data back to the core cache hierarchy
                 upper_level_dcache[op_cpu]->return_data(&queue->entry[request_index]);
 
@@ -337,6 +484,16 @@ void MEMORY_CONTROLLER::process(PACKET_QUEUE *queue)
                     queue->ROW_BUFFER_HIT++;
                 else
                     queue->ROW_BUFFER_MISS++;
+                count_bank_request(op_channel, op_rank, op_bank, false, current_core_cycle[op_cpu]);
+
+                DRAM_WRITE_DRAIN_STATS &drain = write_drain_stats[op_channel];
+                uint64_t inflation = get_write_mode_cycles(op_channel) - rq_arrival_write_mode_cycles[op_channel][request_index];
+                drain.reads++;
+                drain.read_latency += current_core_cycle[op_cpu] - rq_arrival[op_channel][request_index];
+                if (inflation) {
+                    drain.reads_inflated++;
+                    drain.read_inflation += inflation;
+                }
 
                 // this bank is ready for another DRAM request
                 bank_request[op_channel][op_rank][op_bank].request_index = -1;
@@ -425,6 +582,14 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
         return -1;
     }
 
+    // infinite bandwidth: no queueing, bank or bus conflicts, every read takes
+    // the unloaded row-miss latency plus one burst
+    if (knob_infinite_dram_bw) {
+        packet->event_cycle = current_core_cycle[packet->cpu] + tRP + tRCD + tCAS + DRAM_DBUS_RETURN_TIME;
+        ideal_returns.push_back(*packet);
+        return -1;
+    }
+
     // check for the latest wirtebacks in the write queue
     uint32_t channel = dram_get_channel(packet->address);
     int wq_index = check_dram_queue(&WQ[channel], packet);
@@ -449,6 +614,8 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
 
         WQ[channel].FORWARD++;
         RQ[channel].ACCESS++;
+        write_drain_stats[channel].reads++;
+        write_drain_stats[channel].forwarded_reads++;
         //assert(0);
 
         return -1;
@@ -466,6 +633,10 @@ int MEMORY_CONTROLLER::add_rq(PACKET *packet)
             RQ[channel].entry[index] = *packet;
             RQ[channel].occupancy++;
             rq_enqueue_count++;
+            rq_arrival[channel][index] = current_core_cycle[packet->cpu];
+            if (packet->trace_id)
+                latency_trace.begin(packet->trace_id, LATENCY_TRACE_DRAM, LatencyTrace::DRAM_QUEUE, current_core_cycle[packet->cpu]);
+            rq_arrival_write_mode_cycles[channel][index] = get_write_mode_cycles(channel);
 #ifdef DEBUG_PRINT
             uint32_t channel = dram_get_channel(packet->address),
                      rank = dram_get_rank(packet->address),
@@ -495,6 +666,14 @@ int MEMORY_CONTROLLER::add_wq(PACKET *packet)
     if (all_warmup_complete < NUM_CPUS)
         return -1;
 
+    // infinite bandwidth: the write is absorbed at once, only the stats see it
+    if (knob_infinite_dram_bw) {
+        uint32_t channel = dram_get_channel(packet->address);
+        WQ[channel].ROW_BUFFER_MISS++;
+        bank_stats[channel][dram_get_rank(packet->address)][dram_get_bank(packet->address)].writes++;
+        return -1;
+    }
+
     // check for duplicates in the write queue
     uint32_t channel = dram_get_channel(packet->address);
     int index = check_dram_queue(&WQ[channel], packet);
@@ -632,7 +811,7 @@ uint32_t MEMORY_CONTROLLER::dram_get_channel(uint64_t address)
 
     int shift = 0;
 
-    return (uint32_t) (address >> shift) & (DRAM_CHANNELS - 1);
+    return (uint32_t) (mapping.map(address) >> shift) & (DRAM_CHANNELS - 1);
 }
 
 uint32_t MEMORY_CONTROLLER::dram_get_bank(uint64_t address)
@@ -642,7 +821,7 @@ uint32_t MEMORY_CONTROLLER::dram_get_bank(uint64_t address)
 
     int shift = LOG2_DRAM_CHANNELS;
 
-    return (uint32_t) (address >> shift) & (DRAM_BANKS - 1);
+    return (uint32_t) (mapping.map(address) >> shift) & (DRAM_BANKS - 1);
 }
 
 uint32_t MEMORY_CONTROLLER::dram_get_column(uint64_t address)
@@ -652,7 +831,7 @@ uint32_t MEMORY_CONTROLLER::dram_get_column(uint64_t address)
 
     int shift = LOG2_DRAM_BANKS + LOG2_DRAM_CHANNELS;
 
-    return (uint32_t) (address >> shift) & (DRAM_COLUMNS - 1);
+    return (uint32_t) (mapping.map(address) >> shift) & (DRAM_COLUMNS - 1);
 }
 
 uint32_t MEMORY_CONTROLLER::dram_get_rank(uint64_t address)
@@ -662,7 +841,7 @@ uint32_t MEMORY_CONTROLLER::dram_get_rank(uint64_t address)
 
     int shift = LOG2_DRAM_COLUMNS + LOG2_DRAM_BANKS + LOG2_DRAM_CHANNELS;
 
-    return (uint32_t) (address >> shift) & (DRAM_RANKS - 1);
+    return (uint32_t) (mapping.map(address) >> shift) & (DRAM_RANKS - 1);
 }
 
 uint32_t MEMORY_CONTROLLER::dram_get_row(uint64_t address)
@@ -672,7 +851,7 @@ uint32_t MEMORY_CONTROLLER::dram_get_row(uint64_t address)
 
     int shift = LOG2_DRAM_RANKS + LOG2_DRAM_COLUMNS + LOG2_DRAM_BANKS + LOG2_DRAM_CHANNELS;
 
-    return (uint32_t) (address >> shift) & (DRAM_ROWS - 1);
+    return (uint32_t) (mapping.map(address) >> shift) & (DRAM_ROWS - 1);
 }
 
 uint32_t MEMORY_CONTROLLER::get_occupancy(uint8_t queue_type, uint64_t address)
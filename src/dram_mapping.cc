@@ -0,0 +1,66 @@
+#include "dram_mapping.h"
+
+#define DRAM_ADDRESS_BITS (LOG2_DRAM_CHANNELS + LOG2_DRAM_RANKS + LOG2_DRAM_BANKS + LOG2_DRAM_ROWS + LOG2_DRAM_COLUMNS)
+
+bool DRAMMapping::configure(const string &mapping, const string &interleave)
+{
+    if ((mapping != "bitslice" && mapping != "xor") || (interleave != "line" && interleave != "row"))
+        return false;
+    this->mapping = mapping;
+    this->interleave = interleave;
+    identity = mapping == "bitslice" && interleave == "line";
+    table.clear();
+    if (identity)
+        return true;
+
+    // where each field starts in the coordinates, the line interleaved layout
+    const int channel = 0, bank = channel + LOG2_DRAM_CHANNELS, column = bank + LOG2_DRAM_BANKS,
+              rank = column + LOG2_DRAM_COLUMNS, row = rank + LOG2_DRAM_RANKS;
+
+    // and in the address
+    int address_channel = channel, address_bank = bank, address_column = column;
+    if (interleave == "row")
+    {
+        address_column = 0;
+        address_channel = LOG2_DRAM_COLUMNS;
+        address_bank = address_channel + LOG2_DRAM_CHANNELS;
+    }
+
+    // the address bits each coordinate bit is the XOR of
+    vector<uint64_t> sources(DRAM_ADDRESS_BITS, 0);
+    for (int i = 0; i < LOG2_DRAM_CHANNELS; i++)
+        sources[channel + i] = 1ULL << (address_channel + i);
+    for (int i = 0; i < LOG2_DRAM_BANKS; i++)
+        sources[bank + i] = 1ULL << (address_bank + i);
+    for (int i = 0; i < LOG2_DRAM_COLUMNS; i++)
+        sources[column + i] = 1ULL << (address_column + i);
+    for (int i = 0; i < LOG2_DRAM_RANKS; i++)
+        sources[rank + i] = 1ULL << (rank + i);
+    for (int i = 0; i < LOG2_DRAM_ROWS; i++)
+        sources[row + i] = 1ULL << (row + i);
+
+    if (mapping == "xor")
+    {
+        // bank, then rank, then channel bits take successive low row bits
+        assert(LOG2_DRAM_BANKS + LOG2_DRAM_RANKS + LOG2_DRAM_CHANNELS <= LOG2_DRAM_ROWS);
+        for (int i = 0; i < LOG2_DRAM_BANKS; i++)
+            sources[bank + i] |= 1ULL << (row + i);
+        for (int i = 0; i < LOG2_DRAM_RANKS; i++)
+            sources[rank + i] |= 1ULL << (row + LOG2_DRAM_BANKS + i);
+        for (int i = 0; i < LOG2_DRAM_CHANNELS; i++)
+            sources[channel + i] |= 1ULL << (row + LOG2_DRAM_BANKS + LOG2_DRAM_RANKS + i);
+    }
+
+    // the coordinates are linear in the address bits, so the contributions of its bytes XOR together
+    table.resize((DRAM_ADDRESS_BITS + 7) / 8);
+    for (uint32_t i = 0; i < table.size(); i++)
+        for (uint64_t byte = 0; byte < 256; byte++)
+        {
+            uint64_t coordinates = 0;
+            for (int j = 0; j < DRAM_ADDRESS_BITS; j++)
+                if (__builtin_parityll(sources[j] & (byte << (8 * i))))
+                    coordinates |= 1ULL << j;
+            table[i][byte] = coordinates;
+        }
+    return true;
+}
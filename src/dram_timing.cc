@@ -0,0 +1,251 @@
+#include "dram_controller.h"
+
+namespace
+{
+// in nanoseconds, x8 parts; tRP/tRCD/tCAS are those of the legacy model
+struct Standard {
+    const char *name;
+    double tRAS, tRRD_S, tRRD_L, tFAW, tCCD_S, tCCD_L, tRTP, tWR, tREFI, tRFC;
+};
+
+const Standard standards[] = {
+    // DDR4-3200, 8Gb
+    {"ddr4", 32, 2.5, 4.9, 21, 2.5, 5, 7.5, 15, 7800, 350},
+    // DDR5-4800, 16Gb
+    {"ddr5", 32, 3.3, 5, 13.3, 3.3, 5, 7.5, 30, 3900, 295},
+};
+
+uint64_t to_cycles(double nanoseconds) { return (uint64_t)(nanoseconds * CPU_FREQ / 1000); }
+} // namespace
+
+bool DRAMTiming::configure(const string &name)
+{
+    if (name == "legacy")
+    {
+        enabled = false;
+        this->name = name;
+        return true;
+    }
+
+    for (const Standard &standard : standards)
+    {
+        if (name != standard.name)
+            continue;
+
+        enabled = true;
+        this->name = name;
+        tRAS = to_cycles(standard.tRAS);
+        tRC = tRAS + tRP;
+        tRRD_S = to_cycles(standard.tRRD_S);
+        tRRD_L = to_cycles(standard.tRRD_L);
+        tFAW = to_cycles(standard.tFAW);
+        tCCD_S = to_cycles(standard.tCCD_S);
+        tCCD_L = to_cycles(standard.tCCD_L);
+        tRTP = to_cycles(standard.tRTP);
+        tWR = to_cycles(standard.tWR);
+        tREFI = to_cycles(standard.tREFI);
+        tRFC = to_cycles(standard.tRFC);
+
+        // ranks take turns to refresh
+        for (uint32_t i = 0; i < DRAM_CHANNELS; i++)
+            for (uint32_t j = 0; j < DRAM_RANKS; j++)
+                ranks[i][j].next_refresh = tREFI * (j + 1) / DRAM_RANKS;
+        return true;
+    }
+    return false;
+}
+
+uint64_t DRAMTiming::spaced(const vector<Command> &booked, uint64_t cycle, uint32_t group, uint64_t gap_s, uint64_t gap_l)
+{
+    // in cycle order, so a command moved past one is only checked against the later ones
+    for (const Command &command : booked)
+    {
+        uint64_t gap = (command.group == group) ? gap_l : gap_s;
+        if (cycle + gap > command.cycle && cycle < command.cycle + gap)
+            cycle = command.cycle + gap;
+    }
+    return cycle;
+}
+
+uint64_t DRAMTiming::four_activate_window(const vector<Command> &booked, uint64_t cycle) const
+{
+    // any four booked activates less than tFAW apart with this one, the first of them must be tFAW away
+    for (size_t i = 0; i + 4 <= booked.size(); i++)
+        if (max(cycle, booked[i + 3].cycle) < min(cycle, booked[i].cycle) + tFAW)
+            cycle = booked[i].cycle + tFAW;
+    return cycle;
+}
+
+void DRAMTiming::prune(vector<Command> &booked, uint64_t cycle, uint64_t horizon)
+{
+    size_t old = 0;
+    while (old < booked.size() && booked[old].cycle + horizon <= cycle)
+        old++;
+    booked.erase(booked.begin(), booked.begin() + old);
+}
+
+void DRAMTiming::book(vector<Command> &booked, uint64_t cycle, uint32_t group)
+{
+    size_t i = booked.size();
+    while (i && booked[i - 1].cycle > cycle)
+        i--;
+    booked.insert(booked.begin() + i, Command{cycle, group});
+}
+
+void DRAMTiming::unbook(vector<Command> &booked, uint64_t cycle, uint32_t group)
+{
+    for (size_t i = 0; i < booked.size(); i++)
+        if (booked[i].cycle == cycle && booked[i].group == group)
+        {
+            booked.erase(booked.begin() + i);
+            return;
+        }
+}
+
+uint64_t DRAMTiming::issue(uint32_t channel, uint32_t rank, uint32_t bank, bool row_hit, bool row_open, bool write,
+                           uint64_t cycle)
+{
+    Bank &b = banks[channel][rank][bank];
+    Rank &r = ranks[channel][rank];
+    uint32_t group = bank / DRAM_BANKS_PER_GROUP;
+
+    prune(r.activates, cycle, max(tFAW, tRRD_L));
+    prune(r.columns, cycle, tCCD_L);
+    b.prior_next_activate = b.next_activate;
+    b.prior_next_precharge = b.next_precharge;
+    b.precharge = b.activate = 0;
+    b.binding = -1;
+
+    uint64_t column = cycle;
+    if (!row_hit)
+    {
+        // the bank's own constraints and refresh
+        uint64_t earliest[NUM_CONSTRAINTS] = {};
+        if (row_open)
+            b.precharge = max(cycle, b.next_precharge);
+        earliest[PRECHARGE] = row_open ? b.precharge + tRP : cycle;
+        earliest[BANK_tRC] = b.next_activate;
+        earliest[RANK_REFRESH] = r.refresh_end;
+
+        uint64_t unconstrained = row_open ? cycle + tRP : cycle, activate = unconstrained;
+        int binding = -1;
+        for (int i = 0; i < NUM_CONSTRAINTS; i++)
+            if (earliest[i] > activate)
+            {
+                activate = earliest[i];
+                binding = i;
+            }
+
+        // then the activates booked on the rank, until tRRD and tFAW agree
+        for (uint64_t settled = 0; settled != activate;)
+        {
+            settled = activate;
+            uint64_t rrd = spaced(r.activates, activate, group, tRRD_S, tRRD_L);
+            if (rrd > activate)
+            {
+                activate = rrd;
+                binding = RANK_tRRD;
+            }
+            uint64_t faw = four_activate_window(r.activates, activate);
+            if (faw > activate)
+            {
+                activate = faw;
+                binding = RANK_tFAW;
+            }
+        }
+        if (binding >= 0)
+        {
+            delayed[binding]++;
+            delay[binding] += activate - unconstrained;
+            b.binding = binding;
+            b.binding_delay = activate - unconstrained;
+        }
+
+        b.next_activate = activate + tRC;
+        b.next_precharge = activate + tRAS;
+        b.activate = activate;
+        book(r.activates, activate, group);
+        activates++;
+
+        column = activate + tRCD;
+    }
+
+    uint64_t legal = spaced(r.columns, column, group, tCCD_S, tCCD_L);
+    b.column_wait = legal - column;
+    column_delay += b.column_wait;
+    column = legal;
+    b.column = column;
+    book(r.columns, column, group);
+
+    uint64_t ready = column + tCAS;
+    b.next_precharge = max(b.next_precharge, write ? ready + DRAM_DBUS_RETURN_TIME + tWR : column + tRTP);
+    return ready;
+}
+
+bool DRAMTiming::cancel(uint32_t channel, uint32_t rank, uint32_t bank, uint64_t cycle)
+{
+    Bank &b = banks[channel][rank][bank];
+    Rank &r = ranks[channel][rank];
+    uint32_t group = bank / DRAM_BANKS_PER_GROUP;
+
+    // the column command was issued, so was everything before it
+    if (b.column <= cycle)
+        return true;
+    unbook(r.columns, b.column, group);
+    column_delay -= b.column_wait;
+    b.column = 0;
+
+    bool open = b.activate <= cycle;
+    if (!open)
+    {
+        // the bank is as it was, unless its old row was already closed
+        unbook(r.activates, b.activate, group);
+        b.next_activate = b.prior_next_activate;
+        b.next_precharge = b.prior_next_precharge;
+        if (b.precharge && b.precharge <= cycle)
+            b.next_activate = max(b.next_activate, b.precharge + tRP);
+        activates--;
+        cancelled_activates++;
+        if (b.binding >= 0)
+        {
+            delayed[b.binding]--;
+            delay[b.binding] -= b.binding_delay;
+        }
+    }
+    else if (b.activate)
+        b.next_precharge = b.activate + tRAS; // the row was opened, only tRAS holds its precharge
+    else
+        b.next_precharge = b.prior_next_precharge;
+    b.precharge = b.activate = 0;
+    return open;
+}
+
+void DRAMTiming::refresh(uint32_t channel, uint32_t rank, uint64_t start)
+{
+    Rank &r = ranks[channel][rank];
+    r.refresh_end = start + tRFC;
+    r.next_refresh += tREFI;
+    refreshes++;
+}
+
+void DRAMTiming::reset_stats()
+{
+    activates = cancelled_activates = refreshes = column_delay = 0;
+    for (int i = 0; i < NUM_CONSTRAINTS; i++)
+        delayed[i] = delay[i] = 0;
+}
+
+void DRAMTiming::print_stats() const
+{
+    const char *names[NUM_CONSTRAINTS] = {"PRECHARGE", "tRC", "tRRD", "tFAW", "REFRESH"};
+
+    cout << endl;
+    cout << "DRAM Timing " << name << " ACTIVATES: " << activates << "  CANCELLED: " << cancelled_activates
+         << "  REFRESHES: " << refreshes
+         << "  COLUMN_DELAY_CYCLES (tCCD): " << column_delay << endl;
+    for (int i = 0; i < NUM_CONSTRAINTS; i++)
+    {
+        cout << " ACTIVATES DELAYED BY " << setw(9) << names[i] << ": " << setw(10) << delayed[i];
+        cout << "  AVG_DELAY: " << (delayed[i] ? delay[i] / delayed[i] : 0) << endl;
+    }
+}
@@ -0,0 +1,251 @@
+#include <sstream>
+#include "latency_trace.h"
+
+LatencyTrace latency_trace;
+
+namespace
+{
+const char *level_names[LATENCY_TRACE_DRAM + 1] = {"ITLB", "DTLB", "STLB", "L1I", "L1D", "L2C", "LLC", "DRAM"};
+const char *span_names[LatencyTrace::NUM_SPANS] = {"RQ", "WQ", "PQ", "MSHR", "fill", "queue", "access"};
+const char *class_names[] = {"load", "RFO", "prefetch", "late prefetch"};
+
+int bucket(uint64_t latency) { return latency ? min(63 - __builtin_clzll(latency) + 1, 31) : 0; }
+
+// the bucket upper bound the given share of a log2 histogram is at or below
+uint64_t percentile(const uint64_t *histogram, int buckets, double share)
+{
+    uint64_t total = 0, seen = 0;
+    for (int i = 0; i < buckets; i++)
+        total += histogram[i];
+    for (int i = 0; i < buckets; i++)
+    {
+        seen += histogram[i];
+        if (seen >= share * total)
+            return i ? 1ULL << i : 0;
+    }
+    return 0;
+}
+} // namespace
+
+uint32_t LatencyTrace::sample(const PACKET &packet, uint8_t level, uint64_t cycle)
+{
+    if (!enabled || !warmup_complete[packet.cpu] || records.size() >= max_records || candidates++ % period)
+        return 0;
+
+    Record record;
+    record.address = packet.address;
+    record.begin_cycle = cycle;
+    record.cpu = packet.cpu;
+    record.fill_level = packet.fill_level;
+    record.type = packet.type;
+    records.push_back(record);
+    return records.size();
+}
+
+void LatencyTrace::hop(uint32_t id, uint8_t level, Span span, bool begin, uint64_t cycle)
+{
+    Record &record = records[id - 1];
+    if (record.done_cycle)
+        return;
+    if (record.hops == LATENCY_TRACE_HOPS)
+    {
+        // a request rescheduled over and over in the DRAM, follow it to the end without the stages
+        if (!record.truncated)
+            truncated++;
+        record.truncated = true;
+        return;
+    }
+    record.hop[record.hops++] = {cycle, level, span, begin};
+}
+
+void LatencyTrace::arrive(uint32_t id, uint32_t fill_level, uint64_t cycle)
+{
+    Record &record = records[id - 1];
+    if (!record.done_cycle && fill_level <= record.fill_level)
+        record.done_cycle = cycle;
+}
+
+void LatencyTrace::late(uint32_t id, uint64_t cycle)
+{
+    Record &record = records[id - 1];
+    if (!record.late_cycle)
+        record.late_cycle = cycle;
+}
+
+void LatencyTrace::merge(uint32_t id, const MEMORY *cache, uint8_t level, uint64_t address, uint32_t fill_level, uint64_t cycle)
+{
+    // above the level it fills, the request still waits in its own MSHR
+    Record &record = records[id - 1];
+    if (record.done_cycle || fill_level > record.fill_level)
+        return;
+
+    if (!record.merged)
+        merged++;
+    record.merged = true;
+    waiting.push_back({id, cache, address});
+    hop(id, level, MSHR, true, cycle);
+}
+
+void LatencyTrace::fill(const MEMORY *cache, uint8_t level, uint64_t address, uint32_t fill_level, uint64_t cycle)
+{
+    for (size_t i = 0; i < waiting.size();)
+    {
+        if (waiting[i].cache != cache || waiting[i].address != address)
+        {
+            i++;
+            continue;
+        }
+        hop(waiting[i].id, level, MSHR, false, cycle);
+        arrive(waiting[i].id, fill_level, cycle);
+        waiting[i] = waiting.back();
+        waiting.pop_back();
+    }
+}
+
+int LatencyTrace::record_class(const Record &record) const
+{
+    if (record.type == PREFETCH)
+        return record.late_cycle ? LATE_PREFETCH_CLASS : PREFETCH_CLASS;
+    return record.type == RFO ? RFO_CLASS : LOAD_CLASS;
+}
+
+void LatencyTrace::print_stats() const
+{
+    static uint64_t histogram[NUM_CLASSES][LATENCY_TRACE_DRAM + 1][NUM_SPANS][BUCKETS];
+    uint64_t total_histogram[NUM_CLASSES][BUCKETS] = {}, requests[NUM_CLASSES] = {}, total[NUM_CLASSES] = {};
+    uint64_t truncated_requests[NUM_CLASSES] = {}, truncated_total[NUM_CLASSES] = {};
+    uint64_t stage_total[NUM_CLASSES][LATENCY_TRACE_DRAM + 1][NUM_SPANS] = {};
+    memset(histogram, 0, sizeof(histogram));
+
+    for (const Record &record : records)
+    {
+        if (!record.done_cycle)
+            continue;
+
+        int c = record_class(record);
+        uint64_t latency = record.done_cycle - record.begin_cycle;
+        if (record.truncated)
+        {
+            // the stages are missing the last hops, only the latency is known
+            truncated_requests[c]++;
+            truncated_total[c] += latency;
+            continue;
+        }
+        requests[c]++;
+        total[c] += latency;
+        total_histogram[c][bucket(latency)]++;
+
+        // a request may go through a stage more than once, add those up
+        uint64_t open[LATENCY_TRACE_DRAM + 1][NUM_SPANS] = {}, spent[LATENCY_TRACE_DRAM + 1][NUM_SPANS] = {};
+        bool seen[LATENCY_TRACE_DRAM + 1][NUM_SPANS] = {};
+        for (uint32_t i = 0; i < record.hops; i++)
+        {
+            const Hop &hop = record.hop[i];
+            if (hop.begin)
+                open[hop.level][hop.span] = hop.cycle + 1;
+            else if (open[hop.level][hop.span])
+            {
+                spent[hop.level][hop.span] += hop.cycle + 1 - open[hop.level][hop.span];
+                seen[hop.level][hop.span] = true;
+                open[hop.level][hop.span] = 0;
+            }
+        }
+        for (int l = 0; l <= LATENCY_TRACE_DRAM; l++)
+            for (int s = 0; s < NUM_SPANS; s++)
+                if (seen[l][s])
+                {
+                    histogram[c][l][s][bucket(spent[l][s])]++;
+                    stage_total[c][l][s] += spent[l][s];
+                }
+    }
+
+    cout << endl;
+    cout << "Latency Trace: " << records.size() << " requests sampled, 1 in " << period << ", " << merged
+         << " merged into another MSHR, " << truncated << " truncated" << endl;
+    for (int c = 0; c < NUM_CLASSES; c++)
+    {
+        if (requests[c])
+        {
+            cout << " " << class_names[c] << " requests: " << requests[c] << "  AVG_LATENCY: " << total[c] / requests[c];
+            cout << "  P50: " << percentile(total_histogram[c], BUCKETS, 0.5) << "  P90: " << percentile(total_histogram[c], BUCKETS, 0.9)
+                 << "  P99: " << percentile(total_histogram[c], BUCKETS, 0.99) << endl;
+        }
+        for (int l = 0; l <= LATENCY_TRACE_DRAM; l++)
+            for (int s = 0; s < NUM_SPANS; s++)
+            {
+                uint64_t count = 0;
+                for (int b = 0; b < BUCKETS; b++)
+                    count += histogram[c][l][s][b];
+                if (!count)
+                    continue;
+
+                string stage = string(level_names[l]) + " " + span_names[s];
+                cout << "  " << left << setw(12) << stage << right << " requests: " << setw(8) << count;
+                cout << "  AVG: " << setw(6) << stage_total[c][l][s] / count;
+                cout << "  P50: " << setw(6) << percentile(histogram[c][l][s], BUCKETS, 0.5);
+                cout << "  P90: " << setw(6) << percentile(histogram[c][l][s], BUCKETS, 0.9);
+                cout << "  P99: " << setw(6) << percentile(histogram[c][l][s], BUCKETS, 0.99);
+                cout << "  log2 histogram:";
+                int last = BUCKETS - 1;
+                while (last && !histogram[c][l][s][last])
+                    last--;
+                for (int b = 0; b <= last; b++)
+                    cout << " " << histogram[c][l][s][b];
+                cout << endl;
+            }
+        if (truncated_requests[c])
+            cout << " " << class_names[c] << " truncated requests: " << truncated_requests[c]
+                 << "  AVG_LATENCY: " << truncated_total[c] / truncated_requests[c] << endl;
+    }
+}
+
+void LatencyTrace::write() const
+{
+    ofstream out(path);
+    if (!out)
+    {
+        cerr << "cannot write the latency trace to " << path << endl;
+        return;
+    }
+
+    // cycles as microseconds
+    out << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"time unit\":\"cycle\"},\"traceEvents\":[" << endl;
+    bool first = true;
+    auto event = [&](const string &json) {
+        out << (first ? "" : ",\n") << json;
+        first = false;
+    };
+
+    for (uint32_t id = 1; id <= records.size(); id++)
+    {
+        const Record &record = records[id - 1];
+        string track = "\"pid\":" + to_string(record.cpu) + ",\"tid\":" + to_string(id);
+        ostringstream name;
+        name << class_names[record_class(record)] << " 0x" << hex << (record.address << LOG2_BLOCK_SIZE);
+        event("{\"name\":\"thread_name\",\"ph\":\"M\"," + track + ",\"args\":{\"name\":\"" + name.str() + "\"}}");
+
+        uint64_t end = record.done_cycle ? record.done_cycle : record.hops ? record.hop[record.hops - 1].cycle : record.begin_cycle;
+        event("{\"name\":\"" + name.str() + "\",\"cat\":\"" + class_names[record_class(record)] + "\",\"ph\":\"X\",\"ts\":" +
+              to_string(record.begin_cycle) + ",\"dur\":" + to_string(end - record.begin_cycle) + "," + track +
+              ",\"args\":{\"done\":" + (record.done_cycle ? "true" : "false") + ",\"merged\":" + (record.merged ? "true" : "false") +
+              ",\"truncated\":" + (record.truncated ? "true" : "false") + "}}");
+        if (record.late_cycle)
+            event("{\"name\":\"demand merged, late\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" + to_string(record.late_cycle) + "," + track + "}");
+
+        uint64_t open[LATENCY_TRACE_DRAM + 1][NUM_SPANS] = {};
+        for (uint32_t i = 0; i < record.hops; i++)
+        {
+            const Hop &hop = record.hop[i];
+            if (hop.begin)
+                open[hop.level][hop.span] = hop.cycle + 1;
+            else if (open[hop.level][hop.span])
+            {
+                uint64_t begin = open[hop.level][hop.span] - 1;
+                event("{\"name\":\"" + string(level_names[hop.level]) + " " + span_names[hop.span] + "\",\"ph\":\"X\",\"ts\":" +
+                      to_string(begin) + ",\"dur\":" + to_string(hop.cycle - begin) + "," + track + "}");
+                open[hop.level][hop.span] = 0;
+            }
+        }
+    }
+    out << endl << "]}" << endl;
+}
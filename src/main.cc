@@ -3,6 +3,11 @@
 #include <getopt.h>
 #include "ooo_cpu.h"
 #include "cache.h"
+#include "access_log.h"
+#include "region_stats.h"
+#include "latency_trace.h"
+#include "sampling.h"
+#include "simpoint.h"
 #include "uncore.h"
 #include <fstream>
 
@@ -17,9 +22,13 @@ uint8_t warmup_complete[NUM_CPUS],
     all_simulation_complete = 0,
     MAX_INSTR_DESTINATIONS = NUM_INSTR_DESTINATIONS,
     knob_cloudsuite = 0,
-    knob_low_bandwidth = 0;
+    knob_low_bandwidth = 0,
+    knob_perfect_branch = 0,
+    knob_infinite_dram_bw = 0,
+    functional_warming = 0;
 
 uint64_t warmup_instructions = 1000000,
+         functional_warmup_instructions = 0,
          simulation_instructions = 10000000,
          champsim_seed;
 uint32_t measure_dram_bw_epoch = 256;
@@ -44,54 +53,59 @@ void record_roi_stats(uint32_t cpu, CACHE *cache)
     cache->roi_hit[cpu][i] = cache->sim_hit[cpu][i];
     cache->roi_miss[cpu][i] = cache->sim_miss[cpu][i];
   }
+  cache->roi_delta[cpu].add(cache->roi_begin[cpu], cache->live_stats(cpu));
 }
 
-void print_roi_stats(uint32_t cpu, CACHE *cache)
+void print_roi_stats(uint32_t cpu, CACHE *cache, const CACHE_ROI_STATS &roi)
 {
   uint64_t TOTAL_ACCESS = 0, TOTAL_HIT = 0, TOTAL_MISS = 0;
 
   for (uint32_t i = 0; i < NUM_TYPES; i++)
   {
-    TOTAL_ACCESS += cache->roi_access[cpu][i];
-    TOTAL_HIT += cache->roi_hit[cpu][i];
-    TOTAL_MISS += cache->roi_miss[cpu][i];
+    TOTAL_ACCESS += roi.access[i];
+    TOTAL_HIT += roi.hit[i];
+    TOTAL_MISS += roi.miss[i];
   }
 
   cout << cache->NAME;
   cout << " TOTAL     ACCESS: " << setw(10) << TOTAL_ACCESS << "  HIT: " << setw(10) << TOTAL_HIT << "  MISS: " << setw(10) << TOTAL_MISS << endl;
 
   cout << cache->NAME;
-  cout << " LOAD      ACCESS: " << setw(10) << cache->roi_access[cpu][0] << "  HIT: " << setw(10) << cache->roi_hit[cpu][0] << "  MISS: " << setw(10) << cache->roi_miss[cpu][0] << endl;
+  cout << " LOAD      ACCESS: " << setw(10) << roi.access[0] << "  HIT: " << setw(10) << roi.hit[0] << "  MISS: " << setw(10) << roi.miss[0] << endl;
 
   cout << cache->NAME;
-  cout << " RFO       ACCESS: " << setw(10) << cache->roi_access[cpu][1] << "  HIT: " << setw(10) << cache->roi_hit[cpu][1] << "  MISS: " << setw(10) << cache->roi_miss[cpu][1] << endl;
+  cout << " RFO       ACCESS: " << setw(10) << roi.access[1] << "  HIT: " << setw(10) << roi.hit[1] << "  MISS: " << setw(10) << roi.miss[1] << endl;
 
   cout << cache->NAME;
-  cout << " PREFETCH  ACCESS: " << setw(10) << cache->roi_access[cpu][2] << "  HIT: " << setw(10) << cache->roi_hit[cpu][2] << "  MISS: " << setw(10) << cache->roi_miss[cpu][2] << endl;
+  cout << " PREFETCH  ACCESS: " << setw(10) << roi.access[2] << "  HIT: " << setw(10) << roi.hit[2] << "  MISS: " << setw(10) << roi.miss[2] << endl;
 
   cout << cache->NAME;
-  cout << " WRITEBACK ACCESS: " << setw(10) << cache->roi_access[cpu][3] << "  HIT: " << setw(10) << cache->roi_hit[cpu][3] << "  MISS: " << setw(10) << cache->roi_miss[cpu][3] << endl;
+  cout << " WRITEBACK ACCESS: " << setw(10) << roi.access[3] << "  HIT: " << setw(10) << roi.hit[3] << "  MISS: " << setw(10) << roi.miss[3] << endl;
 
   cout << cache->NAME;
-  cout << " PREFETCH  REQUESTED: " << setw(10) << cache->pf_requested << "  ISSUED: " << setw(10) << cache->pf_issued;
-  cout << "  USEFUL: " << setw(10) << cache->pf_useful << "  USELESS: " << setw(10) << cache->pf_useless;
-  cout << "  LATE: " << setw(10) << cache->pf_late << endl;
+  cout << " PREFETCH  REQUESTED: " << setw(10) << roi.pf_requested << "  ISSUED: " << setw(10) << roi.pf_issued;
+  cout << "  USEFUL: " << setw(10) << roi.pf_useful << "  USELESS: " << setw(10) << roi.pf_useless;
+  cout << "  LATE: " << setw(10) << roi.pf_late << endl;
 
   cout << cache->NAME;
-  cout << " AVERAGE MISS LATENCY: " << (1.0 * (cache->total_miss_latency)) / TOTAL_MISS << " cycles" << endl;
+  cout << " PREFETCH  FILTERED RESIDENT: " << setw(10) << roi.pf_dropped[PrefetchFilter::DROP_RESIDENT];
+  cout << "  INFLIGHT: " << setw(10) << roi.pf_dropped[PrefetchFilter::DROP_INFLIGHT] << endl;
+
+  cout << cache->NAME;
+  cout << " AVERAGE MISS LATENCY: " << (1.0 * (roi.total_miss_latency)) / TOTAL_MISS << " cycles" << endl;
   // cout << " AVERAGE MISS LATENCY: " << (cache->total_miss_latency)/TOTAL_MISS << " cycles " << cache->total_miss_latency << "/" << TOTAL_MISS<< endl;
 
   cout << cache->NAME;
-  cout << " AVERAGE LOAD MISS LATENCY: " << double(cache->miss_latency[cpu][0]) / cache->roi_miss[cpu][0] << " cycles" << endl;
+  cout << " AVERAGE LOAD MISS LATENCY: " << double(roi.miss_latency[0]) / roi.miss[0] << " cycles" << endl;
 
   cout << cache->NAME;
-  cout << " AVERAGE RFO MISS LATENCY: " << double(cache->miss_latency[cpu][1]) / cache->roi_miss[cpu][1] << " cycles" << endl;
+  cout << " AVERAGE RFO MISS LATENCY: " << double(roi.miss_latency[1]) / roi.miss[1] << " cycles" << endl;
 
   cout << cache->NAME;
-  cout << " AVERAGE PREFETCH MISS LATENCY: " << double(cache->miss_latency[cpu][2]) / cache->roi_miss[cpu][2] << " cycles" << endl;
+  cout << " AVERAGE PREFETCH MISS LATENCY: " << double(roi.miss_latency[2]) / roi.miss[2] << " cycles" << endl;
 
   cout << cache->NAME;
-  cout << " AVERAGE WRITEBACK MISS LATENCY: " << double(cache->miss_latency[cpu][3]) / cache->roi_miss[cpu][3] << " cycles" << endl;
+  cout << " AVERAGE WRITEBACK MISS LATENCY: " << double(roi.miss_latency[3]) / roi.miss[3] << " cycles" << endl;
 
 #ifdef MEASURE_COMPULSORY
   cout << cache->NAME << " " << cache->cmr_.to_string() << endl;
@@ -170,6 +184,51 @@ void print_dram_stats()
     cout << " AVG_CONGESTED_CYCLE: " << (total_congested_cycle / uncore.DRAM.dbus_congested[NUM_TYPES][NUM_TYPES]) << endl;
   else
     cout << " AVG_CONGESTED_CYCLE: -" << endl;
+
+  // bank-level parallelism: the banks with a request on them, on average
+  uint64_t cycles = current_core_cycle[0] - uncore.DRAM.bank_stats_begin_cycle, busy_cycles = 0;
+  streamsize precision = cout.precision();
+  cout << endl;
+  cout << "DRAM Bank Statistics (" << uncore.DRAM.mapping.mapping << ", " << uncore.DRAM.mapping.interleave << " interleave)" << endl;
+  for (uint32_t i = 0; i < DRAM_CHANNELS; i++)
+    for (uint32_t j = 0; j < DRAM_RANKS; j++)
+      for (uint32_t k = 0; k < DRAM_BANKS; k++)
+      {
+        DRAM_BANK_STATS &stats = uncore.DRAM.bank_stats[i][j][k];
+        uint64_t accesses = stats.reads + stats.writes;
+        busy_cycles += stats.busy_cycles;
+        cout << " CHANNEL " << i << " RANK " << j << " BANK " << setw(2) << k;
+        cout << "  READS: " << setw(10) << stats.reads << "  WRITES: " << setw(10) << stats.writes;
+        cout << "  ROW_BUFFER_HIT: " << setw(6) << fixed << setprecision(2) << (accesses ? 100.0 * stats.row_buffer_hits / accesses : 0) << "%";
+        cout << "  BUSY: " << setw(6) << (cycles ? 100.0 * stats.busy_cycles / cycles : 0) << "%" << endl;
+      }
+  cout << " AVG_BUSY_BANKS: " << fixed << setprecision(2) << (cycles ? 1.0 * busy_cycles / cycles : 0) << " of " << DRAM_CHANNELS * DRAM_RANKS * DRAM_BANKS << endl;
+  cout.unsetf(ios::floatfield);
+  cout.precision(precision);
+
+  if (uncore.DRAM.timing.enabled)
+    uncore.DRAM.timing.print_stats();
+
+  // what the write drains cost the reads; the data bus congestion split by who waited
+  uint64_t read_congested = uncore.DRAM.dbus_congested[NUM_TYPES][LOAD] + uncore.DRAM.dbus_congested[NUM_TYPES][RFO] +
+                            uncore.DRAM.dbus_congested[NUM_TYPES][PREFETCH];
+  cout << endl;
+  cout << "DRAM Write Drain Statistics" << endl;
+  cout << " DBUS_CONGESTED READ: " << setw(10) << read_congested << "  WRITE: " << setw(10) << uncore.DRAM.dbus_congested[NUM_TYPES][WRITEBACK] << endl;
+  for (uint32_t i = 0; i < DRAM_CHANNELS; i++)
+  {
+    DRAM_WRITE_DRAIN_STATS &stats = uncore.DRAM.write_drain_stats[i];
+    cout << " CHANNEL " << i << " DRAINS: " << setw(10) << stats.drains;
+    cout << "  AVG_WRITES_PER_DRAIN: " << (stats.drains ? stats.drain_writes / stats.drains : 0);
+    cout << "  AVG_DRAIN_CYCLES: " << (stats.drains ? stats.drain_cycles / stats.drains : 0) << endl;
+    cout << " CHANNEL " << i << " READS: " << setw(10) << stats.reads << "  FORWARDED: " << setw(10) << stats.forwarded_reads;
+    cout << "  AVG_READ_LATENCY: " << (stats.reads ? stats.read_latency / stats.reads : 0);
+    cout << "  READS_DELAYED_BY_WRITE_MODE: " << setw(10) << stats.reads_inflated;
+    cout << "  AVG_WRITE_MODE_DELAY: " << (stats.reads_inflated ? stats.read_inflation / stats.reads_inflated : 0);
+    cout << "  READ_LATENCY_INFLATION: " << fixed << setprecision(2) << (stats.read_latency ? 100.0 * stats.read_inflation / stats.read_latency : 0) << "%" << endl;
+    cout.unsetf(ios::floatfield);
+    cout.precision(precision);
+  }
 }
 
 void reset_cache_stats(uint32_t cpu, CACHE *cache)
@@ -198,6 +257,14 @@ void reset_cache_stats(uint32_t cpu, CACHE *cache)
   cache->WQ.TO_CACHE = 0;
   cache->WQ.FORWARD = 0;
   cache->WQ.FULL = 0;
+
+  if (cache->mrc)
+    cache->mrc->reset_stats();
+  if (cache->shadow)
+    cache->shadow->reset_stats();
+
+  cache->roi_begin[cpu] = cache->live_stats(cpu);
+  cache->roi_delta[cpu] = CACHE_ROI_STATS();
 }
 
 void finish_warmup()
@@ -240,6 +307,8 @@ void finish_warmup()
     reset_cache_stats(i, &ooo_cpu[i].L1D);
     reset_cache_stats(i, &ooo_cpu[i].L2C);
     reset_cache_stats(i, &uncore.LLC);
+    if (region_analyzer[i])
+      region_analyzer[i]->reset_stats();
   }
   cout << endl;
 
@@ -251,6 +320,9 @@ void finish_warmup()
     uncore.DRAM.WQ[i].ROW_BUFFER_HIT = 0;
     uncore.DRAM.WQ[i].ROW_BUFFER_MISS = 0;
   }
+  uncore.DRAM.reset_bank_stats(current_core_cycle[0]);
+  uncore.DRAM.timing.reset_stats();
+  uncore.DRAM.reset_write_drain_stats();
 
   // set actual cache latency
   for (uint32_t i = 0; i < NUM_CPUS; i++)
@@ -548,6 +620,26 @@ void cpu_l1i_prefetcher_cache_fill(uint32_t cpu_num, uint64_t addr, uint32_t set
   ooo_cpu[cpu_num].l1i_prefetcher_cache_fill(addr, set, way, prefetch, evicted_addr);
 }
 
+// run every core through `instructions` trace instructions without timing
+void functional_warm(uint64_t instructions)
+{
+  functional_warming = 1;
+  for (uint64_t n = 0; n < instructions; n++)
+  {
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+      ooo_cpu[i].warm_instruction();
+    uncore.LLC.llc_prefetcher_cycle_operate();
+  }
+  functional_warming = 0;
+
+  // keep the heartbeat on the detailed part
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    ooo_cpu[i].last_sim_instr = ooo_cpu[i].num_retired;
+    ooo_cpu[i].next_print_instruction = (ooo_cpu[i].num_retired / STAT_PRINTING_PERIOD + 1) * STAT_PRINTING_PERIOD;
+  }
+}
+
 int main(int argc, char **argv)
 {
   // interrupt signal hanlder
@@ -570,6 +662,31 @@ int main(int argc, char **argv)
 
   uint32_t seed_number = 0;
 
+  string capture_l1d, replay_l1d, regions, summary;
+  uint32_t region_jobs = 0;
+
+  uint8_t perfect_l1d = 0, perfect_l2c = 0, perfect_llc = 0;
+  uint64_t oracle_lookahead = 0;
+
+  uint8_t mrc_l2c = 0, mrc_llc = 0, region_stats = 0;
+  double mrc_rate = 1;
+
+  string llc_shadow;
+  uint32_t llc_shadow_sets = 64;
+
+  string l2c_replacement;
+
+  string dram_mapping = "bitslice", dram_interleave = "line", dram_timing = "legacy";
+
+  string dram_write_drain = "eager";
+  uint32_t dram_write_high_wm = DRAM_WRITE_HIGH_WM, dram_write_low_wm = DRAM_WRITE_LOW_WM, dram_write_min_batch = 0;
+
+  uint32_t latency_trace_period = 100, latency_trace_max = 10000;
+
+  uint64_t sample_period = 0, sample_warmup = 20000, sample_window = 10000, sample_min = 10;
+  double sample_error = 0.03;
+  SMARTSSampler *sampler = NULL;
+
   // check to see if knobs changed using getopt_long()
   int c;
   while (1)
@@ -582,11 +699,45 @@ int main(int argc, char **argv)
             {"cloudsuite", no_argument, 0, 'c'},
             {"low_bandwidth", no_argument, 0, 'b'},
             {"traces", no_argument, 0, 't'},
+            {"capture_l1d", required_argument, 0, 'a'},
+            {"replay_l1d", required_argument, 0, 'r'},
+            {"functional_warmup", required_argument, 0, 'f'},
+            {"sample_period", required_argument, 0, 'p'},
+            {"sample_warmup", required_argument, 0, 'd'},
+            {"sample_window", required_argument, 0, 'u'},
+            {"sample_error", required_argument, 0, 'e'},
+            {"sample_min", required_argument, 0, 'm'},
+            {"regions", required_argument, 0, 'g'},
+            {"region_jobs", required_argument, 0, 'j'},
+            {"summary", required_argument, 0, 'o'},
+            {"perfect_l1d", no_argument, 0, '1'},
+            {"perfect_l2c", no_argument, 0, '2'},
+            {"perfect_llc", no_argument, 0, '3'},
+            {"perfect_branch", no_argument, 0, 'k'},
+            {"infinite_dram_bw", no_argument, 0, 'x'},
+            {"oracle_l1d", required_argument, 0, 'q'},
+            {"mrc_l2c", no_argument, 0, 'y'},
+            {"mrc_llc", no_argument, 0, 'z'},
+            {"mrc_rate", required_argument, 0, 'v'},
+            {"region_stats", no_argument, 0, 'n'},
+            {"llc_shadow", required_argument, 0, 'l'},
+            {"llc_shadow_sets", required_argument, 0, 'L'},
+            {"l2c_replacement", required_argument, 0, 'R'},
+            {"dram_mapping", required_argument, 0, 'M'},
+            {"dram_interleave", required_argument, 0, 'I'},
+            {"dram_timing", required_argument, 0, 'T'},
+            {"dram_write_drain", required_argument, 0, 'D'},
+            {"dram_write_high_wm", required_argument, 0, 'W'},
+            {"dram_write_low_wm", required_argument, 0, 'X'},
+            {"dram_write_min_batch", required_argument, 0, 'B'},
+            {"latency_trace", required_argument, 0, 'P'},
+            {"latency_trace_period", required_argument, 0, 'N'},
+            {"latency_trace_max", required_argument, 0, 'C'},
             {0, 0, 0, 0}};
 
     int option_index = 0;
 
-    c = getopt_long_only(argc, argv, "wihscbt", long_options, &option_index);
+    c = getopt_long_only(argc, argv, "wihscbta:r:f:p:d:u:e:m:g:j:o:123kxq:yzv:nl:L:R:M:I:T:D:W:X:B:P:N:C:", long_options, &option_index);
 
     // no more option characters
     if (c == -1)
@@ -615,6 +766,108 @@ int main(int argc, char **argv)
     case 't':
       traces_encountered = 1;
       break;
+    case 'a':
+      capture_l1d = optarg;
+      break;
+    case 'r':
+      replay_l1d = optarg;
+      break;
+    case 'f':
+      functional_warmup_instructions = atol(optarg);
+      break;
+    case 'p':
+      sample_period = atol(optarg);
+      break;
+    case 'd':
+      sample_warmup = atol(optarg);
+      break;
+    case 'u':
+      sample_window = atol(optarg);
+      break;
+    case 'e':
+      sample_error = atof(optarg);
+      break;
+    case 'm':
+      sample_min = atol(optarg);
+      break;
+    case 'g':
+      regions = optarg;
+      break;
+    case 'j':
+      region_jobs = atol(optarg);
+      break;
+    case 'o':
+      summary = optarg;
+      break;
+    case '1':
+      perfect_l1d = 1;
+      break;
+    case '2':
+      perfect_l2c = 1;
+      break;
+    case '3':
+      perfect_llc = 1;
+      break;
+    case 'k':
+      knob_perfect_branch = 1;
+      break;
+    case 'x':
+      knob_infinite_dram_bw = 1;
+      break;
+    case 'q':
+      oracle_lookahead = atol(optarg);
+      break;
+    case 'y':
+      mrc_l2c = 1;
+      break;
+    case 'z':
+      mrc_llc = 1;
+      break;
+    case 'v':
+      mrc_rate = atof(optarg);
+      break;
+    case 'n':
+      region_stats = 1;
+      break;
+    case 'l':
+      llc_shadow = optarg;
+      break;
+    case 'L':
+      llc_shadow_sets = atol(optarg);
+      break;
+    case 'R':
+      l2c_replacement = optarg;
+      break;
+    case 'M':
+      dram_mapping = optarg;
+      break;
+    case 'I':
+      dram_interleave = optarg;
+      break;
+    case 'T':
+      dram_timing = optarg;
+      break;
+    case 'D':
+      dram_write_drain = optarg;
+      break;
+    case 'W':
+      dram_write_high_wm = atol(optarg);
+      break;
+    case 'X':
+      dram_write_low_wm = atol(optarg);
+      break;
+    case 'B':
+      dram_write_min_batch = atol(optarg);
+      break;
+    case 'P':
+      latency_trace.path = optarg;
+      break;
+    case 'N':
+      latency_trace_period = atol(optarg);
+      break;
+    case 'C':
+      latency_trace_max = atol(optarg);
+      break;
     default:
       abort();
     }
@@ -623,9 +876,99 @@ int main(int argc, char **argv)
       break;
   }
 
+  // the regions run as child simulations, this process only combines them
+  if (regions.size())
+    return run_regions(regions, region_jobs, argc, argv);
+
   // consequences of knobs
   cout << "Warmup Instructions: " << warmup_instructions << endl;
   cout << "Simulation Instructions: " << simulation_instructions << endl;
+  if (functional_warmup_instructions)
+  {
+    // at least one detailed warmup instruction is left to refill the pipeline
+    if (functional_warmup_instructions >= warmup_instructions)
+      functional_warmup_instructions = warmup_instructions ? warmup_instructions - 1 : 0;
+    if (knob_cloudsuite || replay_l1d.size())
+    {
+      cerr << "-functional_warmup needs a standard trace, not -cloudsuite or -replay_l1d" << endl;
+      assert(0);
+    }
+    cout << "Functional Warmup Instructions: " << functional_warmup_instructions << endl;
+  }
+  if (sample_period)
+  {
+    if (knob_cloudsuite || replay_l1d.size())
+    {
+      cerr << "-sample_period needs a standard trace, not -cloudsuite or -replay_l1d" << endl;
+      assert(0);
+    }
+    sampler = new SMARTSSampler(sample_period, sample_warmup, sample_window, sample_error, sample_min);
+    cout << "Sampling Period: " << sample_period << " Detailed Warmup: " << sample_warmup << " Window: " << sample_window
+         << " Target Error: " << sample_error << " Min Windows: " << sample_min << endl;
+  }
+  if (perfect_l1d || perfect_l2c || perfect_llc || knob_perfect_branch || knob_infinite_dram_bw)
+    cout << "Bound Modes:" << (perfect_l1d ? " perfect_l1d" : "") << (perfect_l2c ? " perfect_l2c" : "")
+         << (perfect_llc ? " perfect_llc" : "") << (knob_perfect_branch ? " perfect_branch" : "")
+         << (knob_infinite_dram_bw ? " infinite_dram_bw" : "") << endl;
+  if (oracle_lookahead)
+  {
+    if (knob_cloudsuite || replay_l1d.size())
+    {
+      cerr << "-oracle_l1d needs a standard trace, not -cloudsuite or -replay_l1d" << endl;
+      assert(0);
+    }
+    cout << "Oracle L1D Prefetcher Lookahead: " << oracle_lookahead << " instructions" << endl;
+  }
+  if (mrc_l2c || mrc_llc)
+  {
+    if (mrc_rate <= 0 || mrc_rate > 1)
+    {
+      cerr << "-mrc_rate must be in (0, 1]" << endl;
+      assert(0);
+    }
+    cout << "Miss-Ratio Curves:" << (mrc_l2c ? " L2C" : "") << (mrc_llc ? " LLC" : "") << " Sampling Rate: " << mrc_rate << endl;
+  }
+  vector<string> llc_shadow_policies;
+  if (llc_shadow.size())
+  {
+    stringstream names(llc_shadow);
+    string name;
+    while (getline(names, name, ','))
+    {
+      if (!Replacement::policies().count(name))
+      {
+        cerr << "unknown -llc_shadow policy " << name << ", available:";
+        for (auto &policy : Replacement::policies())
+          cerr << " " << policy.first;
+        cerr << endl;
+        assert(0);
+      }
+      llc_shadow_policies.push_back(name);
+    }
+    if (llc_shadow_sets == 0 || llc_shadow_sets > LLC_SET)
+    {
+      cerr << "-llc_shadow_sets must be in [1, " << LLC_SET << "]" << endl;
+      assert(0);
+    }
+    cout << "LLC Shadow Replacement: " << llc_shadow << " Sampled Sets: " << llc_shadow_sets << endl;
+  }
+  if (l2c_replacement.size())
+  {
+    // the L2C cannot bypass, so the policies that do are not available there
+    if (!Replacement::policies().count(l2c_replacement) || Replacement::bypassing_policies().count(l2c_replacement))
+    {
+      if (Replacement::bypassing_policies().count(l2c_replacement))
+        cerr << "-l2c_replacement " << l2c_replacement << " bypasses, which only the LLC supports, available:";
+      else
+        cerr << "unknown -l2c_replacement policy " << l2c_replacement << ", available:";
+      for (auto &policy : Replacement::policies())
+        if (!Replacement::bypassing_policies().count(policy.first))
+          cerr << " " << policy.first;
+      cerr << endl;
+      assert(0);
+    }
+    cout << "L2C Replacement: " << l2c_replacement << endl;
+  }
   // cout << "Scramble Loads: " << (knob_scramble_loads ? "ture" : "false") << endl;
   cout << "Number of CPUs: " << NUM_CPUS << endl;
   cout << "LLC sets: " << LLC_SET << endl;
@@ -650,6 +993,54 @@ int main(int argc, char **argv)
 
   printf("Off-chip DRAM Size: %u MB Channels: %u Width: %u-bit Data Rate: %u MT/s\n",
          DRAM_SIZE, DRAM_CHANNELS, 8 * DRAM_CHANNEL_WIDTH, DRAM_MTPS);
+  if (!uncore.DRAM.mapping.configure(dram_mapping, dram_interleave))
+  {
+    cerr << "-dram_mapping must be bitslice or xor, -dram_interleave line or row" << endl;
+    assert(0);
+  }
+  if (dram_mapping != "bitslice" || dram_interleave != "line")
+    cout << "DRAM Address Mapping: " << dram_mapping << " Interleave: " << dram_interleave << endl;
+  if (!uncore.DRAM.timing.configure(dram_timing))
+  {
+    cerr << "-dram_timing must be legacy, ddr4 or ddr5" << endl;
+    assert(0);
+  }
+  if (uncore.DRAM.timing.enabled)
+    cout << "DRAM Timing: " << dram_timing << endl;
+  if (dram_write_drain == "watermark")
+    uncore.DRAM.write_drain = DRAIN_WATERMARK;
+  else if (dram_write_drain == "eager")
+    uncore.DRAM.write_drain = DRAIN_EAGER;
+  else if (dram_write_drain == "rowhit")
+    uncore.DRAM.write_drain = DRAIN_ROW_HIT;
+  else
+  {
+    cerr << "-dram_write_drain must be watermark, eager or rowhit" << endl;
+    assert(0);
+  }
+  if (dram_write_low_wm == 0 || dram_write_low_wm > dram_write_high_wm || dram_write_high_wm > DRAM_WQ_SIZE)
+  {
+    cerr << "DRAM write watermarks must satisfy 0 < -dram_write_low_wm <= -dram_write_high_wm <= " << DRAM_WQ_SIZE << endl;
+    assert(0);
+  }
+  uncore.DRAM.write_high_wm = dram_write_high_wm;
+  uncore.DRAM.write_low_wm = dram_write_low_wm;
+  uncore.DRAM.min_writes_per_switch = dram_write_min_batch;
+  if (dram_write_drain != "eager" || dram_write_high_wm != DRAM_WRITE_HIGH_WM || dram_write_low_wm != DRAM_WRITE_LOW_WM || dram_write_min_batch)
+    cout << "DRAM Write Drain: " << dram_write_drain << " High Watermark: " << dram_write_high_wm
+         << " Low Watermark: " << dram_write_low_wm << " Min Batch: " << dram_write_min_batch << endl;
+  if (latency_trace.path.size())
+  {
+    if (latency_trace_period == 0 || latency_trace_max == 0)
+    {
+      cerr << "-latency_trace_period and -latency_trace_max must be at least 1" << endl;
+      assert(0);
+    }
+    latency_trace.enabled = true;
+    latency_trace.period = latency_trace_period;
+    latency_trace.max_records = latency_trace_max;
+    cout << "Latency Trace: " << latency_trace.path << " 1 in " << latency_trace_period << " requests, at most " << latency_trace_max << endl;
+  }
 
   // end consequence of knobs
 
@@ -747,7 +1138,16 @@ int main(int argc, char **argv)
     }
   }
 
-  if (count_traces != NUM_CPUS)
+  if (replay_l1d.size())
+  {
+    // cache-only replay, the logs stand in for the traces
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+    {
+      l1d_replay[i] = new L1DReplay(l1d_log_path(replay_l1d, i));
+      cout << "CPU " << i << " replays " << l1d_log_path(replay_l1d, i) << endl;
+    }
+  }
+  else if (count_traces != NUM_CPUS)
   {
     printf("\n*** Not enough traces for the configured number of cores ***\n\n");
     assert(0);
@@ -812,6 +1212,8 @@ int main(int argc, char **argv)
     ooo_cpu[i].L1D.fill_level = FILL_L1;
     ooo_cpu[i].L1D.lower_level = &ooo_cpu[i].L2C;
     ooo_cpu[i].L1D.l1d_prefetcher_initialize();
+    ooo_cpu[i].L1D.perfect = perfect_l1d;
+    ooo_cpu[i].oracle_lookahead = oracle_lookahead;
 
     ooo_cpu[i].L2C.cpu = i;
     ooo_cpu[i].L2C.cache_type = IS_L2C;
@@ -820,6 +1222,11 @@ int main(int argc, char **argv)
     ooo_cpu[i].L2C.upper_level_dcache[i] = &ooo_cpu[i].L1D;
     ooo_cpu[i].L2C.lower_level = &uncore.LLC;
     ooo_cpu[i].L2C.l2c_prefetcher_initialize();
+    ooo_cpu[i].L2C.perfect = perfect_l2c;
+    if (mrc_l2c)
+      ooo_cpu[i].L2C.mrc = new MRCProfiler("CPU " + to_string(i) + " L2C", mrc_rate);
+    if (l2c_replacement.size())
+      ooo_cpu[i].L2C.repl = Replacement::make_policy(l2c_replacement, L2C_SET, L2C_WAY);
 
     // SHARED CACHE
     uncore.LLC.cache_type = IS_LLC;
@@ -828,6 +1235,7 @@ int main(int argc, char **argv)
     uncore.LLC.upper_level_icache[i] = &ooo_cpu[i].L2C;
     uncore.LLC.upper_level_dcache[i] = &ooo_cpu[i].L2C;
     uncore.LLC.lower_level = &uncore.DRAM;
+    uncore.LLC.perfect = perfect_llc;
 
     // OFF-CHIP DRAM
     uncore.DRAM.fill_level = FILL_DRAM;
@@ -854,9 +1262,30 @@ int main(int argc, char **argv)
     major_fault[i] = 0;
   }
 
+  if (mrc_llc)
+    uncore.LLC.mrc = new MRCProfiler("LLC", mrc_rate);
+  if (llc_shadow_policies.size())
+    uncore.LLC.shadow = new ReplacementShadow(llc_shadow_policies, LLC_SET, LLC_WAY, llc_shadow_sets);
   uncore.LLC.llc_initialize_replacement();
   uncore.LLC.llc_prefetcher_initialize();
 
+  if (capture_l1d.size())
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+      l1d_capture[i] = new L1DAccessLog(l1d_log_path(capture_l1d, i), true);
+  if (region_stats)
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+      region_analyzer[i] = new RegionAnalyzer(i);
+
+  if (functional_warmup_instructions)
+  {
+    // fast-forward the head of the warmup through the tag arrays, predictors and prefetchers
+    time_t warm_start = time(NULL);
+    functional_warm(functional_warmup_instructions);
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+      cout << "Functional warmup complete CPU " << i << " instructions: " << ooo_cpu[i].num_retired
+           << " (Simulation time: " << (time(NULL) - warm_start) << " sec)" << endl;
+  }
+
   // simulation entry point
   start_time = time(NULL);
   uint8_t run_simulation = 1;
@@ -901,8 +1330,26 @@ int main(int argc, char **argv)
       // cout << "Trying to process instr_id: " << ooo_cpu[i].instr_unique_id << " fetch_stall: " << +ooo_cpu[i].fetch_stall;
       // cout << " stall_cycle: " << stall_cycle[i] << " current: " << current_core_cycle[i] << endl;
 
+      if (l1d_replay[i])
+      {
+        // no core: the log drives L1D and the recorded retire count stands in for the ROB
+        l1d_replay[i]->operate(&ooo_cpu[i].L1D);
+        ooo_cpu[i].operate_cache();
+        ooo_cpu[i].num_retired = l1d_replay[i]->instructions;
+
+        if (l1d_replay[i]->done() && (simulation_complete[i] == 0))
+        {
+          if (all_warmup_complete <= NUM_CPUS)
+          {
+            cerr << "L1D access log of CPU " << i << " ends before warmup completes" << endl;
+            assert(0);
+          }
+          // the log is shorter than asked for, end the ROI where it ends
+          ooo_cpu[i].simulation_instructions = ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr;
+        }
+      }
       // core might be stalled due to page fault or branch misprediction
-      if (stall_cycle[i] <= current_core_cycle[i])
+      else if (stall_cycle[i] <= current_core_cycle[i])
       {
 
         // retire
@@ -937,8 +1384,8 @@ int main(int argc, char **argv)
         // fetch
         ooo_cpu[i].fetch_instruction();
 
-        // read from trace
-        if ((ooo_cpu[i].IFETCH_BUFFER.occupancy < ooo_cpu[i].IFETCH_BUFFER.SIZE) && (ooo_cpu[i].fetch_stall == 0))
+        // read from trace, unless the round is over and the cores drain before a fast-forward
+        if ((ooo_cpu[i].IFETCH_BUFFER.occupancy < ooo_cpu[i].IFETCH_BUFFER.SIZE) && (ooo_cpu[i].fetch_stall == 0) && !(sampler && sampler->round_done()))
         {
           ooo_cpu[i].read_from_trace();
         }
@@ -984,7 +1431,11 @@ int main(int argc, char **argv)
       { // this part is called only once when all cores are warmed up
         all_warmup_complete++;
         finish_warmup();
+        if (sampler)
+          sampler->start();
       }
+      if (sampler && (all_warmup_complete > NUM_CPUS))
+        sampler->operate(i);
 
       /*
             if (all_warmup_complete == 0) {
@@ -996,11 +1447,12 @@ int main(int argc, char **argv)
             */
 
       // simulation complete
-      if ((all_warmup_complete > NUM_CPUS) && (simulation_complete[i] == 0) && (ooo_cpu[i].num_retired >= (ooo_cpu[i].begin_sim_instr + ooo_cpu[i].simulation_instructions)))
+      if (!sampler && (all_warmup_complete > NUM_CPUS) && (simulation_complete[i] == 0) && (ooo_cpu[i].num_retired >= (ooo_cpu[i].begin_sim_instr + ooo_cpu[i].simulation_instructions)))
       {
         simulation_complete[i] = 1;
         ooo_cpu[i].finish_sim_instr = ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr;
         ooo_cpu[i].finish_sim_cycle = current_core_cycle[i] - ooo_cpu[i].begin_sim_cycle;
+        ooo_cpu[i].roi_branch_mispredictions = ooo_cpu[i].branch_mispredictions;
 
         cout << "Finished CPU " << i << " instructions: " << ooo_cpu[i].finish_sim_instr << " cycles: " << ooo_cpu[i].finish_sim_cycle;
         cout << " cumulative IPC: " << ((float)ooo_cpu[i].finish_sim_instr / ooo_cpu[i].finish_sim_cycle);
@@ -1024,6 +1476,34 @@ int main(int argc, char **argv)
         run_simulation = 0;
     }
 
+    // sampling: once every core has measured its window, stop or fast-forward to the next one
+    if (sampler && (all_warmup_complete > NUM_CPUS) && sampler->round_done())
+    {
+      if (sampler->converged() || sampler->roi_done())
+      {
+        for (uint32_t i = 0; i < NUM_CPUS; i++)
+        {
+          // the ROI numbers are the sum of the measured windows
+          simulation_complete[i] = 1;
+          ooo_cpu[i].finish_sim_instr = sampler->detail_instr[i];
+          ooo_cpu[i].finish_sim_cycle = sampler->detail_cycle[i];
+
+          cout << "Finished CPU " << i << " sampled instructions: " << ooo_cpu[i].finish_sim_instr << " cycles: " << ooo_cpu[i].finish_sim_cycle;
+          cout << " cumulative IPC: " << ((float)ooo_cpu[i].finish_sim_instr / ooo_cpu[i].finish_sim_cycle) << endl;
+
+          sampler->record_roi_stats(i);
+
+          all_simulation_complete++;
+        }
+        run_simulation = 0;
+      }
+      else if (sampler->drained())
+      {
+        functional_warm(sampler->skip());
+        sampler->start();
+      }
+    }
+
     // TODO: should it be backward?
     uncore.cycle++;
     if (uncore.cycle >= uncore.DRAM.next_bw_measure_cycle)
@@ -1088,12 +1568,13 @@ int main(int argc, char **argv)
     cout << endl
          << "CPU " << i << " cumulative IPC: " << ((float)ooo_cpu[i].finish_sim_instr / ooo_cpu[i].finish_sim_cycle);
     cout << " instructions: " << ooo_cpu[i].finish_sim_instr << " cycles: " << ooo_cpu[i].finish_sim_cycle << endl;
+    auto roi = [&](CACHE *cache) { return sampler ? cache->roi_delta[i] : cache->roi_stats(i); };
 #ifndef CRC2_COMPILE
-    print_roi_stats(i, &ooo_cpu[i].L1D);
-    print_roi_stats(i, &ooo_cpu[i].L1I);
-    print_roi_stats(i, &ooo_cpu[i].L2C);
+    print_roi_stats(i, &ooo_cpu[i].L1D, roi(&ooo_cpu[i].L1D));
+    print_roi_stats(i, &ooo_cpu[i].L1I, roi(&ooo_cpu[i].L1I));
+    print_roi_stats(i, &ooo_cpu[i].L2C, roi(&ooo_cpu[i].L2C));
 #endif
-    print_roi_stats(i, &uncore.LLC);
+    print_roi_stats(i, &uncore.LLC, roi(&uncore.LLC));
     cout << "Major fault: " << major_fault[i] << " Minor fault: " << minor_fault[i] << endl;
     cout << "L1D WB Stall Cycle: " << ooo_cpu[i].L1D.STALL[RFO] << endl;
   }
@@ -1107,11 +1588,68 @@ int main(int argc, char **argv)
 
   uncore.LLC.llc_prefetcher_final_stats();
 
+  uint64_t total_instructions = 0;
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    // the profilers only count the measured windows of -sample
+    uint64_t instructions = sampler ? sampler->detail_instr[i] : ooo_cpu[i].num_retired - ooo_cpu[i].begin_sim_instr;
+    total_instructions += instructions;
+    if (ooo_cpu[i].L2C.mrc)
+      ooo_cpu[i].L2C.mrc->print(instructions, L2C_SET * L2C_WAY);
+  }
+  if (uncore.LLC.mrc)
+    uncore.LLC.mrc->print(total_instructions, LLC_SET * LLC_WAY);
+  if (uncore.LLC.shadow)
+  {
+    uint64_t access[NUM_TYPES] = {}, miss[NUM_TYPES] = {};
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+      for (uint32_t j = 0; j < NUM_TYPES; j++)
+      {
+        access[j] += sampler ? uncore.LLC.roi_delta[i].access[j] : uncore.LLC.sim_access[i][j];
+        miss[j] += sampler ? uncore.LLC.roi_delta[i].miss[j] : uncore.LLC.sim_miss[i][j];
+      }
+    uncore.LLC.shadow->print(total_instructions, access, miss);
+  }
+
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+    if (region_analyzer[i])
+      region_analyzer[i]->print();
+
+  if (sampler)
+  {
+    cout << endl
+         << "Sampled Simulation Statistics" << endl;
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+      sampler->print_stats(i);
+  }
+
+  if (summary.size())
+    write_summary(summary);
+
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+  {
+    if (l1d_capture[i])
+    {
+      cout << "CPU " << i << " captured " << l1d_capture[i]->records << " L1D records" << endl;
+      delete l1d_capture[i];
+    }
+    if (l1d_replay[i])
+      cout << "CPU " << i << " replayed " << l1d_replay[i]->injected << " loads, RQ full for " << l1d_replay[i]->stall_cycles << " cycles" << endl;
+  }
+
 #ifndef CRC2_COMPILE
+  for (uint32_t i = 0; i < NUM_CPUS; i++)
+    ooo_cpu[i].L2C.replacement_final_stats();
   uncore.LLC.llc_replacement_final_stats();
   print_dram_stats();
   print_branch_stats();
 #endif
 
+  if (latency_trace.enabled)
+  {
+    latency_trace.print_stats();
+    latency_trace.write();
+  }
+
   return 0;
 }
@@ -0,0 +1,126 @@
+#include "mrc.h"
+#include "common.h"
+
+#define MRC_HASH_BITS 24
+#define MRC_MIN_TREE (1 << 20)
+#define MRC_BUCKETS (16 + 60 * 8)
+
+MRCProfiler::MRCProfiler(const string &name, double rate)
+    : name(name), threshold(rate * (1 << MRC_HASH_BITS)), rate(rate), tree(MRC_MIN_TREE, 0), hist(MRC_BUCKETS, 0)
+{
+    assert(rate > 0 && rate <= 1);
+}
+
+uint32_t MRCProfiler::bucket(uint64_t distance)
+{
+    if (distance < 16)
+        return distance;
+    int octave = 63 - __builtin_clzll(distance);
+    return 16 + (octave - 4) * 8 + ((distance >> (octave - 3)) & 7);
+}
+
+uint64_t MRCProfiler::bucket_start(uint32_t index)
+{
+    if (index < 16)
+        return index;
+    int octave = (index - 16) / 8 + 4;
+    return (uint64_t)(8 + (index - 16) % 8) << (octave - 3);
+}
+
+void MRCProfiler::mark(uint64_t time, int delta)
+{
+    for (uint64_t i = time; i < tree.size(); i += i & -i)
+        tree[i] += delta;
+}
+
+uint64_t MRCProfiler::marked_up_to(uint64_t time)
+{
+    uint64_t count = 0;
+    for (uint64_t i = time; i > 0; i -= i & -i)
+        count += tree[i];
+    return count;
+}
+
+// renumber the live blocks 1..n in access order when the timestamps run out
+void MRCProfiler::compact()
+{
+    vector<pair<uint64_t, uint64_t>> live; // (time, block)
+    live.reserve(last_access.size());
+    for (auto &entry : last_access)
+        live.push_back(make_pair(entry.second, entry.first));
+    sort(live.begin(), live.end());
+
+    tree.assign(max((size_t)MRC_MIN_TREE, 4 * live.size()), 0);
+    for (uint64_t i = 0; i < live.size(); i++) {
+        last_access[live[i].second] = i + 1;
+        mark(i + 1, 1);
+    }
+    now = live.size();
+}
+
+void MRCProfiler::access(uint64_t block, uint8_t type)
+{
+    if (rate < 1 && ((get_hash(block) >> 16) & ((1 << MRC_HASH_BITS) - 1)) >= threshold)
+        return;
+
+    if (now + 1 >= tree.size())
+        compact();
+
+    uint64_t distance = UINT64_MAX;
+    unordered_map<uint64_t, uint64_t>::iterator last = last_access.find(block);
+    if (last != last_access.end()) {
+        distance = marked_up_to(now) - marked_up_to(last->second);
+        mark(last->second, -1);
+    }
+    now++;
+    mark(now, 1);
+    last_access[block] = now;
+
+    if (!counting)
+        return;
+    sampled++;
+    if (type != LOAD && type != RFO)
+        return;
+    demand++;
+    if (distance == UINT64_MAX)
+        cold++;
+    else
+        hist[bucket(distance / rate)]++;
+}
+
+void MRCProfiler::reset_stats()
+{
+    fill(hist.begin(), hist.end(), 0);
+    cold = demand = sampled = 0;
+}
+
+void MRCProfiler::print(uint64_t instructions, uint64_t configured_blocks)
+{
+    cout << endl << name << " miss-ratio curve (fully-associative LRU, sampling rate " << rate << ")" << endl;
+    cout << name << " MRC demand accesses: " << (uint64_t)(demand / rate) << " cold misses: " << (uint64_t)(cold / rate)
+         << " tracked blocks: " << last_access.size() << endl;
+    if (!demand)
+        return;
+
+    streamsize precision = cout.precision();
+
+    // misses at capacity C: cold misses plus every distance >= C
+    vector<uint64_t> misses(MRC_BUCKETS + 1, cold);
+    uint32_t last = 0;
+    for (int i = MRC_BUCKETS - 1; i >= 0; i--) {
+        misses[i] = misses[i + 1] + hist[i];
+        if (hist[i] && !last)
+            last = i + 1;
+    }
+
+    for (uint32_t i = bucket(16 * 1024 / BLOCK_SIZE); i <= last && i < MRC_BUCKETS; i++) {
+        uint64_t capacity = bucket_start(i);
+        if ((i - 16) % 4 != 0) // powers of two and the 1.5x points between them
+            continue;
+        cout << name << " MRC capacity: " << setw(8) << capacity * BLOCK_SIZE / 1024 << " KB  miss_ratio: " << fixed
+             << setprecision(4) << (double)misses[i] / demand << "  MPKI: " << setprecision(3)
+             << (instructions ? misses[i] / rate * 1000 / instructions : 0) << defaultfloat
+             << (capacity == configured_blocks ? "  <- configured" : "") << endl;
+    }
+    cout.precision(precision);
+}
@@ -26,6 +26,280 @@ void O3_CPU::broadcast_ipc(uint8_t ipc)
     L2C.broadcast_ipc(ipc);
 }
 
+/**
+ * @brief Derives the branch type of a trace instruction from the registers it reads and
+ * writes, and marks the unconditional kinds as taken branches.
+ */
+static uint8_t decode_branch_type(const input_instr &instr, uint8_t &is_branch, uint8_t &branch_taken)
+{
+  bool reads_sp = false;
+  bool writes_sp = false;
+  bool reads_flags = false;
+  bool reads_ip = false;
+  bool writes_ip = false;
+  bool reads_other = false;
+
+  for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++)
+  {
+    switch (instr.destination_registers[i])
+    {
+    case 0:
+      break;
+    case REG_STACK_POINTER:
+      writes_sp = true;
+      break;
+    case REG_INSTRUCTION_POINTER:
+      writes_ip = true;
+      break;
+    default:
+      break;
+    }
+  }
+
+  for (int i = 0; i < NUM_INSTR_SOURCES; i++)
+  {
+    switch (instr.source_registers[i])
+    {
+    case 0:
+      break;
+    case REG_STACK_POINTER:
+      reads_sp = true;
+      break;
+    case REG_FLAGS:
+      reads_flags = true;
+      break;
+    case REG_INSTRUCTION_POINTER:
+      reads_ip = true;
+      break;
+    default:
+      reads_other = true;
+      break;
+    }
+  }
+
+  uint8_t branch_type = NOT_BRANCH;
+  if (!reads_sp && !reads_flags && writes_ip && !reads_other)
+  {
+    // direct jump
+    is_branch = 1;
+    branch_taken = 1;
+    branch_type = BRANCH_DIRECT_JUMP;
+  }
+  else if (!reads_sp && !reads_flags && writes_ip && reads_other)
+  {
+    // indirect branch
+    is_branch = 1;
+    branch_taken = 1;
+    branch_type = BRANCH_INDIRECT;
+  }
+  else if (!reads_sp && reads_ip && !writes_sp && writes_ip && reads_flags && !reads_other)
+  {
+    // conditional branch
+    is_branch = 1;
+    branch_type = BRANCH_CONDITIONAL;
+  }
+  else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && !reads_other)
+  {
+    // direct call
+    is_branch = 1;
+    branch_taken = 1;
+    branch_type = BRANCH_DIRECT_CALL;
+  }
+  else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && reads_other)
+  {
+    // indirect call
+    is_branch = 1;
+    branch_taken = 1;
+    branch_type = BRANCH_INDIRECT_CALL;
+  }
+  else if (reads_sp && !reads_ip && writes_sp && writes_ip)
+  {
+    // return
+    is_branch = 1;
+    branch_taken = 1;
+    branch_type = BRANCH_RETURN;
+  }
+  else if (writes_ip)
+  {
+    // some other branch type that doesn't fit the above categories
+    is_branch = 1;
+    branch_type = BRANCH_OTHER;
+  }
+
+  return branch_type;
+}
+
+void O3_CPU::reopen_trace()
+{
+  cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl;
+
+  // close the trace file and re-open it
+  pclose(trace_file);
+  trace_file = popen(gunzip_command, "r");
+  if (trace_file == NULL)
+  {
+    cerr << endl
+         << "*** CANNOT REOPEN TRACE FILE: " << trace_string << " ***" << endl;
+    assert(0);
+  }
+}
+
+/**
+ * @brief Reads the next instruction of a standard trace. With the oracle L1D
+ * prefetcher on, the file is read oracle_lookahead instructions ahead and the
+ * window's memory footprint is kept up to date; the window wraps around the
+ * end of the trace itself, so it never reports end of file.
+ */
+bool O3_CPU::next_trace_instr(input_instr *instr)
+{
+  if (!oracle_lookahead)
+    return fread(instr, sizeof(input_instr), 1, trace_file);
+
+  while (oracle_window.size() <= oracle_lookahead)
+  {
+    input_instr ahead;
+    if (!fread(&ahead, sizeof(input_instr), 1, trace_file))
+    {
+      reopen_trace();
+      continue;
+    }
+    oracle_window.push_back(ahead);
+    track_footprint(ahead, 1);
+  }
+
+  *instr = oracle_window.front();
+  oracle_window.pop_front();
+  track_footprint(*instr, -1);
+  return true;
+}
+
+void O3_CPU::track_footprint(const input_instr &instr, int delta)
+{
+  for (uint32_t i = 0; i < NUM_INSTR_SOURCES + NUM_INSTR_DESTINATIONS; i++)
+  {
+    uint64_t v_addr = i < NUM_INSTR_SOURCES ? instr.source_memory[i] : instr.destination_memory[i - NUM_INSTR_SOURCES];
+    if (v_addr == 0)
+      continue;
+
+    vector<uint32_t> &counts = oracle_footprint[v_addr >> LOG2_PAGE_SIZE];
+    if (counts.empty())
+      counts.resize(PAGE_SIZE / BLOCK_SIZE + 1); // the last counter is the page total
+    counts[(v_addr >> LOG2_BLOCK_SIZE) & (PAGE_SIZE / BLOCK_SIZE - 1)] += delta;
+    counts.back() += delta;
+    if (counts.back() == 0)
+      oracle_footprint.erase(v_addr >> LOG2_PAGE_SIZE);
+  }
+}
+
+/**
+ * @return one bit per block of the page of v_addr that an instruction in the
+ * oracle window will access
+ */
+uint64_t O3_CPU::future_footprint(uint64_t v_addr)
+{
+  map<uint64_t, vector<uint32_t>>::iterator region = oracle_footprint.find(v_addr >> LOG2_PAGE_SIZE);
+  if (region == oracle_footprint.end())
+    return 0;
+
+  uint64_t footprint = 0;
+  for (uint32_t i = 0; i < PAGE_SIZE / BLOCK_SIZE; i++)
+    if (region->second[i])
+      footprint |= 1ull << i;
+  return footprint;
+}
+
+/**
+ * @brief Functionally executes the next trace instruction for the fast-forward
+ * part of the warmup: trains the branch predictor, translates through the DTLB
+ * and walks the caches and prefetchers with warm_access, without timing.
+ */
+void O3_CPU::warm_instruction()
+{
+  input_instr trace_read_instr;
+  while (!next_trace_instr(&trace_read_instr))
+    reopen_trace();
+
+  // keep the same one-instruction lookahead as read_from_trace
+  if (instr_unique_id == 0)
+  {
+    current_instr = trace_read_instr;
+    next_instr = trace_read_instr;
+  }
+  else
+  {
+    current_instr = next_instr;
+    next_instr = trace_read_instr;
+  }
+
+  uint8_t is_branch = current_instr.is_branch, branch_taken = current_instr.branch_taken;
+  uint8_t branch_type = decode_branch_type(current_instr, is_branch, branch_taken);
+  total_branch_types[branch_type]++;
+  if (is_branch)
+  {
+    num_branch++;
+    uint8_t branch_prediction = knob_perfect_branch ? branch_taken : predict_branch(current_instr.ip);
+    if (branch_prediction != branch_taken)
+      branch_mispredictions++;
+    l1i_prefetcher_branch_operate(current_instr.ip, branch_type, (branch_prediction && branch_taken) ? next_instr.ip : 0);
+    if (!knob_perfect_branch)
+      last_branch_result(current_instr.ip, branch_taken);
+  }
+
+  // instructions are translated magically, as in add_to_ifetch_buffer
+  uint64_t instr_pa = va_to_pa(cpu, instr_unique_id, current_instr.ip, current_instr.ip >> LOG2_PAGE_SIZE, 1);
+  instr_pa = ((instr_pa >> LOG2_PAGE_SIZE) << LOG2_PAGE_SIZE) | (current_instr.ip & ((1 << LOG2_PAGE_SIZE) - 1));
+
+  PACKET fetch_packet;
+  fetch_packet.instruction = 1;
+  fetch_packet.is_data = 0;
+  fetch_packet.fill_level = FILL_L1;
+  fetch_packet.fill_l1i = 1;
+  fetch_packet.cpu = cpu;
+  fetch_packet.address = instr_pa >> LOG2_BLOCK_SIZE;
+  fetch_packet.full_addr = instr_pa;
+  fetch_packet.instr_id = instr_unique_id;
+  fetch_packet.ip = current_instr.ip;
+  fetch_packet.type = LOAD;
+  L1I.warm_access(&fetch_packet);
+
+  for (int i = 0; i < NUM_INSTR_SOURCES + MAX_INSTR_DESTINATIONS; i++)
+  {
+    bool is_load = i < NUM_INSTR_SOURCES;
+    uint64_t va = is_load ? current_instr.source_memory[i] : current_instr.destination_memory[i - NUM_INSTR_SOURCES];
+    if (va == 0)
+      continue;
+
+    PACKET tlb_packet;
+    tlb_packet.fill_level = FILL_L1;
+    tlb_packet.cpu = cpu;
+    tlb_packet.address = va >> LOG2_PAGE_SIZE;
+    tlb_packet.full_addr = va;
+    tlb_packet.instr_id = instr_unique_id;
+    tlb_packet.ip = current_instr.ip;
+    tlb_packet.type = is_load ? LOAD : RFO;
+    uint64_t pa = (DTLB.warm_access(&tlb_packet) << LOG2_PAGE_SIZE) | (va & ((1 << LOG2_PAGE_SIZE) - 1));
+
+    PACKET data_packet;
+    data_packet.fill_level = FILL_L1;
+    data_packet.fill_l1d = 1;
+    data_packet.cpu = cpu;
+    data_packet.address = pa >> LOG2_BLOCK_SIZE;
+    data_packet.v_full_addr = va;
+    data_packet.full_addr = pa;
+    data_packet.instr_id = instr_unique_id;
+    data_packet.ip = current_instr.ip;
+    data_packet.type = is_load ? LOAD : RFO;
+    L1D.warm_access(&data_packet);
+  }
+
+  // stand-in for a cycle so the prefetchers drain what they buffered
+  L1D.l1d_prefetcher_cycle_operate();
+  L2C.l2c_prefetcher_cycle_operate();
+
+  instr_unique_id++;
+  num_retired++;
+}
+
 void O3_CPU::read_from_trace()
 {
   // actual processors do not work like this but for easier implementation,
@@ -47,17 +321,7 @@ void O3_CPU::read_from_trace()
       if (!fread(&current_cloudsuite_instr, instr_size, 1, trace_file))
       {
         // reached end of file for this trace
-        cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl;
-
-        // close the trace file and re-open it
-        pclose(trace_file);
-        trace_file = popen(gunzip_command, "r");
-        if (trace_file == NULL)
-        {
-          cerr << endl
-               << "*** CANNOT REOPEN TRACE FILE: " << trace_string << " ***" << endl;
-          assert(0);
-        }
+        reopen_trace();
       }
       else
       { // successfully read the trace
@@ -136,7 +400,9 @@ void O3_CPU::read_from_trace()
             num_branch++;
 
             // handle branch prediction & branch predictor update
-            uint8_t branch_prediction = predict_branch(IFETCH_BUFFER.entry[ifetch_buffer_index].ip);
+            // -perfect_branch bypasses the predictor altogether
+            uint8_t branch_prediction = knob_perfect_branch ? IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken
+                                                            : predict_branch(IFETCH_BUFFER.entry[ifetch_buffer_index].ip);
 
             if (IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken != branch_prediction)
             {
@@ -159,7 +425,8 @@ void O3_CPU::read_from_trace()
               }
             }
 
-            last_branch_result(IFETCH_BUFFER.entry[ifetch_buffer_index].ip, IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken);
+            if (!knob_perfect_branch)
+              last_branch_result(IFETCH_BUFFER.entry[ifetch_buffer_index].ip, IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken);
           }
 
           if ((num_reads >= instrs_to_read_this_cycle) || (IFETCH_BUFFER.occupancy == IFETCH_BUFFER.SIZE))
@@ -171,20 +438,10 @@ void O3_CPU::read_from_trace()
     else
     {
       input_instr trace_read_instr;
-      if (!fread(&trace_read_instr, instr_size, 1, trace_file))
+      if (!next_trace_instr(&trace_read_instr))
       {
         // reached end of file for this trace
-        cout << "*** Reached end of trace for Core: " << cpu << " Repeating trace: " << trace_string << endl;
-
-        // close the trace file and re-open it
-        pclose(trace_file);
-        trace_file = popen(gunzip_command, "r");
-        if (trace_file == NULL)
-        {
-          cerr << endl
-               << "*** CANNOT REOPEN TRACE FILE: " << trace_string << " ***" << endl;
-          assert(0);
-        }
+        reopen_trace();
       }
       else
       { // successfully read the trace
@@ -212,33 +469,12 @@ void O3_CPU::read_from_trace()
         arch_instr.asid[0] = cpu;
         arch_instr.asid[1] = cpu;
 
-        bool reads_sp = false;
-        bool writes_sp = false;
-        bool reads_flags = false;
-        bool reads_ip = false;
-        bool writes_ip = false;
-        bool reads_other = false;
-
         for (uint32_t i = 0; i < MAX_INSTR_DESTINATIONS; i++)
         {
           arch_instr.destination_registers[i] = current_instr.destination_registers[i];
           arch_instr.destination_memory[i] = current_instr.destination_memory[i];
           arch_instr.destination_virtual_address[i] = current_instr.destination_memory[i];
 
-          switch (arch_instr.destination_registers[i])
-          {
-          case 0:
-            break;
-          case REG_STACK_POINTER:
-            writes_sp = true;
-            break;
-          case REG_INSTRUCTION_POINTER:
-            writes_ip = true;
-            break;
-          default:
-            break;
-          }
-
           /*
 		    if((arch_instr.is_branch) && (arch_instr.destination_registers[i] > 24) && (arch_instr.destination_registers[i] < 28))
 		      {
@@ -277,24 +513,6 @@ void O3_CPU::read_from_trace()
           arch_instr.source_memory[i] = current_instr.source_memory[i];
           arch_instr.source_virtual_address[i] = current_instr.source_memory[i];
 
-          switch (arch_instr.source_registers[i])
-          {
-          case 0:
-            break;
-          case REG_STACK_POINTER:
-            reads_sp = true;
-            break;
-          case REG_FLAGS:
-            reads_flags = true;
-            break;
-          case REG_INSTRUCTION_POINTER:
-            reads_ip = true;
-            break;
-          default:
-            reads_other = true;
-            break;
-          }
-
           /*
 		    if((!arch_instr.is_branch) && (arch_instr.source_registers[i] > 25) && (arch_instr.source_registers[i] < 28))
 		      {
@@ -314,55 +532,7 @@ void O3_CPU::read_from_trace()
           arch_instr.is_memory = 1;
 
         // determine what kind of branch this is, if any
-        if (!reads_sp && !reads_flags && writes_ip && !reads_other)
-        {
-          // direct jump
-          arch_instr.is_branch = 1;
-          arch_instr.branch_taken = 1;
-          arch_instr.branch_type = BRANCH_DIRECT_JUMP;
-        }
-        else if (!reads_sp && !reads_flags && writes_ip && reads_other)
-        {
-          // indirect branch
-          arch_instr.is_branch = 1;
-          arch_instr.branch_taken = 1;
-          arch_instr.branch_type = BRANCH_INDIRECT;
-        }
-        else if (!reads_sp && reads_ip && !writes_sp && writes_ip && reads_flags && !reads_other)
-        {
-          // conditional branch
-          arch_instr.is_branch = 1;
-          arch_instr.branch_taken = arch_instr.branch_taken; // don't change this
-          arch_instr.branch_type = BRANCH_CONDITIONAL;
-        }
-        else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && !reads_other)
-        {
-          // direct call
-          arch_instr.is_branch = 1;
-          arch_instr.branch_taken = 1;
-          arch_instr.branch_type = BRANCH_DIRECT_CALL;
-        }
-        else if (reads_sp && reads_ip && writes_sp && writes_ip && !reads_flags && reads_other)
-        {
-          // indirect call
-          arch_instr.is_branch = 1;
-          arch_instr.branch_taken = 1;
-          arch_instr.branch_type = BRANCH_INDIRECT_CALL;
-        }
-        else if (reads_sp && !reads_ip && writes_sp && writes_ip)
-        {
-          // return
-          arch_instr.is_branch = 1;
-          arch_instr.branch_taken = 1;
-          arch_instr.branch_type = BRANCH_RETURN;
-        }
-        else if (writes_ip)
-        {
-          // some other branch type that doesn't fit the above categories
-          arch_instr.is_branch = 1;
-          arch_instr.branch_taken = arch_instr.branch_taken; // don't change this
-          arch_instr.branch_type = BRANCH_OTHER;
-        }
+        arch_instr.branch_type = decode_branch_type(current_instr, arch_instr.is_branch, arch_instr.branch_taken);
 
         total_branch_types[arch_instr.branch_type]++;
 
@@ -386,7 +556,9 @@ void O3_CPU::read_from_trace()
             num_branch++;
 
             // handle branch prediction & branch predictor update
-            uint8_t branch_prediction = predict_branch(IFETCH_BUFFER.entry[ifetch_buffer_index].ip);
+            // -perfect_branch bypasses the predictor altogether
+            uint8_t branch_prediction = knob_perfect_branch ? IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken
+                                                            : predict_branch(IFETCH_BUFFER.entry[ifetch_buffer_index].ip);
             uint64_t predicted_branch_target = IFETCH_BUFFER.entry[ifetch_buffer_index].branch_target;
             if (branch_prediction == 0)
             {
@@ -418,7 +590,8 @@ void O3_CPU::read_from_trace()
               }
             }
 
-            last_branch_result(IFETCH_BUFFER.entry[ifetch_buffer_index].ip, IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken);
+            if (!knob_perfect_branch)
+              last_branch_result(IFETCH_BUFFER.entry[ifetch_buffer_index].ip, IFETCH_BUFFER.entry[ifetch_buffer_index].branch_taken);
           }
 
           if ((num_reads >= instrs_to_read_this_cycle) || (IFETCH_BUFFER.occupancy == IFETCH_BUFFER.SIZE))
@@ -874,7 +1047,10 @@ int O3_CPU::prefetch_code_line(uint64_t pf_v_addr)
     pf_packet.type = PREFETCH;
     pf_packet.event_cycle = current_core_cycle[cpu];
 
-    L1I.add_pq(&pf_packet);
+    if (functional_warming)
+      L1I.warm_access(&pf_packet);
+    else
+      L1I.add_pq(&pf_packet);
     L1I.pf_issued++;
 
     return 1;
@@ -2094,7 +2270,7 @@ void O3_CPU::complete_instr_fetch(PACKET_QUEUE *queue, uint8_t is_it_tlb)
   // check if other instructions were merged
   if (queue->entry[index].instr_merged)
   {
-    ITERATE_SET(i, queue->entry[index].rob_index_depend_on_me, ROB_SIZE)
+    ITERATE_SET(i, queue->entry[index].rob_index_depend_on_me(), ROB_SIZE)
     {
       // update ROB entry
       if (is_it_tlb)
@@ -2333,7 +2509,7 @@ void O3_CPU::handle_merged_translation(PACKET *provider)
 {
   if (provider->store_merged)
   {
-    ITERATE_SET(merged, provider->sq_index_depend_on_me, SQ.SIZE)
+    ITERATE_SET(merged, provider->sq_index_depend_on_me(), SQ.SIZE)
     {
       SQ.entry[merged].translated = COMPLETED;
       SQ.entry[merged].physical_address = (provider->data_pa << LOG2_PAGE_SIZE) | (SQ.entry[merged].virtual_address & ((1 << LOG2_PAGE_SIZE) - 1)); // translated address
@@ -2352,7 +2528,7 @@ void O3_CPU::handle_merged_translation(PACKET *provider)
   }
   if (provider->load_merged)
   {
-    ITERATE_SET(merged, provider->lq_index_depend_on_me, LQ.SIZE)
+    ITERATE_SET(merged, provider->lq_index_depend_on_me(), LQ.SIZE)
     {
       LQ.entry[merged].translated = COMPLETED;
       LQ.entry[merged].physical_address = (provider->data_pa << LOG2_PAGE_SIZE) | (LQ.entry[merged].virtual_address & ((1 << LOG2_PAGE_SIZE) - 1)); // translated address
@@ -2377,7 +2553,7 @@ void O3_CPU::handle_merged_translation(PACKET *provider)
 
 void O3_CPU::handle_merged_load(PACKET *provider)
 {
-  ITERATE_SET(merged, provider->lq_index_depend_on_me, LQ.SIZE)
+  ITERATE_SET(merged, provider->lq_index_depend_on_me(), LQ.SIZE)
   {
     uint32_t merged_rob_index = LQ.entry[merged].rob_index;
 
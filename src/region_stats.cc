@@ -0,0 +1,190 @@
+#include "region_stats.h"
+#include "pmp.h"
+
+RegionAnalyzer *region_analyzer[NUM_CPUS];
+
+#define REGION_BLOCKS (1 << OFFSET_BITS)
+#define LIFETIME_BUCKETS 64
+
+// rotate right so bit n lands on bit 0, the my_rotate(pattern, -n) of the pattern tables
+static uint64_t anchor(uint64_t bits, uint32_t n, uint32_t len)
+{
+    uint64_t mask = len == 64 ? ~0ULL : (1ULL << len) - 1;
+    n %= len;
+    if (n == 0)
+        return bits;
+    return ((bits >> n) | (bits << (len - n))) & mask;
+}
+
+// pattern_degrade on a bitmap: bit i is set if any of bits [i * level, (i + 1) * level) is
+static uint64_t degrade(uint64_t bits, uint32_t level)
+{
+    uint64_t res = 0;
+    for (uint32_t i = 0; i < REGION_BLOCKS; i++)
+        if ((bits >> i) & 1)
+            res |= 1ULL << (i / level);
+    return res;
+}
+
+static vector<bool> to_pattern(uint64_t bits, uint32_t len)
+{
+    vector<bool> pattern(len);
+    for (uint32_t i = 0; i < len; i++)
+        pattern[i] = (bits >> i) & 1;
+    return pattern;
+}
+
+RegionAnalyzer::RegionAnalyzer(uint32_t cpu)
+    : cpu(cpu), opt_keys(1 << OFFSET_BITS), ppt_keys(1 << PC_BITS), popcount_hist(REGION_BLOCKS + 1, 0),
+      lifetime_hist(LIFETIME_BUCKETS, 0)
+{
+}
+
+void RegionAnalyzer::access(uint64_t addr, uint64_t ip, uint8_t type)
+{
+    // PMP trains on demand loads only
+    if (type != LOAD)
+        return;
+
+    uint64_t block = addr >> LOG2_BLOCK_SIZE, region = block >> OFFSET_BITS;
+    unordered_map<uint64_t, Generation>::iterator it = live.find(region);
+    if (it == live.end()) {
+        Generation generation;
+        generation.trigger = __fine_offset(block);
+        generation.pc = ip;
+        generation.start_cycle = current_core_cycle[cpu];
+        it = live.insert(make_pair(region, generation)).first;
+    }
+    it->second.footprint |= 1ULL << __fine_offset(block);
+    it->second.accesses++;
+}
+
+void RegionAnalyzer::eviction(uint64_t evicted_addr)
+{
+    uint64_t region = evicted_addr >> LOG2_BLOCK_SIZE >> OFFSET_BITS;
+    unordered_map<uint64_t, Generation>::iterator it = live.find(region);
+    if (it == live.end())
+        return;
+    end(it->second);
+    live.erase(it);
+}
+
+void RegionAnalyzer::add(KeyStats &stats, uint64_t footprint, uint32_t len)
+{
+    if (stats.generations)
+        stats.consecutive_similarity += jaccard_similarity(to_pattern(stats.last, len), to_pattern(footprint, len));
+    stats.generations++;
+    stats.popcount += count_bits(footprint);
+    stats.footprints[footprint]++;
+    stats.last = footprint;
+}
+
+void RegionAnalyzer::end(const Generation &generation)
+{
+    int popcount = count_bits(generation.footprint);
+    uint64_t lifetime = current_core_cycle[cpu] - generation.start_cycle;
+    generations++;
+    accesses += generation.accesses;
+    popcount_hist[popcount]++;
+    lifetime_hist[lifetime ? 63 - __builtin_clzll(lifetime) : 0]++;
+
+    // single-block generations are never inserted into the pattern tables
+    if (popcount == 1) {
+        single_block++;
+        return;
+    }
+
+    add(opt_keys[generation.trigger], anchor(generation.footprint, generation.trigger, REGION_BLOCKS), REGION_BLOCKS);
+
+    const uint32_t level = PATTERN_DEGRADE_LEVEL;
+    uint64_t ppt_key = hash_index(generation.pc, PC_BITS) & ((1 << PC_BITS) - 1);
+    add(ppt_keys[ppt_key], anchor(degrade(generation.footprint, level), generation.trigger / level, REGION_BLOCKS / level),
+        REGION_BLOCKS / level);
+}
+
+void RegionAnalyzer::reset_stats()
+{
+    fill(popcount_hist.begin(), popcount_hist.end(), 0);
+    fill(lifetime_hist.begin(), lifetime_hist.end(), 0);
+    generations = single_block = accesses = 0;
+    opt_keys.assign(opt_keys.size(), KeyStats());
+    ppt_keys.assign(ppt_keys.size(), KeyStats());
+}
+
+void RegionAnalyzer::print_keys(const string &table, const vector<KeyStats> &keys, uint32_t len)
+{
+    cout << "CPU " << cpu << " " << table << " key  generations  distinct  popcount  consecutive_jaccard  majority_jaccard" << endl;
+
+    uint64_t total = 0, distinct = 0, used = 0;
+    double consecutive = 0, majority = 0;
+    for (uint32_t key = 0; key < keys.size(); key++) {
+        const KeyStats &stats = keys[key];
+        if (!stats.generations)
+            continue;
+
+        // the pattern a merged entry would settle on: blocks set in at least half of the generations
+        vector<uint64_t> votes(len, 0);
+        for (auto &footprint : stats.footprints)
+            for (uint32_t i = 0; i < len; i++)
+                if ((footprint.first >> i) & 1)
+                    votes[i] += footprint.second;
+        uint64_t merged = 0;
+        for (uint32_t i = 0; i < len; i++)
+            if (2 * votes[i] >= stats.generations)
+                merged |= 1ULL << i;
+
+        double to_merged = 0;
+        for (auto &footprint : stats.footprints)
+            to_merged += footprint.second * jaccard_similarity(to_pattern(footprint.first, len), to_pattern(merged, len));
+
+        cout << "CPU " << cpu << " " << table << " " << setw(3) << key << "  " << setw(11) << stats.generations << "  "
+             << setw(8) << stats.footprints.size() << "  " << setw(8) << (double)stats.popcount / stats.generations << "  "
+             << setw(19) << (stats.generations > 1 ? stats.consecutive_similarity / (stats.generations - 1) : 1) << "  "
+             << setw(16) << to_merged / stats.generations << endl;
+
+        used++;
+        total += stats.generations;
+        distinct += stats.footprints.size();
+        consecutive += stats.consecutive_similarity;
+        majority += to_merged;
+    }
+    if (!total)
+        return;
+    cout << "CPU " << cpu << " " << table << " keys used: " << used << " distinct footprints per key: " << (double)distinct / used
+         << " consecutive_jaccard: " << consecutive / max(total - used, (uint64_t)1) << " majority_jaccard: " << majority / total
+         << endl;
+}
+
+void RegionAnalyzer::print()
+{
+    uint64_t truncated = live.size();
+    for (auto &generation : live)
+        end(generation.second);
+    live.clear();
+
+    cout << endl
+         << "CPU " << cpu << " region generations: " << generations << " single-block: " << single_block
+         << " still live at the end: " << truncated << endl;
+    if (!generations)
+        return;
+    cout << "CPU " << cpu << " region accesses per generation: " << (double)accesses / generations << endl;
+
+    cout << "CPU " << cpu << " region popcount:";
+    for (uint32_t low = 1; low <= REGION_BLOCKS; low <<= 1) {
+        uint32_t high = min(2 * low - 1, (uint32_t)REGION_BLOCKS);
+        uint64_t count = 0;
+        for (uint32_t pop = low; pop <= high; pop++)
+            count += popcount_hist[pop];
+        cout << " " << low << (high > low ? "-" + to_string(high) : "") << ": " << 100.0 * count / generations << "%";
+    }
+    cout << endl;
+
+    cout << "CPU " << cpu << " region lifetime (cycles):";
+    for (uint32_t i = 0; i < LIFETIME_BUCKETS; i++)
+        if (lifetime_hist[i])
+            cout << " 2^" << i << ": " << 100.0 * lifetime_hist[i] / generations << "%";
+    cout << endl;
+
+    print_keys("OPT", opt_keys, REGION_BLOCKS);
+    print_keys("PPT", ppt_keys, REGION_BLOCKS / PATTERN_DEGRADE_LEVEL);
+}
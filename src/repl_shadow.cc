@@ -0,0 +1,113 @@
+#include "repl_shadow.h"
+
+ReplacementShadow::ReplacementShadow(const vector<string> &names, uint32_t sets, uint32_t ways, uint32_t sampled_sets)
+    : sets(sets), ways(ways), slot(sets, -1)
+{
+    assert(sampled_sets > 0 && sampled_sets <= sets);
+
+    // pseudo-random sets, so that strided access patterns do not all land in or out of the sample
+    uint64_t seed = 0x5eed;
+    while (sampled.size() < sampled_sets) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t set = (seed >> 33) % sets;
+        if (slot[set] >= 0)
+            continue;
+        slot[set] = sampled.size();
+        sampled.push_back(set);
+    }
+
+    for (auto &name : names) {
+        Shadow shadow;
+        shadow.name = name;
+        shadow.policy = Replacement::make_policy(name, sets, ways, sampled);
+        assert(shadow.policy);
+        shadow.blocks.resize(sampled.size() * ways);
+        shadows.push_back(shadow);
+    }
+}
+
+void ReplacementShadow::access(uint32_t set, const PACKET &packet)
+{
+    if (slot[set] < 0)
+        return;
+
+    for (auto &shadow : shadows) {
+        BLOCK *current_set = &shadow.blocks[slot[set] * ways];
+        if (counting)
+            shadow.access[packet.type]++;
+
+        uint32_t way = 0;
+        while (way < ways && !(current_set[way].valid && current_set[way].address == packet.address))
+            way++;
+        if (way < ways) {
+            shadow.policy->update_replacement_state(packet.cpu, set, way, packet.full_addr, packet.ip, 0, packet.type, 1);
+            if (packet.type != PREFETCH && packet.type != WRITEBACK)
+                current_set[way].prefetch = 0;
+            continue;
+        }
+
+        if (counting)
+            shadow.miss[packet.type]++;
+        way = shadow.policy->find_victim(packet.cpu, packet.instr_id, set, current_set, packet.ip, packet.full_addr, packet.type);
+        if (way == ways) {
+            // bypass, as with LLC_BYPASS
+            if (counting)
+                shadow.bypass++;
+            shadow.policy->update_replacement_state(packet.cpu, set, way, packet.full_addr, packet.ip, 0, packet.type, 0);
+            continue;
+        }
+        assert(way < ways);
+
+        BLOCK &block = current_set[way];
+        shadow.policy->update_replacement_state(packet.cpu, set, way, packet.full_addr, packet.ip, block.full_addr, packet.type, 0);
+        block.valid = 1;
+        block.address = packet.address;
+        block.full_addr = packet.full_addr;
+        block.ip = packet.ip;
+        block.cpu = packet.cpu;
+        block.prefetch = packet.type == PREFETCH;
+        block.pf_metadata = packet.pf_metadata;
+    }
+}
+
+void ReplacementShadow::reset_stats()
+{
+    for (auto &shadow : shadows) {
+        fill(shadow.access, shadow.access + NUM_TYPES, 0);
+        fill(shadow.miss, shadow.miss + NUM_TYPES, 0);
+        shadow.bypass = 0;
+    }
+}
+
+// total and demand miss rates, and the demand MPKI of the whole LLC when counts cover `scale`-th of it
+static void print_rates(const string &name, const uint64_t access[NUM_TYPES], const uint64_t miss[NUM_TYPES], double scale,
+                        uint64_t instructions)
+{
+    uint64_t total_access = 0, total_miss = 0;
+    for (uint32_t i = 0; i < NUM_TYPES; i++) {
+        total_access += access[i];
+        total_miss += miss[i];
+    }
+    uint64_t demand_access = access[LOAD] + access[RFO], demand_miss = miss[LOAD] + miss[RFO];
+
+    cout << "LLC shadow " << setw(10) << name << "  ACCESS: " << setw(10) << total_access << "  MISS: " << setw(10)
+         << total_miss << fixed << setprecision(4) << "  miss_rate: " << (total_access ? (double)total_miss / total_access : 0)
+         << "  demand_miss_rate: " << (demand_access ? (double)demand_miss / demand_access : 0) << setprecision(3)
+         << "  demand_MPKI: " << (instructions ? demand_miss * scale * 1000 / instructions : 0) << defaultfloat;
+}
+
+void ReplacementShadow::print(uint64_t instructions, const uint64_t actual_access[NUM_TYPES],
+                              const uint64_t actual_miss[NUM_TYPES])
+{
+    streamsize precision = cout.precision();
+
+    cout << endl << "LLC shadow replacement: " << sampled.size() << " of " << sets << " sets sampled" << endl;
+    for (auto &shadow : shadows) {
+        print_rates(shadow.name, shadow.access, shadow.miss, (double)sets / sampled.size(), instructions);
+        cout << "  bypass: " << shadow.bypass << endl;
+    }
+    print_rates("(actual)", actual_access, actual_miss, 1, instructions);
+    cout << endl;
+
+    cout.precision(precision);
+}
@@ -0,0 +1,144 @@
+#include "sampling.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+static uint64_t llc_demand_misses(uint32_t cpu)
+{
+    return uncore.LLC.sim_miss[cpu][LOAD] + uncore.LLC.sim_miss[cpu][RFO];
+}
+
+static CACHE *sampled_cache(uint32_t cpu, int i)
+{
+    CACHE *caches[SAMPLED_CACHES] = {&ooo_cpu[cpu].L1D, &ooo_cpu[cpu].L1I, &ooo_cpu[cpu].L2C, &uncore.LLC};
+    return caches[i];
+}
+
+SMARTSSampler::SMARTSSampler(uint64_t period, uint64_t warmup, uint64_t window, double error, uint64_t min_samples)
+    : period(period), warmup(warmup), window(window), min_samples(min_samples), error(error)
+{
+    if (window == 0 || warmup + window > period) {
+        cerr << "-sample_period " << period << " cannot hold -sample_warmup " << warmup << " + -sample_window " << window << endl;
+        assert(0);
+    }
+}
+
+void SMARTSSampler::start()
+{
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+        window_start[i] = ooo_cpu[i].num_retired + warmup;
+        window_end[i] = window_start[i] + window;
+        measuring[i] = measured[i] = false;
+        update_profile_counting(i);
+    }
+}
+
+void SMARTSSampler::operate(uint32_t cpu)
+{
+    O3_CPU &core = ooo_cpu[cpu];
+    if (measured[cpu])
+        return;
+
+    if (!measuring[cpu] && core.num_retired >= window_start[cpu]) {
+        measuring[cpu] = true;
+        begin_instr[cpu] = core.num_retired;
+        begin_cycle[cpu] = current_core_cycle[cpu];
+        begin_mispredictions[cpu] = core.branch_mispredictions;
+        begin_llc_miss[cpu] = llc_demand_misses(cpu);
+        for (int i = 0; i < SAMPLED_CACHES; i++)
+            window_begin[cpu][i] = sampled_cache(cpu, i)->live_stats(cpu);
+        update_profile_counting(cpu);
+    }
+    else if (measuring[cpu] && core.num_retired >= window_end[cpu]) {
+        measuring[cpu] = false;
+        measured[cpu] = true;
+
+        uint64_t instr = core.num_retired - begin_instr[cpu], cycle = current_core_cycle[cpu] - begin_cycle[cpu];
+        detail_instr[cpu] += instr;
+        detail_cycle[cpu] += cycle;
+        detail_mispredictions[cpu] += core.branch_mispredictions - begin_mispredictions[cpu];
+        cpi[cpu].add(1.0 * cycle / instr);
+        branch_mpki[cpu].add(1000.0 * (core.branch_mispredictions - begin_mispredictions[cpu]) / instr);
+        llc_mpki[cpu].add(1000.0 * (llc_demand_misses(cpu) - begin_llc_miss[cpu]) / instr);
+        for (int i = 0; i < SAMPLED_CACHES; i++)
+            sampled_cache(cpu, i)->roi_delta[cpu].add(window_begin[cpu][i], sampled_cache(cpu, i)->live_stats(cpu));
+        update_profile_counting(cpu);
+    }
+}
+
+void SMARTSSampler::update_profile_counting(uint32_t cpu)
+{
+    if (ooo_cpu[cpu].L2C.mrc)
+        ooo_cpu[cpu].L2C.mrc->counting = measuring[cpu];
+
+    // the shared LLC counts while any core is in its window
+    bool any = false;
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+        any |= measuring[i];
+    if (uncore.LLC.mrc)
+        uncore.LLC.mrc->counting = any;
+    if (uncore.LLC.shadow)
+        uncore.LLC.shadow->counting = any;
+}
+
+bool SMARTSSampler::round_done() const
+{
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+        if (!measured[i])
+            return false;
+    return true;
+}
+
+bool SMARTSSampler::converged() const
+{
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+        if (cpi[i].n < min_samples || cpi[i].half_width() > error * cpi[i].mean())
+            return false;
+    return true;
+}
+
+bool SMARTSSampler::roi_done() const
+{
+    for (uint32_t i = 0; i < NUM_CPUS; i++)
+        if (ooo_cpu[i].num_retired + period > ooo_cpu[i].begin_sim_instr + ooo_cpu[i].simulation_instructions)
+            return true;
+    return false;
+}
+
+bool SMARTSSampler::drained() const
+{
+    if (!uncore.LLC.drained())
+        return false;
+    for (uint32_t i = 0; i < NUM_CPUS; i++) {
+        O3_CPU &core = ooo_cpu[i];
+        if (core.IFETCH_BUFFER.occupancy || core.DECODE_BUFFER.occupancy || core.ROB.occupancy)
+            return false;
+        if (!core.ITLB.drained() || !core.DTLB.drained() || !core.STLB.drained() || !core.L1I.drained() ||
+            !core.L1D.drained() || !core.L2C.drained())
+            return false;
+    }
+    return true;
+}
+
+void SMARTSSampler::record_roi_stats(uint32_t cpu)
+{
+    for (int i = 0; i < SAMPLED_CACHES; i++) {
+        CACHE *cache = sampled_cache(cpu, i);
+        for (uint32_t j = 0; j < NUM_TYPES; j++) {
+            cache->roi_access[cpu][j] = cache->roi_delta[cpu].access[j];
+            cache->roi_hit[cpu][j] = cache->roi_delta[cpu].hit[j];
+            cache->roi_miss[cpu][j] = cache->roi_delta[cpu].miss[j];
+        }
+    }
+    ooo_cpu[cpu].roi_branch_mispredictions = detail_mispredictions[cpu];
+}
+
+void SMARTSSampler::print_stats(uint32_t cpu)
+{
+    double ipc = 1 / cpi[cpu].mean(), ipc_error = cpi[cpu].half_width() / cpi[cpu].mean();
+    cout << "CPU " << cpu << " SAMPLED WINDOWS: " << cpi[cpu].n << "  DETAILED INSTRUCTIONS: " << detail_instr[cpu]
+         << "  COVERED INSTRUCTIONS: " << ooo_cpu[cpu].num_retired - ooo_cpu[cpu].begin_sim_instr << endl;
+    cout << "CPU " << cpu << " SAMPLED IPC: " << ipc << " +- " << 100 * ipc_error << "% (95% CI)"
+         << "  CPI: " << cpi[cpu].mean() << " +- " << cpi[cpu].half_width() << endl;
+    cout << "CPU " << cpu << " SAMPLED BRANCH MPKI: " << branch_mpki[cpu].mean() << " +- " << branch_mpki[cpu].half_width()
+         << "  LLC MPKI: " << llc_mpki[cpu].mean() << " +- " << llc_mpki[cpu].half_width() << endl;
+}
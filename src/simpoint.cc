@@ -0,0 +1,206 @@
+#include <sys/wait.h>
+#include <fcntl.h>
+#include "simpoint.h"
+#include "ooo_cpu.h"
+#include "uncore.h"
+
+class Region
+{
+  public:
+    string trace, out, sum;
+    double weight = 0;
+    pid_t pid = 0;
+    map<string, double> stats;
+};
+
+static CACHE *summary_caches[] = {&ooo_cpu[0].L1D, &ooo_cpu[0].L2C, &uncore.LLC};
+
+void write_summary(const string &path)
+{
+    ofstream out(path.c_str());
+    out << "instructions " << ooo_cpu[0].finish_sim_instr << endl;
+    out << "cycles " << ooo_cpu[0].finish_sim_cycle << endl;
+    out << "branch_mispredictions " << ooo_cpu[0].roi_branch_mispredictions << endl;
+    for (CACHE *cache : summary_caches) {
+        const CACHE_ROI_STATS &roi = cache->roi_delta[0];
+        out << cache->NAME << "_demand_miss " << roi.miss[LOAD] + roi.miss[RFO] << endl;
+        out << cache->NAME << "_pf_useful " << roi.pf_useful << endl;
+        out << cache->NAME << "_pf_fill " << roi.pf_fill << endl;
+    }
+}
+
+static bool read_summary(Region &region)
+{
+    ifstream in(region.sum.c_str());
+    string key;
+    double value;
+    while (in >> key >> value)
+        region.stats[key] = value;
+    return region.stats.count("instructions") && region.stats["instructions"] > 0 && region.stats["cycles"] > 0;
+}
+
+static vector<Region> read_regions(const string &list)
+{
+    vector<Region> regions;
+    ifstream in(list.c_str());
+    if (!in.good()) {
+        cerr << "cannot open region list " << list << endl;
+        assert(0);
+    }
+
+    string line;
+    while (getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        istringstream fields(line);
+        Region region;
+        if (!(fields >> region.trace))
+            continue;
+        if (!(fields >> region.weight) || region.weight <= 0) {
+            cerr << "region " << region.trace << " needs a positive weight" << endl;
+            assert(0);
+        }
+        region.out = list + "." + to_string(regions.size()) + ".out";
+        region.sum = list + "." + to_string(regions.size()) + ".sum";
+        regions.push_back(region);
+    }
+    if (regions.empty()) {
+        cerr << "region list " << list << " is empty" << endl;
+        assert(0);
+    }
+    return regions;
+}
+
+// knobs naming a file the simulation writes, each child gets its own with the region index appended
+static const char *file_knobs[] = {"capture_l1d", "latency_trace"};
+
+// the child keeps every knob except the region ones, -summary and the traces
+static vector<string> child_args(int argc, char **argv, size_t index)
+{
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        string name = arg.substr(arg.find_first_not_of('-'));
+        name = name.substr(0, name.find('='));
+        if (name == "traces")
+            break;
+        if (name == "regions" || name == "region_jobs" || name == "summary") {
+            if (arg.find('=') == string::npos)
+                i++;
+            continue;
+        }
+
+        bool file = false;
+        for (const char *knob : file_knobs)
+            file |= (name == knob);
+        if (file && (arg.find('=') == string::npos) && (i + 1 < argc)) {
+            args.push_back(arg);
+            arg = argv[++i];
+        }
+        if (file)
+            arg += "." + to_string(index);
+        args.push_back(arg);
+    }
+    return args;
+}
+
+static pid_t spawn(const Region &region, size_t index, int argc, char **argv)
+{
+    vector<string> args = child_args(argc, argv, index);
+    args.push_back("-summary");
+    args.push_back(region.sum);
+    args.push_back("-traces");
+    args.push_back(region.trace);
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        int fd = open(region.out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        assert(fd >= 0);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+
+        vector<char *> child_argv;
+        child_argv.push_back((char *)"/proc/self/exe");
+        for (string &arg : args)
+            child_argv.push_back(&arg[0]);
+        child_argv.push_back(NULL);
+        execv("/proc/self/exe", child_argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+int run_regions(const string &list, uint32_t jobs, int argc, char **argv)
+{
+    if (NUM_CPUS > 1) {
+        cerr << "-regions runs single-core slices, rebuild with NUM_CPUS 1" << endl;
+        return 1;
+    }
+
+    vector<Region> regions = read_regions(list);
+    if (jobs == 0)
+        jobs = max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+
+    cout << "SimPoint regions: " << regions.size() << " from " << list << " (" << jobs << " at a time)" << endl;
+
+    // keep up to `jobs` children running
+    size_t next = 0, running = 0, failed = 0;
+    while (next < regions.size() || running) {
+        while (next < regions.size() && running < jobs) {
+            regions[next].pid = spawn(regions[next], next, argc, argv);
+            cout << "Region " << next << " runs " << regions[next].trace << " -> " << regions[next].out << endl;
+            next++;
+            running++;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        assert(pid > 0);
+        running--;
+        for (size_t i = 0; i < regions.size(); i++) {
+            if (regions[i].pid != pid)
+                continue;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) || !read_summary(regions[i])) {
+                cerr << "Region " << i << " (" << regions[i].trace << ") failed, see " << regions[i].out << endl;
+                failed++;
+            }
+        }
+    }
+    if (failed)
+        return 1;
+
+    double total_weight = 0;
+    for (Region &region : regions)
+        total_weight += region.weight;
+
+    // per-instruction metrics of each region, weighted by its share of the benchmark
+    double cpi = 0, branch_mpki = 0, mpki[3] = {}, pf_useful[3] = {}, pf_fill[3] = {};
+    cout << endl
+         << "SimPoint Region Statistics" << endl;
+    for (size_t i = 0; i < regions.size(); i++) {
+        map<string, double> &s = regions[i].stats;
+        double w = regions[i].weight / total_weight, ki = s["instructions"] / 1000;
+        cout << "Region " << i << " weight: " << w << " IPC: " << s["instructions"] / s["cycles"]
+             << " trace: " << regions[i].trace << endl;
+
+        cpi += w * s["cycles"] / s["instructions"];
+        branch_mpki += w * s["branch_mispredictions"] / ki;
+        for (int c = 0; c < 3; c++) {
+            const string &name = summary_caches[c]->NAME;
+            mpki[c] += w * s[name + "_demand_miss"] / ki;
+            pf_useful[c] += w * s[name + "_pf_useful"] / ki;
+            pf_fill[c] += w * s[name + "_pf_fill"] / ki;
+        }
+    }
+
+    cout << endl
+         << "SimPoint Weighted Statistics" << endl;
+    cout << "Weighted IPC: " << 1 / cpi << " CPI: " << cpi << endl;
+    cout << "Weighted Branch MPKI: " << branch_mpki << endl;
+    for (int c = 0; c < 3; c++) {
+        cout << summary_caches[c]->NAME << " Weighted Demand MPKI: " << mpki[c];
+        cout << "  Prefetch Accuracy: " << (pf_fill[c] > 0 ? pf_useful[c] / pf_fill[c] : 0) << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * Branch-predictor-only trace replay.
+ *
+ * Streams the branch records (ip, branch_taken) of ChampSim traces through
+ * branch/<name>.bpred predictors, without the O3 pipeline or the memory
+ * system, and reports accuracy, MPKI and predictions per second. Every branch
+ * is predicted and then resolved right away, as the O3 front end does.
+ *
+ * `make bp_replay` links every branch/<name>.bpred into bin/bp_replay, and each
+ * trace is decompressed once: its branches are decoded in batches and every
+ * batch is replayed through all the selected predictors in turn. Only the
+ * predictor calls are timed, so predictions/s measures the predictor and not
+ * the decompressor. Predictors are re-initialized for every trace.
+ *
+ *   bin/bp_replay -trace 600.perlbench_s-210B.champsimtrace.xz -predictors tage_sc_l,hashed_perceptron
+ *   bin/bp_replay -trace_list trace_list/1core_trace_list.txt -trace_dir traces/ -warmup_instructions 10000000
+ */
+
+#include <getopt.h>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <vector>
+#include "bp_replay.h"
+#include "instruction.h"
+
+#define BP_REPLAY_BATCH (1 << 20)
+
+map<string, BranchPredictorHooks> &branch_predictors()
+{
+    static map<string, BranchPredictorHooks> predictors;
+    return predictors;
+}
+
+/* pulls the branches out of a ChampSim trace, a batch at a time */
+class BranchReader
+{
+public:
+    BranchReader(const string &trace)
+    {
+        string decomp_program = trace.substr(trace.find_last_of(".") + 1)[0] == 'x' ? "xz" : "gzip";
+        this->file = popen((decomp_program + " -dc " + trace).c_str(), "r");
+        if (!this->file)
+        {
+            cerr << "cannot open " << trace << endl;
+            assert(0);
+        }
+    }
+
+    ~BranchReader() { pclose(this->file); }
+
+    /**
+     * Decodes up to `max_instructions` instructions into `batch`.
+     * @return False once the trace is exhausted and nothing was read
+     */
+    bool next(vector<BranchRecord> &batch, uint64_t max_instructions)
+    {
+        batch.clear();
+        uint64_t read = 0;
+        input_instr instr;
+        while (batch.size() < BP_REPLAY_BATCH && read < max_instructions && fread(&instr, sizeof(instr), 1, this->file) == 1)
+        {
+            read += 1;
+            if (instr.is_branch)
+                batch.push_back({instr.ip, instr.branch_taken});
+        }
+        this->instructions += read;
+        return read > 0;
+    }
+
+    uint64_t instructions = 0;
+
+private:
+    FILE *file = nullptr;
+};
+
+/* one predictor's results, for a trace or summed over traces */
+struct Lane
+{
+    Lane(const string &name, BranchPredictorHooks hooks) : name(name), hooks(hooks) {}
+
+    string name;
+    BranchPredictorHooks hooks;
+    uint64_t mispredictions = 0;
+    double mpki_sum = 0;
+    chrono::steady_clock::duration time = chrono::steady_clock::duration(0);
+};
+
+static void print_lane(const string &name, uint64_t instructions, uint64_t branches, uint64_t mispredictions,
+                       chrono::steady_clock::duration time)
+{
+    double seconds = chrono::duration<double>(time).count();
+    cout << setw(20) << name << "  accuracy: " << setw(8) << (branches ? 100.0 * (branches - mispredictions) / branches : 0)
+         << "%  MPKI: " << setw(8) << (instructions ? 1000.0 * mispredictions / instructions : 0)
+         << "  predictions/s: " << (seconds > 0 ? branches / seconds : 0) << endl;
+}
+
+int main(int argc, char **argv)
+{
+    vector<string> traces;
+    string trace_list, trace_dir, predictors;
+    uint64_t warmup_instructions = 0, simulation_instructions = UINT64_MAX;
+
+    while (1)
+    {
+        static struct option long_options[] = {
+            {"trace", required_argument, 0, 't'},
+            {"trace_list", required_argument, 0, 'l'},
+            {"trace_dir", required_argument, 0, 'd'},
+            {"predictors", required_argument, 0, 'p'},
+            {"warmup_instructions", required_argument, 0, 'w'},
+            {"simulation_instructions", required_argument, 0, 'i'},
+            {0, 0, 0, 0}};
+        int option_index = 0;
+        int c = getopt_long_only(argc, argv, "t:l:d:p:w:i:", long_options, &option_index);
+        if (c == -1)
+            break;
+        switch (c)
+        {
+        case 't':
+            traces.push_back(optarg);
+            break;
+        case 'l':
+            trace_list = optarg;
+            break;
+        case 'd':
+            trace_dir = optarg;
+            break;
+        case 'p':
+            predictors = optarg;
+            break;
+        case 'w':
+            warmup_instructions = atoll(optarg);
+            break;
+        case 'i':
+            simulation_instructions = atoll(optarg);
+            break;
+        default:
+            cerr << "usage: " << argv[0] << " (-trace <champsim trace>... | -trace_list <file> [-trace_dir <dir>])"
+                 << " [-predictors name,...] [-warmup_instructions N] [-simulation_instructions N]" << endl;
+            return 1;
+        }
+    }
+
+    // a trace list has whitespace-separated names, as in trace_list/*.txt; a trace shared by several mixes is replayed once
+    if (!trace_list.empty())
+    {
+        ifstream in(trace_list.c_str());
+        if (!in.good())
+        {
+            cerr << "cannot open " << trace_list << endl;
+            return 1;
+        }
+        if (!trace_dir.empty() && trace_dir.back() != '/')
+            trace_dir += '/';
+        string name;
+        while (in >> name)
+            if (find(traces.begin(), traces.end(), trace_dir + name) == traces.end())
+                traces.push_back(trace_dir + name);
+    }
+    if (traces.empty())
+    {
+        cerr << "-trace or -trace_list is needed" << endl;
+        return 1;
+    }
+
+    vector<Lane> lanes;
+    if (predictors.empty())
+        for (auto &predictor : branch_predictors())
+            lanes.emplace_back(predictor.first, predictor.second);
+    else
+    {
+        stringstream names(predictors);
+        string name;
+        while (getline(names, name, ','))
+        {
+            if (!branch_predictors().count(name))
+            {
+                cerr << "unknown predictor " << name << ", available:";
+                for (auto &predictor : branch_predictors())
+                    cerr << " " << predictor.first;
+                cerr << endl;
+                return 1;
+            }
+            lanes.emplace_back(name, branch_predictors()[name]);
+        }
+    }
+
+    uint64_t total_instructions = 0, total_branches = 0;
+    vector<BranchRecord> batch;
+    batch.reserve(BP_REPLAY_BATCH);
+    for (auto &trace : traces)
+    {
+        // the predictors' messages at initialization would be repeated for every trace
+        streambuf *out = cout.rdbuf(nullptr);
+        for (auto &lane : lanes)
+            lane.hooks.initialize();
+        cout.rdbuf(out);
+
+        BranchReader reader(trace);
+
+        // the warmup trains the predictors, nothing is counted
+        while (reader.instructions < warmup_instructions && reader.next(batch, warmup_instructions - reader.instructions))
+            for (auto &lane : lanes)
+                lane.hooks.replay(batch.data(), batch.size());
+
+        vector<uint64_t> mispredictions(lanes.size(), 0);
+        vector<chrono::steady_clock::duration> time(lanes.size(), chrono::steady_clock::duration(0));
+        uint64_t branches = 0, start = reader.instructions;
+        uint64_t end = simulation_instructions == UINT64_MAX ? UINT64_MAX : start + simulation_instructions;
+        while (reader.instructions < end && reader.next(batch, end - reader.instructions))
+        {
+            for (size_t i = 0; i < lanes.size(); i += 1)
+            {
+                chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+                mispredictions[i] += lanes[i].hooks.replay(batch.data(), batch.size());
+                time[i] += chrono::steady_clock::now() - begin;
+            }
+            branches += batch.size();
+        }
+
+        uint64_t instructions = reader.instructions - start;
+        cout << "Trace: " << trace << " Instructions: " << instructions << " Branches: " << branches << endl;
+        for (size_t i = 0; i < lanes.size(); i += 1)
+        {
+            print_lane(lanes[i].name, instructions, branches, mispredictions[i], time[i]);
+            lanes[i].mispredictions += mispredictions[i];
+            lanes[i].mpki_sum += instructions ? 1000.0 * mispredictions[i] / instructions : 0;
+            lanes[i].time += time[i];
+        }
+        total_instructions += instructions;
+        total_branches += branches;
+    }
+
+    if (traces.size() > 1)
+    {
+        cout << endl << "All " << traces.size() << " traces, Instructions: " << total_instructions << " Branches: " << total_branches << endl;
+        for (auto &lane : lanes)
+        {
+            print_lane(lane.name, total_instructions, total_branches, lane.mispredictions, lane.time);
+            cout << setw(20) << "" << "  mean MPKI over traces: " << lane.mpki_sum / traces.size() << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef BP_REPLAY_H
+#define BP_REPLAY_H
+
+#include <map>
+#include <string>
+#include "champsim.h"
+
+using namespace std;
+
+/* one branch of the trace */
+struct BranchRecord
+{
+    uint64_t ip;
+    uint8_t taken;
+};
+
+/* one branch/<name>.bpred, built by tools/bp_replay_predictor.cc */
+struct BranchPredictorHooks
+{
+    void (*initialize)();
+    /* predicts and then resolves each branch in order, @return the mispredictions */
+    uint64_t (*replay)(const BranchRecord *branches, size_t count);
+};
+
+/* every predictor linked into bp_replay, by name */
+map<string, BranchPredictorHooks> &branch_predictors();
+
+struct BranchPredictorRegistration
+{
+    BranchPredictorRegistration(const string &name, BranchPredictorHooks hooks) { branch_predictors()[name] = hooks; }
+};
+
+#endif
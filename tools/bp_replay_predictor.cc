@@ -0,0 +1,49 @@
+/*
+ * One branch/<name>.bpred for tools/bp_replay.cc, compiled once per predictor
+ * with BPRED_FILE, BPRED_NAME and BPRED_NAMESPACE set by the Makefile. Each
+ * predictor lives in its own namespace, with its own stand-in for O3_CPU, so
+ * the globals and O3_CPU hooks of all the predictors link into one binary.
+ */
+
+#include <math.h>
+#include <cmath>
+#include "bp_replay.h"
+
+/*
+ * The predictors include ooo_cpu.h for O3_CPU and only use its `cpu` and the
+ * three branch predictor hooks; the stand-in keeps the O3 core and the cache
+ * hierarchy out of the build.
+ */
+#define OOO_CPU_H
+
+namespace BPRED_NAMESPACE
+{
+class O3_CPU
+{
+public:
+    uint32_t cpu = 0;
+
+    void initialize_branch_predictor();
+    uint8_t predict_branch(uint64_t ip);
+    void last_branch_result(uint64_t ip, uint8_t taken);
+};
+
+#include BPRED_FILE
+
+static O3_CPU core;
+
+static void initialize() { core.initialize_branch_predictor(); }
+
+static uint64_t replay(const BranchRecord *branches, size_t count)
+{
+    uint64_t mispredictions = 0;
+    for (size_t i = 0; i < count; i += 1)
+    {
+        mispredictions += core.predict_branch(branches[i].ip) != branches[i].taken;
+        core.last_branch_result(branches[i].ip, branches[i].taken);
+    }
+    return mispredictions;
+}
+} // namespace BPRED_NAMESPACE
+
+static BranchPredictorRegistration registration(BPRED_NAME, {BPRED_NAMESPACE::initialize, BPRED_NAMESPACE::replay});
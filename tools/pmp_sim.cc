@@ -0,0 +1,438 @@
+/*
+ * PMP micro-simulator.
+ *
+ * Drives the PMP tables (access, prefetch, eviction) from a stream of L1D
+ * accesses through a functional L1D, without the O3 core, TLBs or DRAM, so
+ * table layouts, vote thresholds and pattern representations can be compared
+ * in seconds. Prefetches fill instantly and the PQ/MSHR never back up, so the
+ * numbers are an upper bound of what PMP can cover, not an IPC estimate.
+ *
+ * Input is either a ChampSim trace (virtual addresses, -trace) or the compact
+ * record stream written by -dump (-stream). Build with `make pmp_sim`.
+ *
+ * -configs <file> evaluates several PMP configurations in one pass: each
+ * line is a name followed by KEY=value overrides of the prefetcher/pmp.l1d_pref
+ * parameters (FT_SIZE, AT_SIZE, OPT_SIZE, PC_BITS, PATTERN_DEGRADE_LEVEL,
+ * L1D_THRESH, ... see PMPSimConfig), and every configuration gets its own PMP
+ * and its own shadow L1D fed with the same accesses.
+ *
+ *   bin/pmp_sim -trace 600.perlbench_s-210B.champsimtrace.xz -dump perl.pmp
+ *   bin/pmp_sim -stream perl.pmp
+ *   bin/pmp_sim -stream perl.pmp -configs sweep.txt
+ */
+
+#include <getopt.h>
+#include <chrono>
+#include "cache.h"
+#include "instruction.h"
+#include "pmp.h"
+
+using namespace std;
+
+/* one L1D access; `hit` is the outcome seen by the run that produced the stream */
+struct __attribute__((packed)) PMPSimRecord
+{
+    uint64_t instr_id;
+    uint64_t ip;
+    uint64_t address;
+    uint8_t type;
+    uint8_t hit;
+};
+
+/* L1D with instant fills and LRU replacement. Quacks like CACHE for PrefetchBuffer. */
+class FunctionalL1D
+{
+public:
+    struct Queue
+    {
+        uint32_t occupancy, SIZE;
+    };
+
+    struct Line
+    {
+        bool valid = false, prefetched = false;
+        uint64_t block = 0, lru = 0;
+    };
+
+    FunctionalL1D() : lines(L1D_SET * L1D_WAY) {}
+
+    /**
+     * Demand access. A miss fills the line.
+     * @return True on a hit
+     */
+    bool access(uint64_t block)
+    {
+        Line *line = this->find(block);
+        if (line)
+        {
+            if (line->prefetched)
+            {
+                this->pf_useful += 1;
+                line->prefetched = false;
+            }
+            line->lru = ++this->clock;
+            return true;
+        }
+        this->fill(block, false);
+        return false;
+    }
+
+    int prefetch_line(uint32_t pf_cpu, uint64_t ip, uint64_t base_addr, uint64_t pf_addr, int pf_fill_level, uint32_t prefetch_metadata)
+    {
+        this->pf_requested += 1;
+        if ((base_addr >> LOG2_PAGE_SIZE) != (pf_addr >> LOG2_PAGE_SIZE))
+            return 0;
+        if (pf_fill_level != FILL_L1)
+        {
+            this->pf_lower += 1;
+            return 1;
+        }
+        uint64_t block = pf_addr >> LOG2_BLOCK_SIZE;
+        if (this->find(block))
+        {
+            this->pf_resident += 1;
+            return 0;
+        }
+        this->fill(block, true);
+        this->pf_fill += 1;
+        return 1;
+    }
+
+    string NAME = "L1D";
+    Queue PQ = {0, L1D_PQ_SIZE}, MSHR = {0, L1D_MSHR_SIZE};
+
+    uint64_t pf_requested = 0, pf_fill = 0, pf_lower = 0, pf_resident = 0, pf_useful = 0, pf_useless = 0;
+
+    /* blocks to report to PMP, as pmp.l1d_pref does on a fill whose victim is not an untouched prefetch */
+    vector<uint64_t> evictions;
+
+private:
+    Line *find(uint64_t block)
+    {
+        Line *set = &this->lines[(block % L1D_SET) * L1D_WAY];
+        for (int way = 0; way < L1D_WAY; way += 1)
+            if (set[way].valid && set[way].block == block)
+                return &set[way];
+        return nullptr;
+    }
+
+    void fill(uint64_t block, bool prefetched)
+    {
+        Line *set = &this->lines[(block % L1D_SET) * L1D_WAY];
+        Line *victim = &set[0];
+        for (int way = 0; way < L1D_WAY; way += 1)
+        {
+            if (!set[way].valid)
+            {
+                victim = &set[way];
+                break;
+            }
+            if (set[way].lru < victim->lru)
+                victim = &set[way];
+        }
+        if (victim->valid && victim->prefetched)
+            this->pf_useless += 1;
+        else if (victim->valid)
+            this->evictions.push_back(victim->block);
+        victim->valid = true;
+        victim->prefetched = prefetched;
+        victim->block = block;
+        victim->lru = ++this->clock;
+    }
+
+    vector<Line> lines;
+    uint64_t clock = 0;
+};
+
+/* pulls L1D accesses out of a ChampSim trace or a -dump stream */
+class RecordReader
+{
+public:
+    RecordReader(const string &trace, const string &stream)
+    {
+        if (!trace.empty())
+        {
+            string decomp_program = trace.substr(trace.find_last_of(".") + 1)[0] == 'x' ? "xz" : "gzip";
+            this->file = popen((decomp_program + " -dc " + trace).c_str(), "r");
+            this->is_trace = true;
+        }
+        else
+            this->file = fopen(stream.c_str(), "rb");
+        if (!this->file)
+        {
+            cerr << "cannot open " << (trace.empty() ? stream : trace) << endl;
+            assert(0);
+        }
+    }
+
+    ~RecordReader()
+    {
+        if (this->is_trace)
+            pclose(this->file);
+        else
+            fclose(this->file);
+    }
+
+    bool next(PMPSimRecord &record)
+    {
+        if (!this->is_trace)
+            return fread(&record, sizeof(record), 1, this->file) == 1;
+
+        while (this->pending.empty())
+        {
+            input_instr instr;
+            if (fread(&instr, sizeof(instr), 1, this->file) != 1)
+                return false;
+            this->instr_id += 1;
+            for (int i = 0; i < NUM_INSTR_SOURCES; i += 1)
+                if (instr.source_memory[i])
+                    this->pending.push_back({this->instr_id, instr.ip, instr.source_memory[i], LOAD, 0});
+            for (int i = 0; i < NUM_INSTR_DESTINATIONS; i += 1)
+                if (instr.destination_memory[i])
+                    this->pending.push_back({this->instr_id, instr.ip, instr.destination_memory[i], RFO, 0});
+        }
+        record = this->pending.front();
+        this->pending.pop_front();
+        return true;
+    }
+
+private:
+    FILE *file = nullptr;
+    bool is_trace = false;
+    uint64_t instr_id = 0;
+    deque<PMPSimRecord> pending;
+};
+
+/* one point of a sweep, defaults are the configuration of prefetcher/pmp.l1d_pref */
+class PMPSimConfig
+{
+public:
+    string name = "default";
+    map<string, double> values = {
+        {"FT_SIZE", 64}, {"FT_WAY", 8}, {"AT_SIZE", 32}, {"AT_WAY", 16},
+        {"OPT_WAYS", 1}, {"OPT_SIZE", 0}, {"OFFSET_MAX_CONF", 32},
+        {"PC_BITS", PC_BITS}, {"PPT_WAYS", 1}, {"PPT_SIZE", 0}, {"PC_MAX_CONF", 32},
+        {"PF_BUFFER_SIZE", 16}, {"PF_BUFFER_WAY", 16}, {"PATTERN_DEGRADE_LEVEL", PATTERN_DEGRADE_LEVEL},
+        {"L1D_THRESH", 0.50}, {"L2C_THRESH", 0.15}, {"PC_L1D_THRESH", 0.50}, {"PC_L2C_THRESH", 0.15}};
+
+    int get(const string &key) const { return (int)this->values.at(key); }
+
+    /* "<name> KEY=value ...", unknown keys are an error */
+    bool parse(const string &line)
+    {
+        istringstream fields(line);
+        if (!(fields >> this->name))
+            return false;
+        string field;
+        while (fields >> field)
+        {
+            size_t eq = field.find('=');
+            string key = field.substr(0, eq);
+            if (eq == string::npos || !this->values.count(key))
+            {
+                cerr << "config " << this->name << ": unknown setting " << field << endl;
+                exit(1);
+            }
+            this->values[key] = atof(field.c_str() + eq + 1);
+        }
+        return true;
+    }
+
+    PMP build() const
+    {
+        const int PATTERN_LEN = (1 << IN_REGION_BITS) / BLOCK_SIZE;
+        /* table sizes of 0 follow the way count, as in pmp.l1d_pref */
+        int opt_size = this->get("OPT_SIZE") ? this->get("OPT_SIZE") : (1 << OFFSET_BITS) * this->get("OPT_WAYS");
+        int ppt_size = this->get("PPT_SIZE") ? this->get("PPT_SIZE") : (1 << this->get("PC_BITS")) * this->get("PPT_WAYS");
+        PMP pmp(PATTERN_LEN, OFFSET_BITS, opt_size, this->get("OFFSET_MAX_CONF"), this->get("OPT_WAYS"),
+                this->get("PC_BITS"), ppt_size, this->get("PC_MAX_CONF"), this->get("PPT_WAYS"),
+                this->get("FT_SIZE"), this->get("FT_WAY"), this->get("AT_SIZE"), this->get("AT_WAY"),
+                this->get("PF_BUFFER_SIZE"), this->get("PF_BUFFER_WAY"), 0, 0, this->get("PATTERN_DEGRADE_LEVEL"));
+        pmp.set_thresholds(this->values.at("L1D_THRESH"), this->values.at("L2C_THRESH"), this->values.at("PC_L1D_THRESH"),
+                           this->values.at("PC_L2C_THRESH"));
+        return pmp;
+    }
+};
+
+/* a configuration under evaluation with its own PMP and shadow L1D */
+class Lane
+{
+public:
+    Lane(const PMPSimConfig &config) : config(config), pmp(config.build()) {}
+
+    /* @return True if the access hit in this lane's L1D */
+    bool access(const PMPSimRecord &record)
+    {
+        uint64_t block_number = record.address >> LOG2_BLOCK_SIZE;
+        bool hit = this->l1d.access(block_number);
+
+        /* demand and prefetch fills alike, the prefetch fills of the last access included */
+        this->report_evictions();
+        if (record.type == LOAD)
+        {
+            this->pmp.access(block_number, record.ip);
+            this->pmp.prefetch(&this->l1d, block_number);
+            this->pmp_ops += 2;
+            this->load_misses += !hit;
+        }
+        this->pmp.drain(&this->l1d);
+        this->pmp_ops += 1;
+        return hit;
+    }
+
+    void report_evictions()
+    {
+        for (uint64_t block : this->l1d.evictions)
+            this->pmp.eviction(block);
+        this->pmp_ops += this->l1d.evictions.size();
+        this->l1d.evictions.clear();
+    }
+
+    double coverage() const
+    {
+        return this->l1d.pf_useful + this->load_misses ? 1.0 * this->l1d.pf_useful / (this->l1d.pf_useful + this->load_misses) : 0;
+    }
+
+    double accuracy() const { return this->l1d.pf_fill ? 1.0 * this->l1d.pf_useful / this->l1d.pf_fill : 0; }
+
+    uint64_t pf_issued() const { return this->l1d.pf_fill + this->l1d.pf_lower; }
+
+    PMPSimConfig config;
+    PMP pmp;
+    FunctionalL1D l1d;
+    uint64_t load_misses = 0, pmp_ops = 0;
+};
+
+int main(int argc, char **argv)
+{
+    string trace, stream, dump, configs;
+    uint64_t max_records = UINT64_MAX;
+
+    while (1)
+    {
+        static struct option long_options[] = {
+            {"trace", required_argument, 0, 't'},
+            {"stream", required_argument, 0, 's'},
+            {"dump", required_argument, 0, 'd'},
+            {"records", required_argument, 0, 'n'},
+            {"configs", required_argument, 0, 'c'},
+            {0, 0, 0, 0}};
+        int option_index = 0;
+        int c = getopt_long_only(argc, argv, "t:s:d:n:c:", long_options, &option_index);
+        if (c == -1)
+            break;
+        switch (c)
+        {
+        case 't':
+            trace = optarg;
+            break;
+        case 's':
+            stream = optarg;
+            break;
+        case 'd':
+            dump = optarg;
+            break;
+        case 'n':
+            max_records = atoll(optarg);
+            break;
+        case 'c':
+            configs = optarg;
+            break;
+        default:
+            cerr << "usage: " << argv[0]
+                 << " (-trace <champsim trace> | -stream <file>) [-dump <file>] [-records N] [-configs <file>]" << endl;
+            return 1;
+        }
+    }
+    if (trace.empty() == stream.empty())
+    {
+        cerr << "exactly one of -trace and -stream is needed" << endl;
+        return 1;
+    }
+
+    vector<Lane> lanes;
+    if (configs.empty())
+        lanes.emplace_back(PMPSimConfig());
+    else
+    {
+        ifstream in(configs.c_str());
+        if (!in.good())
+        {
+            cerr << "cannot open " << configs << endl;
+            return 1;
+        }
+        string line;
+        while (getline(in, line))
+        {
+            PMPSimConfig config;
+            if (config.parse(line.substr(0, line.find('#'))))
+                lanes.emplace_back(config);
+        }
+        if (lanes.empty())
+        {
+            cerr << configs << " has no configurations" << endl;
+            return 1;
+        }
+    }
+
+    RecordReader reader(trace, stream);
+    FILE *dump_file = dump.empty() ? nullptr : fopen(dump.c_str(), "wb");
+
+    uint64_t records = 0, loads = 0, recorded_misses = 0, instructions = 0;
+    PMPSimRecord record;
+    /* timed as a whole, a clock read per record would cost about as much as the PMP calls */
+    auto start = chrono::steady_clock::now();
+    while (records < max_records && reader.next(record))
+    {
+        records += 1;
+        instructions = record.instr_id;
+
+        /* every lane sees the same access; the first one decides the dumped hit bit */
+        bool hit = lanes[0].access(record);
+        for (size_t i = 1; i < lanes.size(); i += 1)
+            lanes[i].access(record);
+
+        if (trace.size())
+            record.hit = hit;
+        if (dump_file)
+            fwrite(&record, sizeof(record), 1, dump_file);
+
+        if (record.type == LOAD)
+        {
+            loads += 1;
+            recorded_misses += !record.hit;
+        }
+    }
+    for (Lane &lane : lanes)
+        lane.report_evictions();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (dump_file)
+        fclose(dump_file);
+
+    cout << "Records: " << records << " Instructions: " << instructions << " Loads: " << loads << endl;
+    if (lanes.size() == 1)
+    {
+        Lane &lane = lanes[0];
+        FunctionalL1D &l1d = lane.l1d;
+        cout << "L1D LOAD MISS: " << lane.load_misses << " (recorded: " << recorded_misses << ")" << endl;
+        cout << "L1D PREFETCH  REQUESTED: " << l1d.pf_requested << "  ISSUED: " << lane.pf_issued() << "  FILLED: " << l1d.pf_fill
+             << "  LOWER LEVEL: " << l1d.pf_lower << "  RESIDENT: " << l1d.pf_resident << endl;
+        cout << "L1D PREFETCH  USEFUL: " << l1d.pf_useful << "  USELESS: " << l1d.pf_useless << endl;
+        cout << "Coverage: " << lane.coverage() << " Accuracy: " << lane.accuracy()
+             << " Prefetches/KI: " << (instructions ? 1000.0 * lane.pf_issued() / instructions : 0) << endl;
+        cout << "PMP operations: " << lane.pmp_ops << " in " << seconds << " s ("
+             << (seconds > 0 ? lane.pmp_ops / seconds : 0) << " ops/s, reading and the functional L1D included)" << endl;
+        return 0;
+    }
+
+    cout << setw(20) << left << "Config" << right << setw(12) << "Coverage" << setw(12) << "Accuracy" << setw(14)
+         << "Prefetches/KI" << setw(12) << "L1D MPKI" << setw(12) << "Useful" << setw(12) << "Useless" << endl;
+    for (Lane &lane : lanes)
+    {
+        double ki = instructions ? instructions / 1000.0 : 1;
+        cout << setw(20) << left << lane.config.name << right << setw(12) << lane.coverage() << setw(12) << lane.accuracy()
+             << setw(14) << lane.pf_issued() / ki << setw(12) << lane.load_misses / ki << setw(12) << lane.l1d.pf_useful
+             << setw(12) << lane.l1d.pf_useless << endl;
+    }
+    return 0;
+}